@@ -1,77 +1,208 @@
-#pragma once 
+#pragma once
 
 #include <stdexcept>
 #include <cstddef>
+#include <cstdint>
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "orderbook.h"
+#include "spinlock.h"
 
-#define MAX_INSTRUMENTS 1024
+/** dense handle of an instrument in a BookMap, 0, 1, ... in registration order, never reused */
+enum class InstrumentId : uint32_t {};
 
-/** Book is a lock-free map of instrument -> OrderBook */
+/**
+ * Book is a map of instrument -> OrderBook that grows without bound. Instruments get dense ids when registered and
+ * their books are created on first use. The slots are kept in fixed-size segments indexed by id, which never move,
+ * so id lookups index an array without taking the map's lock. Names are found through an open addressing index of
+ * ids, replaced by a twice larger one as it fills; readers probe without locking (replaced indexes are kept until the
+ * map is destroyed), new instruments and books are added under a lock. A slot's book is an
+ * std::atomic<std::shared_ptr>, which libstdc++ implements with a small internal lock, so loading a book does not
+ * take the map's lock but is not lock-free.
+ *
+ * Retiring an instrument only releases its book: its index entry is left as a tombstone, which lookups probe past
+ * and the next rebuild of the index drops, and its slot, id and name are never reclaimed, as ids are not reused and
+ * readers outside the map's lock may still hold them. Memory therefore grows with the instruments ever registered, retired ones
+ * included: a slot and a name each, and index space that doubles with every rebuild so that the replaced indexes
+ * together stay smaller than the current one.
+ */
 class BookMap {
-    std::atomic<std::shared_ptr<OrderBook>> table[MAX_INSTRUMENTS];
+    static constexpr size_t SEGMENT_BITS = 12;
+    static constexpr size_t SEGMENT_SIZE = size_t(1) << SEGMENT_BITS;
+    static constexpr size_t MAX_SEGMENTS = 4096;
+
+    /** index entry of a retired instrument */
+    static constexpr uint32_t TOMBSTONE = UINT32_MAX;
+
+    struct Slot {
+        std::string instrument;
+        size_t hash = 0;
+        std::atomic<std::shared_ptr<OrderBook>> book;
+        /** written under the lock, the name stays for readers that may be comparing it */
+        bool closed = false;
+    };
+    struct Index {
+        const size_t mask;
+        /** id + 1, 0 for an empty slot or TOMBSTONE */
+        const std::unique_ptr<std::atomic<uint32_t>[]> ids;
+        explicit Index(size_t size) : mask(size - 1), ids(new std::atomic<uint32_t>[size]) {
+            for (size_t i = 0; i < size; i++) ids[i].store(0, std::memory_order_relaxed);
+        }
+    };
+
+    std::atomic<Slot*> segments[MAX_SEGMENTS] = {};
+    std::atomic<uint32_t> count{0};
+    std::atomic<Index*> index;
+    /** the current index and those it replaced, readers may still probe them */
+    std::vector<std::unique_ptr<Index>> indexes;
+    /** open instruments, and the entries of the current index that are not empty (open ones and tombstones) */
+    size_t open = 0;
+    size_t used = 0;
+    SpinLock mu;
+
+    Slot& slot(uint32_t id) const {
+        return segments[id >> SEGMENT_BITS].load(std::memory_order_acquire)[id & (SEGMENT_SIZE - 1)];
+    }
+    std::optional<InstrumentId> find(const Index& index, std::string_view instrument, size_t hash) const {
+        for (size_t i = hash & index.mask;; i = (i + 1) & index.mask) {
+            const auto id = index.ids[i].load(std::memory_order_acquire);
+            if (id == 0) return std::nullopt;
+            if (id == TOMBSTONE) continue;
+            const auto& s = slot(id - 1);
+            if (s.hash == hash && s.instrument == instrument) return InstrumentId(id - 1);
+        }
+    }
+    static void insert(Index& index, uint32_t id, size_t hash) {
+        auto i = hash & index.mask;
+        while (index.ids[i].load(std::memory_order_relaxed)) i = (i + 1) & index.mask;
+        index.ids[i].store(id + 1, std::memory_order_release);
+    }
 public:
     BookMap() {
-        for(int i = 0; i < MAX_INSTRUMENTS; i++) {
-            table[i].store(nullptr);
-        }
+        indexes.push_back(std::make_unique<Index>(2048));
+        index.store(indexes.back().get());
+    }
+    ~BookMap() {
+        for (auto& segment : segments) delete[] segment.load();
+    }
+    BookMap(const BookMap&) = delete;
+    BookMap& operator=(const BookMap&) = delete;
+
+    /** @return the id of a registered instrument, without taking the map's lock */
+    std::optional<InstrumentId> find(std::string_view instrument) const {
+        return find(*index.load(std::memory_order_acquire), instrument, std::hash<std::string_view>{}(instrument));
     }
-    
-    std::shared_ptr<OrderBook> getOrCreate(const std::string_view& instrument, OrderBookListener& listener) {
-        auto hash = std::hash<std::string_view>{}(instrument);
-        const auto start = hash % MAX_INSTRUMENTS;
-        auto book = table[start].load();
-        if (book != nullptr && book->instrument == instrument) return book;
-        
-        auto new_book = std::make_shared<OrderBook>(std::string(instrument), listener);
-        auto index = start;
-        while (true) {
-            if (book != nullptr) {
-                index = (index + 1) % MAX_INSTRUMENTS;
-                if (index == start) throw std::runtime_error("no room in books map");
-                book = table[index].load();
-                if (book != nullptr && book->instrument == instrument) return book;
-            } else {
-                if (table[index].compare_exchange_weak(book, new_book)) {
-                    return new_book;
-                }
+
+    /**
+     * the instrument's id, registering it if it is new. Its book is not created until getOrCreate(), so the
+     * instruments of a venue can be listed up front without the memory of books that never trade
+     * @throws std::runtime_error if the map holds the maximum number of instruments
+     */
+    InstrumentId add(std::string_view instrument) {
+        const auto hash = std::hash<std::string_view>{}(instrument);
+        if (auto id = find(*index.load(std::memory_order_acquire), instrument, hash)) return *id;
+
+        std::lock_guard<SpinLock> guard(mu);
+        auto current = index.load(std::memory_order_relaxed);
+        if (auto id = find(*current, instrument, hash)) return *id;
+        const uint32_t id = count.load(std::memory_order_relaxed);
+        if (id >> SEGMENT_BITS >= MAX_SEGMENTS) throw std::runtime_error("no room in books map");
+        auto& segment = segments[id >> SEGMENT_BITS];
+        if (!segment.load(std::memory_order_relaxed)) segment.store(new Slot[SEGMENT_SIZE], std::memory_order_release);
+        auto& s = segment.load(std::memory_order_relaxed)[id & (SEGMENT_SIZE - 1)];
+        s.instrument = instrument;
+        s.hash = hash;
+        count.store(id + 1, std::memory_order_release);
+
+        // at most half full, tombstones included: a new index of the open instruments is built aside and published.
+        // It is at least twice as large even when tombstones filled it, replaced indexes are never freed
+        if ((used + 1) * 2 > current->mask + 1) {
+            size_t size = (current->mask + 1) * 2;
+            while (size < (open + 1) * 3) size *= 2;
+            auto rebuilt = std::make_unique<Index>(size);
+            for (uint32_t i = 0; i < id; i++) {
+                if (!slot(i).closed) insert(*rebuilt, i, slot(i).hash);
             }
+            current = rebuilt.get();
+            indexes.push_back(std::move(rebuilt));
+            used = open;
         }
+        insert(*current, id, hash);
+        open++;
+        used++;
+        index.store(current, std::memory_order_release);
+        return InstrumentId(id);
     }
-    
+
+    /**
+     * the book of a registered instrument, created on first use: a book is only ever built once, under the lock,
+     * never speculatively. Null if id was not returned by this map or is closed
+     * @param configure selects the InstrumentConfig of a newly created book, defaults are used if empty
+     */
+    std::shared_ptr<OrderBook> getOrCreate(InstrumentId id, OrderBookListener& listener, const InstrumentConfigHook& configure = nullptr) {
+        if (uint32_t(id) >= count.load(std::memory_order_acquire)) return nullptr;
+        auto& s = slot(uint32_t(id));
+        if (auto book = s.book.load()) return book;
+        std::lock_guard<SpinLock> guard(mu);
+        if (s.closed) return nullptr;
+        if (auto book = s.book.load()) return book;
+        auto book = OrderBook::create(s.instrument, listener, configure ? configure(s.instrument) : InstrumentConfig{});
+        s.book.store(book);
+        return book;
+    }
+
+    /** @param configure selects the InstrumentConfig of a newly created book, defaults are used if empty */
+    std::shared_ptr<OrderBook> getOrCreate(const std::string_view& instrument, OrderBookListener& listener, const InstrumentConfigHook& configure = nullptr) {
+        return getOrCreate(add(instrument), listener, configure);
+    }
+
+    /**
+     * retires the instrument, leaving a tombstone: its id and name no longer resolve, and the name may be registered
+     * again under a new id. The book is released, readers still holding it keep it alive until they drop it; the
+     * slot and the id are not reused.
+     * @return the book, null if it was never created, or nullopt if id is not an open instrument of this map
+     */
+    std::optional<std::shared_ptr<OrderBook>> retire(InstrumentId id) {
+        std::lock_guard<SpinLock> guard(mu);
+        if (uint32_t(id) >= count.load(std::memory_order_relaxed)) return std::nullopt;
+        auto& s = slot(uint32_t(id));
+        if (s.closed) return std::nullopt;
+        s.closed = true;
+        auto& current = *index.load(std::memory_order_relaxed);
+        auto i = s.hash & current.mask;
+        while (current.ids[i].load(std::memory_order_relaxed) != uint32_t(id) + 1) i = (i + 1) & current.mask;
+        current.ids[i].store(TOMBSTONE, std::memory_order_release);
+        open--;
+        return s.book.exchange(nullptr);
+    }
+
     std::shared_ptr<OrderBook> get(const std::string_view& instrument) const {
-        auto hash = std::hash<std::string_view>{}(instrument);
-        const auto start = hash % MAX_INSTRUMENTS;
-        auto book = table[start].load();
-        if (book != nullptr && book->instrument == instrument) return book;
-        
-        auto index = start;
-        while (true) {
-            if (book != nullptr) {
-                index = (index + 1) % MAX_INSTRUMENTS;
-                if (index == start) return nullptr;
-                book = table[index].load();
-                if (book != nullptr && book->instrument == instrument) return book;
-            } else {
-                index = (index + 1) % MAX_INSTRUMENTS;
-                if (index == start) return nullptr;
-                book = table[index].load();
-            }
-        }
+        auto id = find(instrument);
+        return id ? get(*id) : nullptr;
+    }
+
+    /** does not take the map's lock, null if id was not returned by this map, is closed or its book was not created yet */
+    std::shared_ptr<OrderBook> get(InstrumentId id) const {
+        if (uint32_t(id) >= count.load(std::memory_order_acquire)) return nullptr;
+        return slot(uint32_t(id)).book.load();
     }
-    
+
+    /** the number of instruments registered, with or without a book and retired ones included, the ids are 0 to size() - 1 */
+    size_t size() const {
+        return count.load(std::memory_order_acquire);
+    }
+
     std::vector<std::string> instruments() const {
         std::vector<std::string> result;
-        for (int i = 0; i < MAX_INSTRUMENTS; i++) {
-            auto book = table[i].load();
-            if (book != nullptr) {
-                result.push_back(book->instrument);
-            }
+        const auto n = count.load(std::memory_order_acquire);
+        for (uint32_t id = 0; id < n; id++) {
+            if (slot(id).book.load() != nullptr) result.push_back(slot(id).instrument);
         }
         return result;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "orderbook.h"
+
+/**
+ * Client side copy of an OrderBook, rebuilt from either its LevelDelta feed or its OrderEvent feed (one feed per
+ * replica, the sequences are independent). Header-only so consumers do not need to link the engine.
+ *
+ * Levels are kept in flat vectors with the best price at the back, so updates near the touch, which dominate a
+ * delta feed, move few elements. A replica starts in sync at sequence 0, i.e. with the empty book. When an update
+ * does not continue the sequence the replica goes out of sync and buffers updates until snapshot() is called with
+ * a depth snapshot and the sequence it was taken at (OrderBook::levelDeltaSequence() under the book lock), then
+ * replays the buffered updates that follow the snapshot. At most bufferLimit updates are buffered: when the buffer is
+ * full it is dropped, and only a snapshot taken after that can bring the replica back in sync.
+ */
+class BookReplica {
+public:
+    enum Status {
+        APPLIED,
+        /** at or before the last applied sequence, ignored */
+        DUPLICATE,
+        /** the replica is out of sync, the update was buffered until snapshot() */
+        GAP,
+        /** the replica is out of sync and its buffer was full: the buffer was dropped and only this update kept */
+        DROPPED
+    };
+    /** the default number of updates buffered while out of sync */
+    static constexpr size_t DEFAULT_BUFFER_LIMIT = size_t(1) << 16;
+private:
+    struct RestingOrder {
+        F price = 0;
+        int quantity = 0;
+        Order::Side side = Order::BUY;
+    };
+    /** ascending, best bid at the back */
+    std::vector<BookLevel> bids;
+    /** descending, best ask at the back */
+    std::vector<BookLevel> asks;
+    /** OrderEvent feed only */
+    std::unordered_map<long, RestingOrder> orders;
+    uint64_t sequence = 0;
+    bool synced = true;
+    size_t bufferLimit;
+    std::vector<LevelDelta> bufferedDeltas;
+    std::vector<OrderEvent> bufferedEvents;
+
+    std::vector<BookLevel>& levels(Order::Side side) {
+        return side == Order::BUY ? bids : asks;
+    }
+    /** position of price in levels, or of the first level worse than price if there is none */
+    static std::vector<BookLevel>::iterator find(std::vector<BookLevel>& levels, Order::Side side, F price) {
+        if (side == Order::BUY) {
+            return std::lower_bound(levels.begin(), levels.end(), price, [](const BookLevel& l, const F& p) { return l.price < p; });
+        }
+        return std::lower_bound(levels.begin(), levels.end(), price, [](const BookLevel& l, const F& p) { return l.price > p; });
+    }
+    void setLevel(Order::Side side, F price, int quantity) {
+        auto& l = levels(side);
+        auto itr = find(l, side, price);
+        if (itr != l.end() && itr->price == price) {
+            if (quantity == 0) l.erase(itr);
+            else itr->quantity = quantity;
+        } else if (quantity != 0) {
+            l.insert(itr, BookLevel{price, quantity});
+        }
+    }
+    void addToLevel(Order::Side side, F price, int quantity) {
+        auto& l = levels(side);
+        auto itr = find(l, side, price);
+        if (itr != l.end() && itr->price == price) {
+            itr->quantity += quantity;
+            if (itr->quantity <= 0) l.erase(itr);
+        } else if (quantity > 0) {
+            l.insert(itr, BookLevel{price, quantity});
+        }
+    }
+    void applyUnchecked(const LevelDelta& delta) {
+        setLevel(delta.side, delta.price, delta.quantity);
+        sequence = delta.sequence;
+    }
+    void applyUnchecked(const OrderEvent& event) {
+        sequence = event.sequence;
+        if (event.type == OrderEvent::ADD) {
+            orders[event.exchangeId] = {event.price, event.remaining, event.side};
+            addToLevel(event.side, event.price, event.remaining);
+            return;
+        }
+        auto itr = orders.find(event.exchangeId);
+        if (itr == orders.end()) return;
+        auto& order = itr->second;
+        addToLevel(order.side, order.price, event.remaining - order.quantity);
+        order.quantity = event.remaining;
+        if (order.quantity == 0) orders.erase(itr);
+    }
+    template <typename Update>
+    Status apply(const Update& update, std::vector<Update>& buffered) {
+        if (update.sequence <= sequence) return DUPLICATE;
+        if (synced && update.sequence == sequence + 1) {
+            applyUnchecked(update);
+            return APPLIED;
+        }
+        synced = false;
+        if (buffered.size() >= bufferLimit) {
+            // a snapshot taken before this update could not be completed from the buffer anyway
+            buffered.clear();
+            buffered.push_back(update);
+            return DROPPED;
+        }
+        buffered.push_back(update);
+        return GAP;
+    }
+    template <typename Update>
+    void replay(std::vector<Update>& buffered) {
+        for (auto& update : buffered) {
+            if (update.sequence <= sequence) continue;
+            if (update.sequence != sequence + 1) {
+                // still missing updates, wait for a later snapshot
+                synced = false;
+                break;
+            }
+            applyUnchecked(update);
+        }
+        buffered.clear();
+    }
+    void clear(uint64_t snapshotSequence) {
+        bids.clear();
+        asks.clear();
+        orders.clear();
+        sequence = snapshotSequence;
+        synced = true;
+    }
+public:
+    /** @param bufferLimit the most updates buffered while out of sync, at least 1 */
+    explicit BookReplica(size_t bufferLimit = DEFAULT_BUFFER_LIMIT) : bufferLimit(std::max<size_t>(bufferLimit, 1)) {}
+
+    /** applies a LevelDelta feed update */
+    Status apply(const LevelDelta& delta) {
+        return apply(delta, bufferedDeltas);
+    }
+    /** applies an OrderEvent feed update */
+    Status apply(const OrderEvent& event) {
+        return apply(event, bufferedEvents);
+    }
+    /** replaces the replica with a level snapshot (best level first, as written by OrderBook::depth) */
+    void snapshot(std::span<const BookLevel> bidLevels, std::span<const BookLevel> askLevels, uint64_t snapshotSequence) {
+        clear(snapshotSequence);
+        bids.assign(bidLevels.rbegin(), bidLevels.rend());
+        asks.assign(askLevels.rbegin(), askLevels.rend());
+        replay(bufferedDeltas);
+    }
+    /** replaces the replica with an order snapshot (priority order, as written by OrderBook::depthByOrder) */
+    void snapshot(std::span<const BookOrder> bidOrders, std::span<const BookOrder> askOrders, uint64_t snapshotSequence) {
+        clear(snapshotSequence);
+        for (auto& order : bidOrders) {
+            orders[order.exchangeId] = {order.price, order.quantity, Order::BUY};
+            addToLevel(Order::BUY, order.price, order.quantity);
+        }
+        for (auto& order : askOrders) {
+            orders[order.exchangeId] = {order.price, order.quantity, Order::SELL};
+            addToLevel(Order::SELL, order.price, order.quantity);
+        }
+        replay(bufferedEvents);
+    }
+    bool inSync() const {
+        return synced;
+    }
+    /** sequence of the last update applied */
+    uint64_t lastSequence() const {
+        return sequence;
+    }
+    TopOfBook topOfBook() const {
+        TopOfBook top;
+        if (!bids.empty()) {
+            top.bidPrice = bids.back().price;
+            top.bidQuantity = bids.back().quantity;
+        }
+        if (!asks.empty()) {
+            top.askPrice = asks.back().price;
+            top.askQuantity = asks.back().quantity;
+        }
+        return top;
+    }
+    /** best level first into caller buffers, same contract as OrderBook::depth */
+    DepthSize depth(std::span<BookLevel> bidLevels, std::span<BookLevel> askLevels) const {
+        auto copy = [](const std::vector<BookLevel>& src, std::span<BookLevel> dst) {
+            const auto n = std::min(src.size(), dst.size());
+            std::copy(src.rbegin(), src.rbegin() + long(n), dst.begin());
+            return int(n);
+        };
+        return {copy(bids, bidLevels), copy(asks, askLevels)};
+    }
+    size_t levels(Order::Side side) const {
+        return side == Order::BUY ? bids.size() : asks.size();
+    }
+};
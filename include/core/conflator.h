@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "orderbook.h"
+#include "ringbuffer.h"
+#include "spinlock.h"
+
+/** a LevelDelta tagged with the index of its book in the MarketDataFanout */
+struct BookUpdate {
+    uint32_t book = 0;
+    LevelDelta delta;
+};
+
+/**
+ * Conflated view of level updates for a slow consumer. Between drains only the latest state of each changed
+ * (book, side, price) level is kept, so memory and publication cost are bounded by the number of distinct levels,
+ * not by the update rate, and the publisher never waits for the consumer.
+ *
+ * A level gets a slot when it changes and gives it back when it is drained at quantity 0, so memory follows the
+ * levels resting at once, not every price touched during the day. Levels are found through an open addressing table
+ * of slot indices and freed slots are reused, so steady state updates do not allocate; the table and the slots only
+ * grow past their largest size so far. The sequence of a conflated update is that of the latest delta it replaces,
+ * consecutive updates of a level are not contiguous.
+ */
+class ConflatedLevels {
+private:
+    struct Slot {
+        BookUpdate update;
+        size_t hash = 0;
+        /** in the table, false while on the free list */
+        bool live = false;
+        bool dirty = false;
+    };
+    SpinLock mu;
+    /** slot index + 1, 0 for an empty entry, linear probing, at most half full */
+    std::vector<uint32_t> table = std::vector<uint32_t>(64);
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint32_t> dirty;
+    /** consumer side copy, reused between drains */
+    std::vector<BookUpdate> draining;
+    uint64_t conflated = 0;
+
+    static size_t hash(const BookUpdate& update) {
+        return std::hash<double>{}(double(update.delta.price)) ^ (size_t(update.book) << 1 | size_t(update.delta.side));
+    }
+    static bool sameLevel(const BookUpdate& a, const BookUpdate& b) {
+        return a.book == b.book && a.delta.side == b.delta.side && a.delta.price == b.delta.price;
+    }
+    void insert(uint32_t slot) {
+        const auto mask = table.size() - 1;
+        auto i = slots[slot].hash & mask;
+        while (table[i]) i = (i + 1) & mask;
+        table[i] = slot + 1;
+    }
+    /** removes the slot's entry, shifting back the entries probed past it */
+    void erase(uint32_t slot) {
+        const auto mask = table.size() - 1;
+        auto i = slots[slot].hash & mask;
+        while (table[i] != slot + 1) i = (i + 1) & mask;
+        for (auto j = (i + 1) & mask; table[j]; j = (j + 1) & mask) {
+            const auto home = slots[table[j] - 1].hash & mask;
+            // the entry at j stays unless its home is cyclically outside (i, j]
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                table[i] = table[j];
+                i = j;
+            }
+        }
+        table[i] = 0;
+        slots[slot].live = false;
+        freeSlots.push_back(slot);
+    }
+    uint32_t find(const BookUpdate& update, size_t h) {
+        const auto mask = table.size() - 1;
+        for (auto i = h & mask; table[i]; i = (i + 1) & mask) {
+            const auto slot = table[i] - 1;
+            if (slots[slot].hash == h && sameLevel(slots[slot].update, update)) return slot;
+        }
+        // a new level, the table is grown to stay at most half full
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = uint32_t(slots.size());
+            slots.push_back({});
+        }
+        slots[slot].hash = h;
+        slots[slot].live = true;
+        if ((slots.size() - freeSlots.size()) * 2 > table.size()) {
+            table.assign(table.size() * 2, 0);
+            for (uint32_t s = 0; s < slots.size(); s++) {
+                if (slots[s].live) insert(s);
+            }
+        } else {
+            insert(slot);
+        }
+        return slot;
+    }
+public:
+    /** called by the publication thread */
+    void update(const BookUpdate& update) {
+        Guard guard(mu);
+        const auto index = find(update, hash(update));
+        auto& slot = slots[index];
+        slot.update = update;
+        if (slot.dirty) {
+            conflated++;
+        } else {
+            slot.dirty = true;
+            dirty.push_back(index);
+        }
+    }
+    /**
+     * calls fn(const BookUpdate&) for every level changed since the last drain, in order of first change. Levels
+     * drained at quantity 0 give their slot back
+     */
+    template <typename Fn>
+    size_t drain(Fn fn) {
+        draining.clear();
+        {
+            Guard guard(mu);
+            for (auto i : dirty) {
+                draining.push_back(slots[i].update);
+                slots[i].dirty = false;
+                if (slots[i].update.delta.quantity == 0) erase(i);
+            }
+            dirty.clear();
+        }
+        for (auto& update : draining) fn(update);
+        return draining.size();
+    }
+    /** the levels holding a slot: those changed since they were last drained at quantity 0 */
+    size_t levelCount() {
+        Guard guard(mu);
+        return slots.size() - freeSlots.size();
+    }
+    /** updates replaced by a later update of the same level before they were drained */
+    uint64_t conflatedCount() {
+        Guard guard(mu);
+        return conflated;
+    }
+};
+
+/**
+ * Conflated best bid and offer per book for a slow consumer. Uses the version of each book's top of book seqlock
+ * as the dirty flag, so it needs no publication thread and adds nothing to the matching thread.
+ */
+class ConflatedTopOfBook {
+private:
+    struct Entry {
+        std::shared_ptr<OrderBook> book;
+        uint64_t version = 0;
+    };
+    std::vector<Entry> books;
+public:
+    /** @return the index passed to drain callbacks */
+    uint32_t add(std::shared_ptr<OrderBook> book) {
+        books.push_back({std::move(book), 0});
+        return uint32_t(books.size() - 1);
+    }
+    /** calls fn(uint32_t book, const TopOfBook&) for every book whose top of book changed since the last drain */
+    template <typename Fn>
+    size_t drain(Fn fn) {
+        size_t n = 0;
+        for (uint32_t i = 0; i < books.size(); i++) {
+            auto& entry = books[i];
+            const auto version = entry.book->topOfBookVersion();
+            if (version == entry.version) continue;
+            entry.version = version;
+            fn(i, entry.book->topOfBook());
+            n++;
+        }
+        return n;
+    }
+};
+
+/**
+ * Publication stage between the books' LevelDelta feeds and their consumers. poll() drains every book once
+ * (it is the single consumer of the feeds) and passes each delta to every subscriber: full rate subscribers get
+ * every delta in their own RingBuffer, conflated subscribers get the latest state per level, see ConflatedLevels.
+ * A full subscriber buffer drops deltas for that subscriber only, the feed sequence shows the gap.
+ *
+ * A book's levelDeltas() ring has a single consumer, so a book added here must not also be added to a
+ * MarketDataPublisher, which drains the same ring; the two are mutually exclusive per book.
+ */
+class MarketDataFanout {
+private:
+    SpinLock mu;
+    std::vector<std::shared_ptr<OrderBook>> books;
+    std::vector<std::shared_ptr<RingBuffer<BookUpdate>>> streams;
+    std::vector<std::shared_ptr<ConflatedLevels>> conflated;
+    uint64_t dropped = 0;
+public:
+    /** @return the book index carried by BookUpdate */
+    uint32_t add(std::shared_ptr<OrderBook> book);
+    /** a subscriber that receives every delta, it must drain faster than capacity deltas accumulate */
+    std::shared_ptr<RingBuffer<BookUpdate>> subscribe(size_t capacity);
+    std::shared_ptr<ConflatedLevels> subscribeConflated();
+    /** drains every book once, @return the number of deltas read */
+    size_t poll();
+    /** deltas not delivered to a full rate subscriber because its buffer was full */
+    uint64_t droppedCount() {
+        Guard guard(mu);
+        return dropped;
+    }
+};
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <string>
+#include <map>
 #include <optional>
 #include <ranges>
+#include <span>
 #include <memory>
 #include <vector>
 
@@ -11,12 +13,19 @@
 #include "bookmap.h"
 #include "spinlock.h"
 #include "ordermap.h"
+#include "journal.h"
+#include "protection.h"
 
 struct ExchangeListener {
     /** callback when order properties change */
     virtual void onOrder(const Order& order) {}
     /** callback when trade occurs */
     virtual void onTrade(const Trade& trade) {}
+    /**
+     * callback when a session's market maker protection tripped, after its quotes were pulled from every book. On
+     * a replay the other books' quotes are pulled by the journaled PULL records that follow.
+     */
+    virtual void onProtectionTrip(std::string_view sessionId) {}
 };
 
 static ExchangeListener dummy;
@@ -24,11 +33,35 @@ static ExchangeListener dummy;
 // Simplified result types for compatibility
 using OrderResult = std::optional<long>;
 using CancelResult = bool;
+using ModifyResult = bool;
+
+/** one quote of a massQuote, the same fields as Exchange::quote */
+struct QuoteEntry {
+    std::string_view instrument;
+    std::string_view quoteId;
+    F bidPrice = 0;
+    int bidQuantity = 0;
+    F askPrice = 0;
+    int askQuantity = 0;
+};
+
+/** outcome of a QuoteEntry */
+enum class QuoteStatus : uint8_t {
+    ACCEPTED,
+    /** a negative quantity */
+    INVALID,
+    /** the instrument has no book and there is no room in the books map to create one, or it was closed */
+    NO_BOOK,
+    /** the session's market maker protection tripped, see Exchange::setProtection */
+    PROTECTED
+};
 
 class Exchange : OrderBookListener {
 public:
     Exchange() : listener(dummy) {}
     explicit Exchange(ExchangeListener& listener) : listener(listener) {}
+    /** @param configure chooses the InstrumentConfig (e.g. PriceLevels container) when an instrument's book is created */
+    Exchange(ExchangeListener& listener, InstrumentConfigHook configure) : configure(std::move(configure)), listener(listener) {}
     
     // Simplified API using std::optional for now
     OrderResult buy(
@@ -74,12 +107,130 @@ public:
         int askQuantity,
         std::string_view quoteId
     );
+
+    /**
+     * registers the instrument if it is new, its book is created by the first order or quote. The id replaces the
+     * name in the overloads below, which index the book directly instead of hashing the name.
+     * @throws std::runtime_error if no room is left
+     */
+    InstrumentId registerInstrument(std::string_view instrument);
+    /** @return nullopt if instrument is not a registered id */
+    OrderResult buy(std::string_view sessionId, InstrumentId instrument, F price, int quantity, std::string_view orderId = "");
+    OrderResult sell(std::string_view sessionId, InstrumentId instrument, F price, int quantity, std::string_view orderId = "");
+    /** ignored if instrument is not a registered id */
+    void quote(
+        std::string_view sessionId,
+        InstrumentId instrument,
+        F bidPrice,
+        int bidQuantity,
+        F askPrice,
+        int askQuantity,
+        std::string_view quoteId
+    );
+    /**
+     * closes an instrument, e.g. an expired series: its resting orders and quotes are cancelled, the id no longer
+     * resolves and the book is released, destroyed once no reader holds it. The name may be registered again as a
+     * new instrument. The instrument's orders stay in getAllOrders() but getOrder() and snapshots no longer include
+     * them. The id is never reused and the instrument's name and id slot are kept for the life of the exchange, see
+     * BookMap::retire. Journaled. @return false if instrument is not an open instrument
+     */
+    bool closeInstrument(InstrumentId instrument);
+    bool closeInstrument(std::string_view instrument);
     
+    /**
+     * quotes many instruments in one call, each entry as quote() would. Entries are grouped by instrument, so every
+     * book is looked up and locked once; entries of the same instrument are applied in their order. The status of
+     * entries[i] is written to status[i]. @return the number accepted
+     * @throws std::invalid_argument if status is smaller than entries
+     */
+    size_t massQuote(std::string_view sessionId, std::span<const QuoteEntry> entries, std::span<QuoteStatus> status);
+
     // Simplified error handling
     CancelResult cancel(long exchangeId, std::string_view sessionId);
+    /**
+     * cancel/replace of a resting order, keeping its exchange id: price and quantity (the new total, filled
+     * included) as OrderBook::modifyOrder. A size-down at the same price keeps the order's priority.
+     */
+    ModifyResult modify(long exchangeId, std::string_view sessionId, F price, int quantity);
+
+    /**
+     * market maker protection of the session's quotes: when the quantity or number of fills of its quotes within
+     * config.window reaches a limit, every quote of the session is pulled from every book and its quotes are
+     * rejected until setProtection() is called again, which also re-arms a tripped session. Trades are counted as
+     * they match and, from the trip, the command that tripped it pulls the session's quotes rather than trading
+     * them. The quotes on other books are pulled right after that command, each journaled as a PULL record under
+     * its book lock so that a replay pulls them at the same point; until then they may still trade. Journaled.
+     */
+    void setProtection(std::string_view sessionId, const ProtectionConfig& config);
+    /** true if the session's protection tripped and was not re-armed */
+    bool isProtectionTripped(std::string_view sessionId);
     
     std::optional<Book> book(std::string_view instrument) const;
+    /** level-aggregated depth into caller buffers, see OrderBook::depth; nothing is allocated */
+    std::optional<DepthSize> depth(std::string_view instrument, std::span<BookLevel> bids, std::span<BookLevel> asks) const;
+    /** resting orders of one side in priority order into a caller buffer, returns the number written */
+    std::optional<int> depthByOrder(std::string_view instrument, Order::Side side, std::span<BookOrder> orders) const;
+    /** best bid and offer without taking the book lock, suitable for high frequency polling */
+    std::optional<TopOfBook> topOfBook(std::string_view instrument) const;
+    std::optional<TopOfBook> topOfBook(InstrumentId instrument) const;
+    /** the instrument's book, e.g. to drain OrderBook::levelDeltas(), or null if the instrument has no book */
+    std::shared_ptr<OrderBook> orderBook(std::string_view instrument) const;
+    std::shared_ptr<OrderBook> orderBook(InstrumentId instrument) const;
     std::optional<Order> getOrder(long exchangeId) const;
+
+    /**
+     * replaces the system clock as the source of journal timestamps and trade execIds, e.g. so that a replay
+     * reproduces them. Set before trading starts, books created earlier keep the system clock.
+     */
+    void setClock(ClockHook clock) {
+        this->clock = std::move(clock);
+    }
+    /** replaces the id counter as the source of exchange ids, e.g. with the ids recorded in a journal. Set before trading starts */
+    void setIdGenerator(std::function<long()> ids) {
+        this->ids = std::move(ids);
+    }
+
+    /**
+     * journal every accepted command to journal before it is applied, set before trading starts (e.g. after
+     * recover()). The journal is written on the matching path without allocating or locking.
+     */
+    void setJournal(std::shared_ptr<Journal> journal) {
+        this->journal = std::move(journal);
+    }
+    /**
+     * rebuilds the books by replaying the journal in directory, exchange ids are those recorded and the id
+     * counter continues after the highest. Call on an empty Exchange, or after loadSnapshot() of a snapshot of the
+     * same journal, which replays only the commands after it; before setJournal(). @return the commands replayed
+     */
+    size_t recover(const std::string& directory);
+    /**
+     * applies one journaled command as recover() does: with the recorded ids and without journaling it. Used by
+     * a JournalFollower to keep a standby in step with the primary.
+     */
+    void apply(const JournalEntry& entry);
+    /**
+     * while set, the exchange replays a journal through the public API (JournalReplay, ParallelReplay): a trip
+     * pulls the session's quotes only from the book of the command that tripped it, the others are pulled by the
+     * PULL records passed to apply(), and journaled quotes are not rejected as PROTECTED. No commands may be
+     * processed while it changes.
+     */
+    void setReplaying(bool replaying) {
+        this->replaying = replaying;
+    }
+    /**
+     * writes every book (resting orders in priority order), every order known to getOrder(), the quotes, each
+     * session's market maker protection (limits, fills within the window, tripped), the id counter and the position
+     * of the attached journal to a versioned binary file, replacing path atomically. No commands may be processed
+     * meanwhile.
+     * @throws std::runtime_error on I/O errors
+     */
+    void saveSnapshot(const std::string& path);
+    /**
+     * restores a snapshot written by saveSnapshot() into an empty Exchange. The file is mapped and the books are
+     * rebuilt directly from the recorded priority order, nothing is matched and no listener is called.
+     * @return the number of orders restored, @throws std::runtime_error if the file is unreadable or not a snapshot
+     */
+    size_t loadSnapshot(const std::string& path);
     
     // Modern range-based API
     auto getAllOrders() const {
@@ -96,6 +247,8 @@ public:
     void onTrade(const Trade& trade) override {
         listener.onTrade(trade);
     }
+    void onQuoteFill(const Order& quote, int quantity) override;
+    bool pullsQuote(const Order& quote) override;
     Guard lock() {
         return Guard(mu);
     }
@@ -113,18 +266,87 @@ private:
     BookMap books;
     OrderMap allOrders;
     SpinLock mu;
+    InstrumentConfigHook configure;
+    std::shared_ptr<Journal> journal;
+    /** where recover() starts, the journal position of the snapshot loaded */
+    JournalPosition recoverFrom;
+    std::atomic<long> lastId{0};
+    ClockHook clock;
+    std::function<long()> ids;
+    bool replaying = false;
+    /** the names of closed instruments, which their orders reference, guarded by mu */
+    std::vector<std::shared_ptr<const std::string>> closedNames;
+    /** per quoting session, created with its first quote and never removed */
+    std::map<std::string, std::unique_ptr<SessionProtection>, std::less<>> protections;
+    SpinLock protectionsLock;
+    /** the configure hook, plus the exchange's clock */
+    const InstrumentConfigHook bookConfigure = [this](std::string_view instrument) {
+        auto config = configure ? configure(instrument) : InstrumentConfig{};
+        if (clock) config.clock = clock;
+        return config;
+    };
+    std::chrono::nanoseconds now() const {
+        return clock ? clock() : std::chrono::duration_cast<std::chrono::nanoseconds>(epoch());
+    }
     
     // C++26: Modern atomic ID generation
     long nextID();
     
+    /** @param replayId the id to use when replaying a journal, 0 to assign and journal a new id */
     OrderResult insertOrder(
         std::string_view sessionId,
         std::string_view instrument,
         F price,
         int quantity,
         Order::Side side,
-        std::string_view orderId
+        std::string_view orderId,
+        long replayId = 0
+    );
+    OrderResult insertOrder(
+        std::string_view sessionId,
+        const std::shared_ptr<OrderBook>& book,
+        F price,
+        int quantity,
+        Order::Side side,
+        std::string_view orderId,
+        long replayId = 0
+    );
+    /** @param replay the recorded command when replaying a journal, ids come from it and nothing is journaled */
+    void quote(
+        std::string_view sessionId,
+        std::string_view instrument,
+        F bidPrice,
+        int bidQuantity,
+        F askPrice,
+        int askQuantity,
+        std::string_view quoteId,
+        const JournalRecord* replay
+    );
+    /** quote() on a book already locked by the caller, @return ACCEPTED, PROTECTED or NO_BOOK if the book was closed */
+    QuoteStatus quoteLocked(
+        OrderBook& book,
+        std::string_view sessionId,
+        F bidPrice,
+        int bidQuantity,
+        F askPrice,
+        int askQuantity,
+        std::string_view quoteId,
+        const JournalRecord* replay
     );
+    CancelResult cancel(long exchangeId, std::string_view sessionId, bool replay);
+    ModifyResult modify(long exchangeId, std::string_view sessionId, F price, int quantity, bool replay);
+    void setProtection(std::string_view sessionId, const ProtectionConfig& config, bool replay);
+    bool closeInstrument(InstrumentId instrument, bool replay);
+    /** the open book the order was entered on, null if its instrument was closed */
+    std::shared_ptr<OrderBook> bookOf(const Order& order) const;
+    SessionProtection& sessionProtection(std::string_view sessionId);
+    /**
+     * pulls the quotes of the sessions tripped by the calling thread's last command, called without a book locked.
+     * When replaying, the trips are only reported, the journal's PULL records pull the quotes.
+     */
+    void pullTripped();
+    /** pulls one side of a quote from book, locked by the caller, journaling a PULL record unless replay */
+    void pullQuote(OrderBook& book, const std::shared_ptr<Order>& quote, bool replay);
     
     ExchangeListener& listener;
 };
\ No newline at end of file
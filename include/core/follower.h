@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "exchange.h"
+#include "journal.h"
+#include "latency.h"
+#include "spinlock.h"
+
+/**
+ * Hot standby: keeps an Exchange in step with a primary by applying the primary's journal as it is written, from
+ * another process or host sharing the directory. The standby assigns no ids and journals nothing, so after
+ * promote() its books, orders, quotes and id counter are those the primary had journaled. The exchange must not
+ * take commands of its own until then.
+ */
+class JournalFollower {
+private:
+    Exchange& exchange;
+    JournalTailer tailer;
+    std::atomic<bool> running{false};
+    std::thread thread;
+    std::atomic<uint64_t> count{0};
+    std::atomic<int64_t> lastLag{0};
+    /** journal-to-applied delay of every command applied, the lock is held while polling */
+    LatencyHistogram histogram;
+    mutable SpinLock histogramLock;
+public:
+    /** follows the journal in directory, which may not exist yet, from its first command */
+    JournalFollower(Exchange& exchange, const std::string& directory);
+    ~JournalFollower();
+    JournalFollower(const JournalFollower&) = delete;
+    JournalFollower& operator=(const JournalFollower&) = delete;
+
+    /** applies every command journaled since the last poll on the calling thread, @return the count */
+    size_t poll();
+    /** polls on a background thread, sleeping idleSleep whenever the journal has nothing new (0 to spin) */
+    void start(std::chrono::microseconds idleSleep = std::chrono::microseconds(50));
+    /** stops the background thread, if any */
+    void stop();
+    /**
+     * takes over from a failed primary: stops following and applies what remains of the journal, skipping records
+     * the primary left torn, so the standby matches a recover() of the same directory. Then journal to a new Journal
+     * on the same directory (it continues in a new segment) and start trading. @return the commands applied in total
+     */
+    uint64_t promote();
+
+    /** commands applied so far */
+    uint64_t applied() const {
+        return count.load(std::memory_order_relaxed);
+    }
+    /** time from journaling to applying of the last command applied, by the journal's (system) clock */
+    std::chrono::nanoseconds lag() const {
+        return std::chrono::nanoseconds(lastLag.load(std::memory_order_relaxed));
+    }
+    /** distribution of lag() over every command applied */
+    LatencyHistogram lagHistogram() const;
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "order.h"
+
+/** when journal writes are forced to stable storage */
+enum class JournalSync {
+    /** left to the OS page cache, survives a process crash but not a host crash */
+    NONE,
+    /** a background thread syncs everything written every JournalConfig::groupCommitInterval */
+    GROUP,
+    /** every command is synced before it is applied, on the matching thread */
+    EVERY
+};
+
+struct JournalConfig {
+    std::string directory;
+    /** segment files are preallocated to this size, a command never spans segments */
+    size_t segmentSize = 64 << 20;
+    JournalSync sync = JournalSync::NONE;
+    std::chrono::microseconds groupCommitInterval{200};
+};
+
+/**
+ * fixed part of a journaled command, followed by the session id, instrument and client order/quote id bytes and
+ * padded to a multiple of 8. The layout is the on-disk format. size is stored as soon as the space is reserved and
+ * complete once the whole record is written, so a record torn by a crash is skipped without losing the records
+ * after it.
+ */
+struct JournalRecord {
+    enum Type : uint8_t { BUY, SELL, QUOTE, CANCEL, MODIFY, PROTECT, CLOSE, PULL };
+    /** 0 marks the end of the written data, SEGMENT_END that the journal continues in the next segment */
+    uint32_t size = 0;
+    Type type = BUY;
+    /** 1 once the record is written, still 0 for a record being written or torn by a crash */
+    uint8_t complete = 0;
+    uint16_t sessionLength = 0;
+    uint16_t instrumentLength = 0;
+    uint16_t clientIdLength = 0;
+    /** bid quantity for QUOTE, the new total quantity for MODIFY, the quantity limit for PROTECT */
+    int32_t quantity = 0;
+    /** ask quantity for QUOTE, the fill limit for PROTECT */
+    int32_t askQuantity = 0;
+    /**
+     * the id assigned to the order, the id of the bid of a QUOTE, new or existing (0 if the quote has no bid), or
+     * the order to CANCEL or MODIFY, the quote order of a tripped session pulled from its book for PULL
+     */
+    int64_t exchangeId = 0;
+    /** the id of the ask of a QUOTE, new or existing (0 if the quote has no ask), the window in nanoseconds for PROTECT */
+    int64_t askExchangeId = 0;
+    /** nanoseconds since the epoch when the command was journaled */
+    int64_t timestamp = 0;
+    /** bid price for QUOTE, the new price for MODIFY */
+    F price = 0;
+    F askPrice = 0;
+
+    static constexpr uint32_t SEGMENT_END = UINT32_MAX;
+};
+static_assert(sizeof(JournalRecord) == 64, "JournalRecord is the on-disk format");
+
+/** a point in a journal, the segment file number and a record offset in it; replay can start there */
+struct JournalPosition {
+    int segment = 0;
+    size_t offset = 0;
+};
+
+/** a journaled command as seen by replay, the strings point into the mapped journal */
+struct JournalEntry {
+    const JournalRecord& record;
+    std::string_view sessionId;
+    std::string_view instrument;
+    std::string_view clientId;
+};
+
+/**
+ * Append-only write-ahead journal of Exchange commands in preallocated, memory mapped segment files. Appends from
+ * any number of threads reserve space with a single atomic add and copy the record into the mapping, so the
+ * matching path neither allocates nor locks; a record becomes visible to readers when complete is stored last.
+ * Only a crash between reserving space and storing the record's size, a few instructions, still ends its segment.
+ * Rolling over to a new segment (once per segmentSize bytes) takes a mutex and creates the next file.
+ */
+class Journal {
+private:
+    struct Segment {
+        char* base = nullptr;
+        size_t capacity = 0;
+        std::atomic<size_t> reserved{0};
+        /** bytes known to be on stable storage, group commit only */
+        size_t synced = 0;
+        /** of the segment file name */
+        int number = 0;
+    };
+    const JournalConfig config;
+    std::vector<std::unique_ptr<Segment>> segments;
+    std::atomic<Segment*> current{nullptr};
+    int nextSegment = 0;
+    std::mutex rollover;
+    std::atomic<bool> running{false};
+    std::thread syncThread;
+
+    void openSegment();
+    void syncSegments();
+    void write(Segment* segment, size_t offset, const JournalRecord& header, std::string_view session,
+               std::string_view instrument, std::string_view clientId);
+public:
+    /** creates the directory if needed, journaling continues in a new segment after any existing ones */
+    explicit Journal(const JournalConfig& config);
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /** record.size is computed, the remaining fields are copied as is */
+    void append(JournalRecord record, std::string_view sessionId, std::string_view instrument, std::string_view clientId);
+    /** forces everything appended so far to stable storage */
+    void sync();
+    /** the end of what has been appended so far, exact only while no append is in progress */
+    JournalPosition position() const;
+
+    /**
+     * calls fn(const JournalEntry&) for every complete command in directory, in journal order, skipping records torn
+     * by a crash, starting at from, @return the count
+     */
+    static size_t replay(const std::string& directory, const std::function<void(const JournalEntry&)>& fn, JournalPosition from = {});
+    /** segment file names of directory in journal order */
+    static std::vector<std::string> segmentFiles(const std::string& directory);
+};
+
+/**
+ * Follows a journal while it is being written, e.g. by another process: each poll() returns the commands completed
+ * since the previous one, continuing into the next segment once the writer has moved on. Segments are mapped
+ * shared, so a journal directory on tmpfs (/dev/shm) makes this a shared memory stream. A record still being
+ * written is waited for, so the tailer does not get past one torn by a crash of the writer until writerStopped()
+ * says no record will be completed anymore.
+ */
+class JournalTailer {
+private:
+    const std::string directory;
+    std::string path;
+    const char* base = nullptr;
+    size_t capacity = 0;
+    size_t offset = 0;
+    bool stopped = false;
+
+    /** maps the segment after the current one, @return false if the writer has not created it yet */
+    bool openNext();
+public:
+    explicit JournalTailer(std::string directory);
+    ~JournalTailer();
+    JournalTailer(const JournalTailer&) = delete;
+    JournalTailer& operator=(const JournalTailer&) = delete;
+
+    /** calls fn(const JournalEntry&) for the commands completed since the last call, in journal order, @return the count */
+    size_t poll(const std::function<void(const JournalEntry&)>& fn, size_t max = SIZE_MAX);
+    /**
+     * the writer is known to be dead, e.g. a failed primary: from now on poll() reads the rest as Journal::replay()
+     * does, skipping records torn by the crash and space reserved but never sized
+     */
+    void writerStopped() {
+        stopped = true;
+    }
+};
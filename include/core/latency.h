@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Fixed-memory log-linear latency histogram (values in nanoseconds). Each power of two is split into
+ * 64 sub-buckets, so reported percentiles are within ~1.5% of the recorded value. Recording never allocates.
+ */
+class LatencyHistogram {
+    static constexpr int SUB_BITS = 7;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int HALF = SUB_BUCKETS / 2;
+    static constexpr int N_BUCKETS = (64 - SUB_BITS + 1) * HALF + HALF;
+
+    std::array<uint64_t, N_BUCKETS> counts{};
+    uint64_t total = 0;
+    uint64_t _max = 0;
+    uint64_t _min = UINT64_MAX;
+
+    static int indexOf(uint64_t value) {
+        int shift = std::max(0, int(std::bit_width(value)) - SUB_BITS);
+        return shift * HALF + int(value >> shift);
+    }
+    /** highest value that maps to the same bucket */
+    static uint64_t valueOf(int index) {
+        if (index < SUB_BUCKETS) return uint64_t(index);
+        int shift = index / HALF - 1;
+        uint64_t sub = uint64_t(index - shift * HALF);
+        return ((sub + 1) << shift) - 1;
+    }
+public:
+    void record(uint64_t nanos) {
+        counts[indexOf(nanos)]++;
+        total++;
+        _max = std::max(_max, nanos);
+        _min = std::min(_min, nanos);
+    }
+    void record(std::chrono::nanoseconds duration) {
+        record(uint64_t(std::max<int64_t>(0, duration.count())));
+    }
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < N_BUCKETS; i++) counts[i] += other.counts[i];
+        total += other.total;
+        _max = std::max(_max, other._max);
+        _min = std::min(_min, other._min);
+    }
+    void reset() {
+        counts.fill(0);
+        total = 0; _max = 0; _min = UINT64_MAX;
+    }
+    /** @param pct percentile in the range [0,100] */
+    uint64_t percentile(double pct) const {
+        if (total == 0) return 0;
+        if (pct >= 100.0) return _max;
+        auto target = std::max<uint64_t>(1, uint64_t(double(total) * pct / 100.0 + 0.5));
+        uint64_t seen = 0;
+        for (int i = 0; i < N_BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= target) return std::min(valueOf(i), _max);
+        }
+        return _max;
+    }
+    uint64_t count() const { return total; }
+    uint64_t max() const { return _max; }
+    uint64_t min() const { return total == 0 ? 0 : _min; }
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "orderbook.h"
+#include "shmring.h"
+#include "spinlock.h"
+
+/**
+ * Copies the LevelDelta and OrderEvent feeds of a set of books into a shared memory ring, so consumers in other
+ * processes on the host can follow the books with ShmRingReader. The publisher is the single consumer of each
+ * book's feeds and runs on its own thread, the matching thread only pays for writing the book's RingBuffers.
+ *
+ * Trades are reconstructed from the EXECUTE event pairs of the order feed (resting order first, then aggressor),
+ * so books need InstrumentConfig::orderEventCapacity for ORDER and TRADE records and levelDeltaCapacity for LEVEL
+ * records. The two feeds of a book are sequenced independently and are not interleaved in operation order.
+ *
+ * The book's feeds are single consumer rings, so a book added here must not also be added to a MarketDataFanout,
+ * which drains the same levelDeltas() ring; the two are mutually exclusive per book.
+ */
+class MarketDataPublisher {
+private:
+    struct Source {
+        std::shared_ptr<OrderBook> book;
+        MarketDataRecord prototype;
+        /** first event of an EXECUTE pair, valid if sequence != 0 */
+        OrderEvent execute;
+    };
+    ShmRingWriter ring;
+    SpinLock mu;
+    std::vector<Source> sources;
+    std::atomic<bool> running{false};
+    std::thread thread;
+    size_t poll(Source& source);
+public:
+    /** @param name the POSIX shared memory name, e.g. "/orderbook.md" */
+    MarketDataPublisher(const std::string& name, size_t capacity) : ring(name, capacity) {}
+    ~MarketDataPublisher() {
+        stop();
+    }
+    /** the book's feeds must not be drained by anyone else */
+    void add(std::shared_ptr<OrderBook> book);
+    /** drains every book once, @return the number of records written to the ring */
+    size_t poll();
+    /** polls on a background thread until stop() */
+    void start();
+    void stop();
+    uint64_t published() const {
+        return ring.published();
+    }
+};
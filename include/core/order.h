@@ -15,12 +15,14 @@ typedef Fixed<7> F;
 class Exchange;
 class OrderList;
 class OrderMap;
+class SessionProtection;
 
 struct Order;
 
 class Node {
 friend class OrderList;
 friend struct Order;
+friend class SessionProtection;
 private:
     std::shared_ptr<Node> prev = nullptr;
     std::shared_ptr<Node> next = nullptr;
@@ -33,10 +35,13 @@ public:
     enum Side { BUY, SELL};
 
 friend class OrderBook;
+template<typename> friend class BasicOrderBook;
 friend class OrderList;
 friend class OrderMap;
 friend class Exchange;
+friend class OrderBookListener;
 friend class TestOrder;
+friend class SessionProtection;
 template<typename> friend class PointerPriceLevels;
 template<typename> friend class StructPriceLevels;
 template<typename> friend class MapPriceLevels;
@@ -52,13 +57,23 @@ template<typename> friend class MapPtrPriceLevels;
         Order::Side side,
         long exchangeId
     ) {
-        return std::shared_ptr<Order>(new Order(sessionId, orderId, instrument, price, quantity, side, exchangeId));
+        // a single allocation for the order and its control block
+        struct Allocated : Order {
+            Allocated(const std::string& sessionId, const std::string& orderId, const std::string& instrument, F price, int quantity, Order::Side side, long exchangeId)
+                : Order(sessionId, orderId, instrument, price, quantity, side, exchangeId) {}
+        };
+        return std::make_shared<Allocated>(sessionId, orderId, instrument, price, quantity, side, exchangeId);
     }
 private:
     /** used to enqueue Order in OrderMap */
     std::shared_ptr<Order> next = nullptr;
     /** holds Node in OrderList for quick removal */
     std::shared_ptr<Node> node;
+    /** the market maker protection of a quote's session, null for orders */
+    SessionProtection* protection = nullptr;
+    /** the session's adjacent resting quote orders, see SessionProtection */
+    Order* prevProtected = nullptr;
+    Order* nextProtected = nullptr;
     const TimePoint timeSubmitted;
 
     int remaining;
@@ -80,6 +95,7 @@ private:
     void cancel() { remaining = 0; }
     bool isMarket() { return _price == DBL_MAX || _price == -DBL_MAX; } // could add "type" property, but not necessary for only limit and market orders
 
+public:
     const std::string& sessionId() const { return _sessionId; }
     const std::string& orderId() const { return _orderId; }
     const std::string &instrument; 
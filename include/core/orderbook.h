@@ -7,35 +7,117 @@
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <span>
+#include <functional>
+#include <chrono>
 
 #include "order.h"
 #include "spinlock.h"
+#include "seqlock.h"
+#include "ringbuffer.h"
 #include "pricelevels.h"
+#include "quoteregistry.h"
+#include "protection.h"
 
 struct Trade {
-    friend class OrderBook;
+    template<typename> friend class BasicOrderBook;
 private:
-    Trade(F price, int quantity, const Order& aggressor, const Order& opposite) 
-        : price(price), quantity(quantity), aggressor(aggressor), opposite(opposite) {}
+    Trade(F price, int quantity, const Order& aggressor, const Order& opposite, long execId) 
+        : price(price), quantity(quantity), aggressor(aggressor), opposite(opposite), execId(execId) {}
 public:
     const F price;
     const int quantity;
     const Order& aggressor;
     const Order& opposite;
-    const long execId = epoch().count();
+    /** nanoseconds since the epoch of the book's clock when the trade occurred */
+    const long execId;
 };
 
+/** time source as nanoseconds since the epoch, replaceable so that a replay reproduces every timestamp */
+using ClockHook = std::function<std::chrono::nanoseconds()>;
+
 typedef void (*TradeReceiver)(Trade);
 
 class OrderBookListener {
 public:
     virtual void onOrder(const Order& order) {}
     virtual void onTrade(const Trade& trade) {}
+    /** a quote with market maker protection traded quantity, called before onTrade() with the book locked */
+    virtual void onQuoteFill(const Order& quote, int quantity) {}
+    /** a quote with market maker protection is about to trade, @return true to pull it instead, called with the book locked */
+    virtual bool pullsQuote(const Order& quote) {
+        return quote.protection->isTripped();
+    }
 };
 
 struct BookLevel {
-    F price;
-    int quantity;
+    F price = 0;
+    int quantity = 0;
+};
+
+/** an order resting in the book, as reported by OrderBook::depthByOrder */
+struct BookOrder {
+    long exchangeId = 0;
+    F price = 0;
+    int quantity = 0;
+};
+
+/** number of entries written into the caller's buffers by a depth snapshot */
+struct DepthSize {
+    int bids = 0;
+    int asks = 0;
+};
+
+/** best bid and offer, a quantity of 0 means that side of the book is empty */
+struct TopOfBook {
+    F bidPrice = 0;
+    int bidQuantity = 0;
+    F askPrice = 0;
+    int askQuantity = 0;
+    bool operator==(const TopOfBook& other) const {
+        return bidQuantity==other.bidQuantity && askQuantity==other.askQuantity && bidPrice==other.bidPrice && askPrice==other.askPrice;
+    }
+};
+
+/**
+ * market-by-price update, the new aggregate quantity of a level, 0 if the level was removed. Deltas are
+ * coalesced per book operation, so a level touched several times by one operation is reported once.
+ */
+struct LevelDelta {
+    /** per book, increases by 1 with every delta published, a gap means deltas were dropped */
+    uint64_t sequence = 0;
+    F price = 0;
+    int quantity = 0;
+    Order::Side side = Order::BUY;
+};
+
+/**
+ * market-by-order (L3) record, fixed size so the stream can stay enabled in production. Replaying the events of
+ * a book in sequence order reproduces its resting orders.
+ */
+struct OrderEvent {
+    enum Type : uint8_t {
+        /** the order was added to the book with quantity resting at price */
+        ADD,
+        /** the resting quantity was reduced by quantity without a trade, the order keeps its priority */
+        REDUCE,
+        /** the order was deleted from the book without a trade, quantity is the quantity that was resting (not named DELETE, a windows.h macro) */
+        REMOVE,
+        /**
+         * quantity traded at price, the order is removed from the book if remaining is 0. An incoming order executes
+         * before it is added, only a residual that rests is reported by an ADD
+         */
+        EXECUTE
+    };
+    /** per book, increases by 1 with every event published, a gap means events were dropped */
+    uint64_t sequence = 0;
+    long exchangeId = 0;
+    F price = 0;
+    int quantity = 0;
+    /** quantity resting after the event */
+    int remaining = 0;
+    Order::Side side = Order::BUY;
+    Type type = ADD;
 };
 
 struct Book {
@@ -56,12 +138,6 @@ inline std::ostream& operator<<(std::ostream& os, const Book& book) {
     return os;
 }
 
-// map of Session+QuoteId to the associated orders, or null if no quote on that side
-struct QuoteOrders {
-    std::shared_ptr<Order> bid = nullptr;
-    std::shared_ptr<Order> ask = nullptr;
-};
-
 struct SessionQuoteId {
     const std::string sessionId;
     const std::string quoteId;
@@ -80,29 +156,155 @@ inline std::ostream& operator<<(std::ostream& os, const SessionQuoteId& id) {
 
 class Exchange;
 
-/** OrderBook instances are single threaded and must be externally synchronized using mu or lock() */
+/** the PriceLevels implementations an OrderBook can be instantiated with, see pricelevels.h */
+enum class PriceLevelsType { DEQUE_PTR, VECTOR_PTR, VECTOR, STD_MAP, STD_MAP_PTR };
+
+/** per-instrument settings, applied when the instrument's OrderBook is created */
+struct InstrumentConfig {
+    /** few active levels favor the vector containers, wide sparse books favor the maps */
+    PriceLevelsType levels = PriceLevelsType::VECTOR;
+    /** capacity of the LevelDelta buffer, 0 disables the market-by-price feed */
+    size_t levelDeltaCapacity = 0;
+    /** capacity of the OrderEvent buffer, 0 disables the market-by-order feed */
+    size_t orderEventCapacity = 0;
+    /** time source of trade execIds, the system clock if empty. Exchange sets it to its own clock */
+    ClockHook clock = nullptr;
+};
+
+/** hook called once per instrument, when its OrderBook is first created */
+using InstrumentConfigHook = std::function<InstrumentConfig(std::string_view instrument)>;
+
+/**
+ * OrderBook instances are single threaded and must be externally synchronized using mu or lock().
+ * OrderBook holds the state shared by all book types, the matching logic is in BasicOrderBook which is
+ * instantiated per PriceLevels type, so only the entry points are dispatched virtually: one indirect call per
+ * command, the matching loop and the container calls are bound statically. Callers that know the type can use
+ * BasicOrderBook directly, its entry points are final (see BM_BookVirtual in pricelevels_benchmark_test).
+ */
 class OrderBook {
-private:
+protected:
     SpinLock mu;
-    PriceLevels bids = PriceLevels(false);    
-    PriceLevels asks = PriceLevels(true);
     OrderBookListener& listener;
-    void matchOrders(Order::Side aggressorSide);
-    std::map<SessionQuoteId,QuoteOrders> quotes;
+    QuoteRegistry quotes;
+    /** updated by the book after every operation that changes the best levels */
+    SeqLock<TopOfBook> top;
+    /** level changes, null if the feed is disabled */
+    const std::unique_ptr<RingBuffer<LevelDelta>> deltas;
+    uint64_t deltaSequence = 0;
+    std::atomic<uint64_t> droppedDeltas{0};
+    /** per-order events, null if the feed is disabled */
+    const std::unique_ptr<RingBuffer<OrderEvent>> events;
+    uint64_t eventSequence = 0;
+    std::atomic<uint64_t> droppedEvents{0};
+    const ClockHook clock;
+    /** set under the lock when the instrument is closed */
+    bool closed = false;
+    std::chrono::nanoseconds now() const {
+        return clock ? clock() : std::chrono::duration_cast<std::chrono::nanoseconds>(epoch());
+    }
+private:
+    /** owns the instrument name, which the book's orders reference and may outlive the book */
+    const std::shared_ptr<const std::string> name;
     
 public:
-    const std::string instrument;
-    OrderBook(const std::string &instrument, OrderBookListener& listener) : listener(listener), instrument(instrument) {}
-    ~OrderBook() = default;
+    const std::string& instrument;
+    OrderBook(const std::string &instrument, OrderBookListener& listener, const InstrumentConfig& config = {})
+        : listener(listener),
+          deltas(config.levelDeltaCapacity ? std::make_unique<RingBuffer<LevelDelta>>(config.levelDeltaCapacity) : nullptr),
+          events(config.orderEventCapacity ? std::make_unique<RingBuffer<OrderEvent>>(config.orderEventCapacity) : nullptr),
+          clock(config.clock),
+          name(std::make_shared<const std::string>(instrument)),
+          instrument(*name) {}
+    virtual ~OrderBook() = default;
+    OrderBook(const OrderBook&) = delete;
+    OrderBook& operator=(const OrderBook&) = delete;
 
-    void insertOrder(std::shared_ptr<Order> order);
-    int cancelOrder(std::shared_ptr<Order> order);
+    /** creates an OrderBook using the PriceLevels implementation selected by config */
+    static std::shared_ptr<OrderBook> create(const std::string& instrument, OrderBookListener& listener, const InstrumentConfig& config = {});
 
-    QuoteOrders getQuotes(const std::string& sessionId, const std::string& quoteId, std::function<QuoteOrders()> createOrders);
-    void quote(const QuoteOrders& quotes, F bidPrice, int bidQuantity, F askPrice, int askQuantity);
+    virtual void insertOrder(std::shared_ptr<Order> order) = 0;
+    virtual int cancelOrder(std::shared_ptr<Order> order) = 0;
+    /**
+     * amends a resting (non quote) order to price and a total quantity of quantity, filled quantity included. A
+     * reduction at the same price is made in place and keeps the order's priority; a new price or more quantity
+     * moves the same Order to the back of its new level and may trade. Reducing to no more than the filled
+     * quantity cancels the order. @return 0 on success, -1 if the order is not resting or quantity is not positive
+     */
+    virtual int modifyOrder(const std::shared_ptr<Order>& order, F price, int quantity) = 0;
+    /** the orders of the session's quote, created by createOrders() if the quote is new; valid until the next new quote */
+    template <typename Fn>
+    const QuoteOrders& getQuotes(std::string_view sessionId, std::string_view quoteId, Fn createOrders) {
+        return quotes.getOrCreate(sessionId, quoteId, createOrders);
+    }
+    virtual void quote(const QuoteOrders& quotes, F bidPrice, int bidQuantity, F askPrice, int askQuantity) = 0;
+    /** calls fn(std::string_view sessionId, std::string_view quoteId, const QuoteOrders&) for every quote entered on the book, oldest first */
+    template <typename Fn>
+    void forEachQuote(Fn fn) const {
+        quotes.forEach(fn);
+    }
+    /**
+     * builds an empty book from resting orders already in priority order (best price first, then time) per side,
+     * in one linear pass without matching, listener callbacks or feed output, e.g. to restore a snapshot or set up
+     * a test. @throws std::invalid_argument, leaving the book unchanged, if the book is not empty, a side is out of
+     * order, an order is on the wrong side, already booked or has nothing remaining, or the bids cross the asks
+     */
+    virtual void load(std::span<const std::shared_ptr<Order>> bids, std::span<const std::shared_ptr<Order>> asks) = 0;
 
-    const Book book() const;
+    virtual const Book book() const = 0;
+    /**
+     * level-aggregated depth, best level first, into caller provided buffers. At most bids.size() and asks.size()
+     * levels are written, the cost is proportional to the levels written, not the orders in the book.
+     */
+    virtual DepthSize depth(std::span<BookLevel> bids, std::span<BookLevel> asks) const = 0;
+    /** resting orders of one side in priority order, returns the number of entries written into orders */
+    virtual int depthByOrder(Order::Side side, std::span<BookOrder> orders) const = 0;
+    /** calls fn for every resting order of one side in priority order */
+    virtual void forEachOrder(Order::Side side, const std::function<void(const Order&)>& fn) const = 0;
+    /** the current best bid and offer, lock-free and safe to call from any thread without holding lock() */
+    TopOfBook topOfBook() const {
+        return top.load();
+    }
+    /** changes whenever the top of book changes, cheap enough to poll for change detection */
+    uint64_t topOfBookVersion() const {
+        return top.version();
+    }
+    /**
+     * the market-by-price feed, or null if InstrumentConfig::levelDeltaCapacity is 0. Written under the book lock,
+     * a single consumer may drain it from any thread. Deltas that do not fit are dropped and counted.
+     */
+    RingBuffer<LevelDelta>* levelDeltas() const {
+        return deltas.get();
+    }
+    uint64_t levelDeltasDropped() const {
+        return droppedDeltas.load(std::memory_order_relaxed);
+    }
+    /** sequence of the last LevelDelta published, read under lock() together with depth() to seed a BookReplica */
+    uint64_t levelDeltaSequence() const {
+        return deltaSequence;
+    }
+    /** the market-by-order feed, or null if InstrumentConfig::orderEventCapacity is 0, same threading as levelDeltas() */
+    RingBuffer<OrderEvent>* orderEvents() const {
+        return events.get();
+    }
+    uint64_t orderEventsDropped() const {
+        return droppedEvents.load(std::memory_order_relaxed);
+    }
+    /** sequence of the last OrderEvent published, read under lock() together with depthByOrder() */
+    uint64_t orderEventSequence() const {
+        return eventSequence;
+    }
     const Order getOrder(std::shared_ptr<Order> order);
+    /** the name referenced by Order::instrument of the book's orders, hold it to use them after the book is destroyed */
+    std::shared_ptr<const std::string> instrumentName() const {
+        return name;
+    }
+    /** marks the book closed, under lock(): the owner stops entering orders and quotes, see Exchange::closeInstrument */
+    void close() {
+        closed = true;
+    }
+    bool isClosed() const {
+        return closed;
+    }
     std::vector<std::string> instruments() const {
         return {instrument};
     }
@@ -115,4 +317,58 @@ public:
     std::shared_ptr<OrderType> createOrder(Args&&... args) {
         return std::make_shared<OrderType>(std::forward<Args>(args)...);
     }
-};
\ No newline at end of file
+};
+
+/** OrderBook over a specific PriceLevels container, explicitly instantiated in orderbook.cpp for every PriceLevelsType */
+template <typename Levels = PriceLevels>
+class BasicOrderBook final : public OrderBook {
+private:
+    Levels bids = Levels(false);
+    Levels asks = Levels(true);
+    /** last value stored in top, only accessed by the writer */
+    TopOfBook published;
+    struct PendingDelta {
+        LevelDelta delta;
+        /** the level did not exist before the operation, it is not reported if the operation also removed it */
+        bool created = false;
+    };
+    /** levels changed by the current operation, coalesced and flushed to deltas by publish() */
+    std::vector<PendingDelta> pending;
+    /** matches a crossed book, for quotes that are already resting */
+    void matchOrders(Order::Side aggressorSide);
+    /** matches an incoming order, not on the book, against the opposite side and rests what is left of a limit order */
+    void match(const std::shared_ptr<Order>& order);
+    /** updates one side of a quote, in place where the price or the level's position is unchanged */
+    void requote(Levels& levels, const std::shared_ptr<Order>& order, F price, int quantity);
+    /** removes order, at the front of levels, if it is a quote the listener pulls (OrderBookListener::pullsQuote), @return true if removed */
+    bool pullProtected(Levels& levels, const std::shared_ptr<Order>& order);
+    void touch(Order::Side side, F price, int quantity, bool created = false);
+    void event(OrderEvent::Type type, const Order& order, F price, int quantity);
+    void publishTopOfBook();
+    void publishDeltas();
+    void publish() {
+        publishTopOfBook();
+        if (deltas) publishDeltas();
+    }
+
+public:
+    BasicOrderBook(const std::string &instrument, OrderBookListener& listener, const InstrumentConfig& config = {}) : OrderBook(instrument, listener, config) {
+        if (deltas) pending.reserve(64);
+    }
+
+    void insertOrder(std::shared_ptr<Order> order) override;
+    int cancelOrder(std::shared_ptr<Order> order) override;
+    int modifyOrder(const std::shared_ptr<Order>& order, F price, int quantity) override;
+    void quote(const QuoteOrders& quotes, F bidPrice, int bidQuantity, F askPrice, int askQuantity) override;
+    void load(std::span<const std::shared_ptr<Order>> bids, std::span<const std::shared_ptr<Order>> asks) override;
+    const Book book() const override;
+    DepthSize depth(std::span<BookLevel> bids, std::span<BookLevel> asks) const override;
+    int depthByOrder(Order::Side side, std::span<BookOrder> orders) const override;
+    void forEachOrder(Order::Side side, const std::function<void(const Order&)>& fn) const override;
+};
+
+extern template class BasicOrderBook<DequeuePtrPriceLevels>;
+extern template class BasicOrderBook<VectorPtrPriceLevels>;
+extern template class BasicOrderBook<VectorPriceLevels>;
+extern template class BasicOrderBook<StdMapPriceLevels>;
+extern template class BasicOrderBook<StdMapPtrPriceLevels>;
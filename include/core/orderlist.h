@@ -2,17 +2,28 @@
 #include <stdexcept>
 #include <memory>
 #include "order.h"
+#include "protection.h"
 
 // TODO add forward_iterator support so that friend class in not needed
 class OrderList {
 friend class OrderBook;
+template<typename> friend class BasicOrderBook;
 private:
     std::shared_ptr<Node> head = nullptr;
     std::shared_ptr<Node> tail = nullptr;
     F _price;
+    /** sum of the remaining quantity of the orders on the list */
+    int _quantity = 0;
 public:
     OrderList(F price) : _price(price) {}
     const F& price() const { return _price; }
+    int quantity() const { return _quantity; }
+    /** must be called when an order on the list is partially filled, @return the new level quantity */
+    int reduce(int quantity) { return _quantity -= quantity; }
+    /** moves the level to price, the caller keeps the levels in price order */
+    void reprice(F price) { _price = price; }
+    /** true if order is the only order on the list */
+    bool only(const std::shared_ptr<Order>& order) const { return head != nullptr && head == tail && head == order->node; }
     
     struct Iterator 
     {
@@ -45,11 +56,13 @@ public:
         std::shared_ptr<Node> current;
     };
     
-    void pushback(std::shared_ptr<Order> order) {
+    void pushback(const std::shared_ptr<Order>& order) {
         if (!order) return;
         
-        auto node = order->node;
+        const auto& node = order->node;
         node->order = order;
+        _quantity += order->remaining;
+        if (order->protection) order->protection->link(*order);
         
         if (head == nullptr) {
             head = node;
@@ -69,7 +82,9 @@ public:
             throw std::runtime_error("node is null on removal");
         }
         
+        if (order->protection) order->protection->unlink(*order);
         node->order.reset();
+        _quantity -= order->remaining;
         
         if (head == node) {
             head = node->next;
@@ -58,7 +58,8 @@ private:
     ContainerOfPtr levels;
 public:
     PointerPriceLevels(bool ascending) : cmpFn(ascending) {}
-    void insertOrder(std::shared_ptr<Order> order) {
+    /** @return the quantity of the order's level after the insert */
+    int insertOrder(std::shared_ptr<Order> order) {
         auto itr = std::lower_bound(levels.begin(), levels.end(), order->price(), cmpFn);
         std::shared_ptr<OrderList> list;
         if (itr == levels.end() || (*itr)->price() != order->price()) {
@@ -68,8 +69,17 @@ public:
             list = *itr;
         }
         list->pushback(order);
+        return list->quantity();
     }
-    void removeOrder(std::shared_ptr<Order> order) {
+    /** appends an order no better than the worst level, building the levels from orders in priority order without searching */
+    void appendOrder(const std::shared_ptr<Order>& order) {
+        if (levels.empty() || levels.back()->price() != order->price()) {
+            levels.push_back(std::make_shared<OrderList>(order->price()));
+        }
+        levels.back()->pushback(order);
+    }
+    /** @return the quantity of the order's level after the removal, 0 if the level was removed */
+    int removeOrder(std::shared_ptr<Order> order) {
         auto itr = std::lower_bound(levels.begin(), levels.end(), order->price(), cmpFn);
         if (itr == levels.end() || (*itr)->price() != order->price()) {
             throw std::runtime_error("price level for order does not exist");
@@ -78,18 +88,56 @@ public:
         list->remove(order);
         if (list->front() == nullptr) {
             levels.erase(itr);
+            return 0;
+        }
+        return list->quantity();
+    }
+    /** reduces the level quantity by quantity, for an order reduced in place, @return the level quantity */
+    int reduceOrder(const std::shared_ptr<Order>& order, int quantity) {
+        auto itr = std::lower_bound(levels.begin(), levels.end(), order->price(), cmpFn);
+        if (itr == levels.end() || (*itr)->price() != order->price()) {
+            throw std::runtime_error("price level for order does not exist");
         }
+        return (*itr)->reduce(quantity);
+    }
+    /**
+     * moves the level of an order that is alone on it to price (which may be its own), if no other level exists at
+     * price and the levels stay in order, without erasing or inserting a level. @return false if nothing was changed
+     */
+    bool repriceLevel(const std::shared_ptr<Order>& order, F price) {
+        auto itr = std::lower_bound(levels.begin(), levels.end(), order->price(), cmpFn);
+        if (itr == levels.end() || (*itr)->price() != order->price() || !(*itr)->only(order)) return false;
+        // the previous level must stay before price and the next one after it
+        if (itr != levels.begin() && !cmpFn(*std::prev(itr), price)) return false;
+        auto next = std::next(itr);
+        if (next != levels.end() && (cmpFn(*next, price) || (*next)->price() == price)) return false;
+        (*itr)->reprice(price);
+        return true;
     }
     std::shared_ptr<Order> front() const {
         auto itr = levels.begin();
         return itr == levels.end() ? nullptr : (*itr)->front();
     }
+    /** the best price level, or nullptr if empty */
+    OrderList* frontList() const {
+        return levels.empty() ? nullptr : levels.front().get();
+    }
+    bool empty() const {
+        return levels.empty();
+    }
     int size() const {
         return levels.size();
     }
     void forEach(std::function<void(const OrderList*)> fn) const {
         for(auto itr=levels.begin();itr!=levels.end();itr++) {
-            fn(*itr);
+            fn(itr->get());
+        }
+    }
+    /** visits levels best first until fn returns false, without the std::function indirection of forEach */
+    template <typename Fn>
+    void forEachUntil(Fn fn) const {
+        for (auto itr = levels.begin(); itr != levels.end(); itr++) {
+            if (!fn(itr->get())) return;
         }
     }
 };
@@ -101,17 +149,27 @@ private:
     ContainerOfStruct levels;
 public:
     StructPriceLevels(bool ascending) : cmpFn(ascending) {}
-    void insertOrder(std::shared_ptr<Order> order) {
+    /** @return the quantity of the order's level after the insert */
+    int insertOrder(std::shared_ptr<Order> order) {
         auto itr = std::lower_bound(levels.begin(), levels.end(), order->price(), cmpFn);
         if (itr == levels.end() || itr->price() != order->price()) {
             OrderList list(order->price());
             list.pushback(order);
-            levels.insert(itr, std::move(list));
+            return levels.insert(itr, std::move(list))->quantity();
         } else {
             itr->pushback(order);
+            return itr->quantity();
         }
     }
-    void removeOrder(std::shared_ptr<Order> order) {
+    /** appends an order no better than the worst level, building the levels from orders in priority order without searching */
+    void appendOrder(const std::shared_ptr<Order>& order) {
+        if (levels.empty() || levels.back().price() != order->price()) {
+            levels.emplace_back(order->price());
+        }
+        levels.back().pushback(order);
+    }
+    /** @return the quantity of the order's level after the removal, 0 if the level was removed */
+    int removeOrder(std::shared_ptr<Order> order) {
         auto itr = std::lower_bound(levels.begin(), levels.end(), order->price(), cmpFn);
         if (itr == levels.end() || itr->price() != order->price()) {
             throw std::runtime_error("price level for order does not exist");
@@ -119,13 +177,44 @@ public:
         itr->remove(order);
         if (itr->front() == nullptr) {
             levels.erase(itr);
+            return 0;
         }
+        return itr->quantity();
+    }
+    /** reduces the level quantity by quantity, for an order reduced in place, @return the level quantity */
+    int reduceOrder(const std::shared_ptr<Order>& order, int quantity) {
+        auto itr = std::lower_bound(levels.begin(), levels.end(), order->price(), cmpFn);
+        if (itr == levels.end() || itr->price() != order->price()) {
+            throw std::runtime_error("price level for order does not exist");
+        }
+        return itr->reduce(quantity);
+    }
+    /**
+     * moves the level of an order that is alone on it to price (which may be its own), if no other level exists at
+     * price and the levels stay in order, without erasing or inserting a level. @return false if nothing was changed
+     */
+    bool repriceLevel(const std::shared_ptr<Order>& order, F price) {
+        auto itr = std::lower_bound(levels.begin(), levels.end(), order->price(), cmpFn);
+        if (itr == levels.end() || itr->price() != order->price() || !itr->only(order)) return false;
+        // the previous level must stay before price and the next one after it
+        if (itr != levels.begin() && !cmpFn(*std::prev(itr), price)) return false;
+        auto next = std::next(itr);
+        if (next != levels.end() && (cmpFn(*next, price) || next->price() == price)) return false;
+        itr->reprice(price);
+        return true;
     }
     std::shared_ptr<Order> front() const {
         auto itr = levels.begin();
         if (itr == levels.end()) return nullptr;
         return itr->front();
     }
+    /** the best price level, or nullptr if empty */
+    OrderList* frontList() {
+        return levels.empty() ? nullptr : &levels.front();
+    }
+    const OrderList* frontList() const {
+        return levels.empty() ? nullptr : &levels.front();
+    }
     bool empty() const {
         return levels.empty();
     }
@@ -137,6 +226,13 @@ public:
             fn(&(*itr));
         }
     }
+    /** visits levels best first until fn returns false, without the std::function indirection of forEach */
+    template <typename Fn>
+    void forEachUntil(Fn fn) const {
+        for (auto itr = levels.begin(); itr != levels.end(); itr++) {
+            if (!fn(&(*itr))) return;
+        }
+    }
 };
 
 struct fixed_compare {
@@ -154,17 +250,27 @@ private:
     MapOfStruct levels;
 public:
     MapPriceLevels(bool ascending) : cmpFn(ascending), levels(cmpFn) {}
-    void insertOrder(std::shared_ptr<Order> order) {
+    /** @return the quantity of the order's level after the insert */
+    int insertOrder(std::shared_ptr<Order> order) {
         auto itr = levels.lower_bound(order->price());
         if (itr == levels.end() || itr->first != order->price()) {
             OrderList list(order->price());
             list.pushback(order);
-            levels.insert({list.price(), std::move(list)});
+            return levels.insert(itr, {list.price(), std::move(list)})->second.quantity();
         } else {
             itr->second.pushback(order);
+            return itr->second.quantity();
         }
     }
-    void removeOrder(std::shared_ptr<Order> order) {
+    /** appends an order no better than the worst level, building the levels from orders in priority order without searching */
+    void appendOrder(const std::shared_ptr<Order>& order) {
+        if (levels.empty() || std::prev(levels.end())->first != order->price()) {
+            levels.emplace_hint(levels.end(), order->price(), OrderList(order->price()));
+        }
+        std::prev(levels.end())->second.pushback(order);
+    }
+    /** @return the quantity of the order's level after the removal, 0 if the level was removed */
+    int removeOrder(std::shared_ptr<Order> order) {
         auto itr = levels.lower_bound(order->price());
         if (itr == levels.end() || itr->first != order->price()) {
             throw std::runtime_error("price level for order does not exist");
@@ -172,13 +278,46 @@ public:
         itr->second.remove(order);
         if (itr->second.front() == nullptr) {
             levels.erase(itr);
+            return 0;
         }
+        return itr->second.quantity();
+    }
+    /** reduces the level quantity by quantity, for an order reduced in place, @return the level quantity */
+    int reduceOrder(const std::shared_ptr<Order>& order, int quantity) {
+        auto itr = levels.find(order->price());
+        if (itr == levels.end()) {
+            throw std::runtime_error("price level for order does not exist");
+        }
+        return itr->second.reduce(quantity);
+    }
+    /**
+     * moves the level of an order that is alone on it to price (which may be its own), if no other level exists at
+     * price and the levels stay in order, without erasing or inserting a level. @return false if nothing was changed
+     */
+    bool repriceLevel(const std::shared_ptr<Order>& order, F price) {
+        auto itr = levels.find(order->price());
+        if (itr == levels.end() || !itr->second.only(order)) return false;
+        if (price == order->price()) return true;
+        if (levels.contains(price)) return false;
+        // the map node is re-keyed and relinked, not reallocated
+        auto node = levels.extract(itr);
+        node.key() = price;
+        node.mapped().reprice(price);
+        levels.insert(std::move(node));
+        return true;
     }
     std::shared_ptr<Order> front() const {
         auto itr = levels.begin();
         if (itr == levels.end()) return nullptr;
         return itr->second.front();
     }
+    /** the best price level, or nullptr if empty */
+    OrderList* frontList() {
+        return levels.empty() ? nullptr : &levels.begin()->second;
+    }
+    const OrderList* frontList() const {
+        return levels.empty() ? nullptr : &levels.begin()->second;
+    }
     bool empty() const {
         return levels.empty();
     }
@@ -190,6 +329,13 @@ public:
             fn(&(itr->second));
         }
     }
+    /** visits levels best first until fn returns false, without the std::function indirection of forEach */
+    template <typename Fn>
+    void forEachUntil(Fn fn) const {
+        for (auto itr = levels.begin(); itr != levels.end(); itr++) {
+            if (!fn(&(itr->second))) return;
+        }
+    }
 };
 
 template <typename MapOfPtr>
@@ -199,17 +345,28 @@ private:
     MapOfPtr levels;
 public:
     MapPtrPriceLevels(bool ascending) : cmpFn(ascending), levels(cmpFn) {}
-    void insertOrder(std::shared_ptr<Order> order) {
+    /** @return the quantity of the order's level after the insert */
+    int insertOrder(std::shared_ptr<Order> order) {
         auto itr = levels.lower_bound(order->price());
         if (itr == levels.end() || itr->first != order->price()) {
             auto list = std::make_shared<OrderList>(order->price());
             list->pushback(order);
-            levels.insert({list->price(), list});
+            levels.insert(itr, {list->price(), list});
+            return list->quantity();
         } else {
             itr->second->pushback(order);
+            return itr->second->quantity();
+        }
+    }
+    /** appends an order no better than the worst level, building the levels from orders in priority order without searching */
+    void appendOrder(const std::shared_ptr<Order>& order) {
+        if (levels.empty() || std::prev(levels.end())->first != order->price()) {
+            levels.emplace_hint(levels.end(), order->price(), std::make_shared<OrderList>(order->price()));
         }
+        std::prev(levels.end())->second->pushback(order);
     }
-    void removeOrder(std::shared_ptr<Order> order) {
+    /** @return the quantity of the order's level after the removal, 0 if the level was removed */
+    int removeOrder(std::shared_ptr<Order> order) {
         auto itr = levels.lower_bound(order->price());
         if (itr == levels.end() || itr->first != order->price()) {
             throw std::runtime_error("price level for order does not exist");
@@ -217,13 +374,43 @@ public:
         itr->second->remove(order);
         if (itr->second->front() == nullptr) {
             levels.erase(itr);
+            return 0;
+        }
+        return itr->second->quantity();
+    }
+    /** reduces the level quantity by quantity, for an order reduced in place, @return the level quantity */
+    int reduceOrder(const std::shared_ptr<Order>& order, int quantity) {
+        auto itr = levels.find(order->price());
+        if (itr == levels.end()) {
+            throw std::runtime_error("price level for order does not exist");
         }
+        return itr->second->reduce(quantity);
+    }
+    /**
+     * moves the level of an order that is alone on it to price (which may be its own), if no other level exists at
+     * price and the levels stay in order, without erasing or inserting a level. @return false if nothing was changed
+     */
+    bool repriceLevel(const std::shared_ptr<Order>& order, F price) {
+        auto itr = levels.find(order->price());
+        if (itr == levels.end() || !itr->second->only(order)) return false;
+        if (price == order->price()) return true;
+        if (levels.contains(price)) return false;
+        // the map node is re-keyed and relinked, not reallocated
+        auto node = levels.extract(itr);
+        node.key() = price;
+        node.mapped()->reprice(price);
+        levels.insert(std::move(node));
+        return true;
     }
     std::shared_ptr<Order> front() const {
         auto itr = levels.begin();
         if (itr == levels.end()) return nullptr;
         return itr->second->front();
     }
+    /** the best price level, or nullptr if empty */
+    OrderList* frontList() const {
+        return levels.empty() ? nullptr : levels.begin()->second.get();
+    }
     bool empty() const {
         return levels.empty();
     }
@@ -235,6 +422,13 @@ public:
             fn(itr->second.get());
         }
     }
+    /** visits levels best first until fn returns false, without the std::function indirection of forEach */
+    template <typename Fn>
+    void forEachUntil(Fn fn) const {
+        for (auto itr = levels.begin(); itr != levels.end(); itr++) {
+            if (!fn(itr->second.get())) return;
+        }
+    }
 };
 
 
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "order.h"
+#include "spinlock.h"
+
+/** market maker protection limits of a session, a limit of 0 is disabled */
+struct ProtectionConfig {
+    /** the sliding window the session's quote fills are counted over */
+    std::chrono::nanoseconds window{0};
+    /** quantity of the session's quotes traded within the window that trips protection */
+    int quantityLimit = 0;
+    /** number of fills of the session's quotes within the window that trips protection */
+    int fillLimit = 0;
+};
+
+/**
+ * a session's market maker protection: the fills of its quotes within the window, and an intrusive list of the
+ * session's quote orders resting on any book so that they can be pulled without scanning the books. OrderList links
+ * a quote order when it starts resting and unlinks it when it is filled, cancelled, pulled or moved, so the list
+ * only holds live quotes. Once tripped, the session's quotes are pulled rather than traded, and new quotes are
+ * rejected until it is re-armed.
+ */
+class SessionProtection {
+public:
+    struct Fill {
+        int64_t time;
+        int quantity;
+    };
+private:
+    SpinLock mu;
+    ProtectionConfig config;
+    /** ring of the fills within the window, oldest first */
+    std::vector<Fill> fills = std::vector<Fill>(16);
+    size_t first = 0;
+    size_t count = 0;
+    int64_t quantity = 0;
+    std::atomic<bool> tripped{false};
+    std::atomic<uint64_t> trips{0};
+    /** guards the resting quotes, which are linked and unlinked under the lock of their book */
+    SpinLock quotesLock;
+    Order* quotes = nullptr;
+public:
+    const std::string sessionId;
+    explicit SessionProtection(std::string sessionId) : sessionId(std::move(sessionId)) {}
+
+    /** replaces the limits and re-arms: the window is emptied and quoting is allowed again */
+    void configure(const ProtectionConfig& config);
+    /** counts a fill of one of the session's quotes at time (nanoseconds), @return true if it tripped protection */
+    bool onFill(int64_t time, int quantity);
+    bool isTripped() const {
+        return tripped.load(std::memory_order_acquire);
+    }
+    /** the number of times protection has tripped */
+    uint64_t tripCount() const {
+        return trips.load(std::memory_order_relaxed);
+    }
+    /** makes order a quote of the session, tracked while it rests on a book */
+    void add(Order& order) {
+        order.protection = this;
+        if (order.isOnList()) link(order);
+    }
+    /** called by OrderList when a quote order of the session starts resting */
+    void link(Order& order) {
+        std::lock_guard<SpinLock> guard(quotesLock);
+        order.prevProtected = nullptr;
+        order.nextProtected = quotes;
+        if (quotes) quotes->prevProtected = &order;
+        quotes = &order;
+    }
+    /** called by OrderList when a quote order of the session stops resting */
+    void unlink(Order& order) {
+        std::lock_guard<SpinLock> guard(quotesLock);
+        if (order.prevProtected) order.prevProtected->nextProtected = order.nextProtected;
+        else quotes = order.nextProtected;
+        if (order.nextProtected) order.nextProtected->prevProtected = order.prevProtected;
+        order.prevProtected = order.nextProtected = nullptr;
+    }
+    /** appends the session's resting quote orders to out, the most recently rested first */
+    void restingQuotes(std::vector<std::shared_ptr<Order>>& out);
+    /** copies the limits and the fills within the window, oldest first, e.g. into a snapshot; @return isTripped() */
+    bool save(ProtectionConfig& config, std::vector<Fill>& fills);
+    /** restores what save() copied, as of when it was saved: the trip is not counted again */
+    void restore(const ProtectionConfig& config, std::span<const Fill> fills, bool tripped);
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "order.h"
+
+// the orders of a session's quote, or null if no quote on that side
+struct QuoteOrders {
+    std::shared_ptr<Order> bid = nullptr;
+    std::shared_ptr<Order> ask = nullptr;
+};
+
+/** maps strings to dense ids 0, 1, ... in first seen order. Lookups of known strings do not allocate */
+class StringInterner {
+private:
+    std::vector<std::string> strings;
+    std::vector<size_t> hashes;
+    /** open addressing, id + 1 or 0 for an empty slot */
+    std::vector<uint32_t> slots = std::vector<uint32_t>(16);
+
+    size_t slotOf(std::string_view s, size_t hash) const {
+        const size_t mask = slots.size() - 1;
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            const auto id = slots[slot];
+            if (!id || (hashes[id - 1] == hash && strings[id - 1] == s)) return slot;
+        }
+    }
+    void grow() {
+        std::vector<uint32_t> old(slots.size() * 2);
+        old.swap(slots);
+        const size_t mask = slots.size() - 1;
+        for (uint32_t id = 0; id < strings.size(); id++) {
+            auto slot = hashes[id] & mask;
+            while (slots[slot]) slot = (slot + 1) & mask;
+            slots[slot] = id + 1;
+        }
+    }
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    /** @return the id of s, or NONE if it was never interned */
+    uint32_t find(std::string_view s) const {
+        return slots[slotOf(s, std::hash<std::string_view>{}(s))] - 1;
+    }
+    /** @return the id of s, assigning the next id if s is new */
+    uint32_t intern(std::string_view s) {
+        const auto hash = std::hash<std::string_view>{}(s);
+        auto slot = slotOf(s, hash);
+        if (slots[slot]) return slots[slot] - 1;
+        // at most half full
+        if ((strings.size() + 1) * 2 > slots.size()) {
+            grow();
+            slot = slotOf(s, hash);
+        }
+        strings.emplace_back(s);
+        hashes.push_back(hash);
+        slots[slot] = uint32_t(strings.size());
+        return uint32_t(strings.size() - 1);
+    }
+    std::string_view operator[](uint32_t id) const {
+        return strings[id];
+    }
+    size_t size() const {
+        return strings.size();
+    }
+};
+
+/**
+ * the quotes of a book keyed by (session, quote id), with both ids interned so the key is a pair of integers. An
+ * open addressing table of entry indexes over entries kept in creation order, so finding an existing quote hashes
+ * the two strings once each and does not allocate. Quotes are never removed, like the orders they reference.
+ */
+class QuoteRegistry {
+private:
+    struct Entry {
+        uint32_t session;
+        uint32_t quoteId;
+        QuoteOrders orders;
+    };
+    StringInterner sessions;
+    StringInterner quoteIds;
+    std::vector<Entry> entries;
+    /** open addressing, entry index + 1 or 0 for an empty slot */
+    std::vector<uint32_t> slots = std::vector<uint32_t>(16);
+
+    static size_t hash(uint32_t session, uint32_t quoteId) {
+        return size_t(((uint64_t(session) << 32) | quoteId) * 0x9E3779B97F4A7C15ull >> 16);
+    }
+    size_t slotOf(uint32_t session, uint32_t quoteId) const {
+        const size_t mask = slots.size() - 1;
+        for (size_t slot = hash(session, quoteId) & mask;; slot = (slot + 1) & mask) {
+            const auto index = slots[slot];
+            if (!index || (entries[index - 1].session == session && entries[index - 1].quoteId == quoteId)) return slot;
+        }
+    }
+    void grow() {
+        std::vector<uint32_t> old(slots.size() * 2);
+        old.swap(slots);
+        const size_t mask = slots.size() - 1;
+        for (uint32_t index = 0; index < entries.size(); index++) {
+            auto slot = hash(entries[index].session, entries[index].quoteId) & mask;
+            while (slots[slot]) slot = (slot + 1) & mask;
+            slots[slot] = index + 1;
+        }
+    }
+public:
+    /** @return the quote's orders, or null if the session never entered the quote */
+    const QuoteOrders* find(std::string_view sessionId, std::string_view quoteId) const {
+        const auto session = sessions.find(sessionId);
+        const auto quote = quoteIds.find(quoteId);
+        if (session == StringInterner::NONE || quote == StringInterner::NONE) return nullptr;
+        const auto index = slots[slotOf(session, quote)];
+        return index ? &entries[index - 1].orders : nullptr;
+    }
+    /** @return the quote's orders, created by createOrders() if the quote is new; valid until the next new quote */
+    template <typename Fn>
+    const QuoteOrders& getOrCreate(std::string_view sessionId, std::string_view quoteId, Fn createOrders) {
+        const auto session = sessions.intern(sessionId);
+        const auto quote = quoteIds.intern(quoteId);
+        auto slot = slotOf(session, quote);
+        if (slots[slot]) return entries[slots[slot] - 1].orders;
+        auto orders = createOrders();
+        if ((entries.size() + 1) * 2 > slots.size()) {
+            grow();
+            slot = slotOf(session, quote);
+        }
+        entries.push_back({session, quote, std::move(orders)});
+        slots[slot] = uint32_t(entries.size());
+        return entries.back().orders;
+    }
+    /** calls fn(std::string_view sessionId, std::string_view quoteId, const QuoteOrders&) in creation order */
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const auto& entry : entries) fn(sessions[entry.session], quoteIds[entry.quoteId], entry.orders);
+    }
+    size_t size() const {
+        return entries.size();
+    }
+};
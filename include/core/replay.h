@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "exchange.h"
+#include "journal.h"
+#include "latency.h"
+
+/**
+ * order sensitive digest (64 bit FNV-1a) of every trade: price, quantity and the exchange ids of both sides. Two
+ * runs with equal digests traded identically, e.g. before and after an optimization.
+ */
+class TradeDigest : public ExchangeListener {
+private:
+    uint64_t hash = 14695981039346656037ull;
+    uint64_t trades = 0;
+    void mix(uint64_t value) {
+        for (int i = 0; i < 8; i++, value >>= 8) {
+            hash = (hash ^ (value & 0xff)) * 1099511628211ull;
+        }
+    }
+public:
+    void onTrade(const Trade& trade) override;
+    uint64_t value() const {
+        return hash;
+    }
+    uint64_t count() const {
+        return trades;
+    }
+};
+
+struct ReplayOptions {
+    /** wait until each command's journaled time (relative to the first), instead of replaying as fast as possible */
+    bool originalPacing = false;
+    /** with originalPacing, e.g. 2 replays twice as fast as the commands were journaled */
+    double speed = 1.0;
+    /** passed to the Exchange replayed into, e.g. to compare PriceLevels implementations on real flow */
+    InstrumentConfigHook configure;
+};
+
+/** the outcome of replaying one instrument's commands */
+struct InstrumentReplay {
+    std::string instrument;
+    size_t commands = 0;
+    uint64_t trades = 0;
+    /** TradeDigest of the instrument's trades alone */
+    uint64_t digest = 0;
+};
+
+struct ReplayReport {
+    enum Operation { ORDER, QUOTE, CANCEL, MODIFY, PROTECT, CLOSE, PULL, N_OPERATIONS };
+    size_t commands = 0;
+    uint64_t trades = 0;
+    uint64_t digest = 0;
+    /** wall time of the replay, including pacing */
+    double seconds = 0;
+    /** per operation, measured from the scheduled time with original pacing (no coordinated omission), from the call otherwise */
+    std::array<LatencyHistogram, N_OPERATIONS> latency;
+    /** ParallelReplay only: per instrument results, sorted by instrument */
+    std::vector<InstrumentReplay> instruments;
+};
+
+/** the journaled command being applied, read by a replaying exchange's clock and id generator */
+struct ReplayContext {
+    int64_t timestamp = 0;
+    std::array<long, 2> pendingIds{};
+    size_t nextPending = 0;
+    size_t pendingCount = 0;
+    long lastId = 0;
+    void prepare(const JournalRecord& record);
+    long nextId();
+};
+
+/**
+ * Drives a fresh Exchange with the commands of a journal through the public API. The exchange's clock returns the
+ * journaled timestamp of the command being applied and its id generator the journaled ids, so exchange ids, trades
+ * and trade execIds are reproduced exactly, independent of pacing and of the host.
+ */
+class JournalReplay {
+private:
+    TradeDigest digest;
+    const ReplayOptions options;
+    std::unique_ptr<Exchange> target;
+    ReplayContext context;
+public:
+    explicit JournalReplay(const ReplayOptions& options = {});
+    /** applies every command journaled in directory, may be called again with a later journal */
+    ReplayReport run(const std::string& directory);
+    /** the exchange replayed into, e.g. to inspect the books after run() */
+    Exchange& exchange() {
+        return *target;
+    }
+};
+
+/**
+ * Replays a journal with its instruments in parallel. The journal is read once and partitioned by instrument, then
+ * each instrument's commands are applied in journal order by one thread of a work-stealing pool; instruments are
+ * independent books, so only the order within an instrument matters. PROTECT and CLOSE records are barriers: the
+ * commands journaled before one are all applied, then it is applied alone. Per instrument results, and the digest
+ * combined over them in instrument order, are identical for any number of threads. Ids are taken from the journal,
+ * so commands journaled without their ids (older versions) are not reproduced exactly. A session whose protection
+ * trips on fills counted across instruments between two barriers trips at a command that depends on the threads'
+ * timing, its quotes on the other books are pulled by the journaled PULL records. Pacing options are ignored. Outside run() the exchange uses the system clock and ids after the replayed ones.
+ */
+class ParallelReplay {
+private:
+    const ReplayOptions options;
+    const unsigned threads;
+    /** passes each trade to the digest of the instrument the calling worker is replaying */
+    struct TradeRouter : ExchangeListener {
+        void onTrade(const Trade& trade) override;
+    } router;
+    std::unique_ptr<Exchange> target;
+    /** the highest id replayed, the ids assigned outside run() continue after it */
+    std::atomic<long> lastId{0};
+public:
+    /** @param threads workers, 0 for one per hardware thread */
+    explicit ParallelReplay(unsigned threads = 0, const ReplayOptions& options = {});
+    /** applies every command journaled in directory, may be called again with a later journal */
+    ReplayReport run(const std::string& directory);
+    Exchange& exchange() {
+        return *target;
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Bounded single producer, single consumer queue. All storage is allocated by the constructor, push() and drain()
+ * never allocate. The producer may change threads as long as pushes are externally serialized (e.g. by the book lock).
+ */
+template <typename T>
+class RingBuffer {
+private:
+    const size_t _capacity;
+    const size_t mask;
+    std::unique_ptr<T[]> slots;
+    alignas(64) std::atomic<uint64_t> head{0};
+    /** producer's last observed tail, avoids reading the consumer's cache line on every push */
+    uint64_t cachedTail = 0;
+    alignas(64) std::atomic<uint64_t> tail{0};
+public:
+    /** capacity is rounded up to a power of 2 */
+    explicit RingBuffer(size_t capacity) : _capacity(std::bit_ceil(capacity < 2 ? 2 : capacity)), mask(_capacity - 1), slots(std::make_unique<T[]>(_capacity)) {}
+
+    /** @return false if the buffer is full, the value is not enqueued */
+    bool push(const T& value) {
+        const auto h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail >= _capacity) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h - cachedTail >= _capacity) return false;
+        }
+        slots[h & mask] = value;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    bool pop(T& value) {
+        const auto t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;
+        value = slots[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    /** calls fn for up to max queued values in FIFO order, @return the number consumed */
+    template <typename Fn>
+    size_t drain(Fn fn, size_t max = SIZE_MAX) {
+        auto t = tail.load(std::memory_order_relaxed);
+        const auto h = head.load(std::memory_order_acquire);
+        size_t n = 0;
+        while (t != h && n < max) {
+            fn(slots[t & mask]);
+            t++; n++;
+        }
+        tail.store(t, std::memory_order_release);
+        return n;
+    }
+    size_t size() const {
+        return size_t(head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire));
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    size_t capacity() const {
+        return _capacity;
+    }
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Single writer, many reader sequence lock. Readers never block the writer and never write shared state, so
+ * polling a SeqLock from many threads does not contend with the thread that owns the data. A reader retries
+ * if the writer was active during its copy, so T should be small and cheap to copy.
+ */
+template <typename T>
+class SeqLock {
+private:
+    alignas(64) std::atomic<uint64_t> seq{0};
+    T value{};
+public:
+    /** must only be called by the single writer */
+    void store(const T& desired) {
+        const auto s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        value = desired;
+        seq.store(s + 2, std::memory_order_release);
+    }
+    T load() const {
+        T copy;
+        uint64_t s0, s1;
+        do {
+            s0 = seq.load(std::memory_order_acquire);
+            copy = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s1 = seq.load(std::memory_order_relaxed);
+        } while (s0 != s1 || (s0 & 1));
+        return copy;
+    }
+    /** even, and increases by 2 with every store, so readers can cheaply detect a change */
+    uint64_t version() const {
+        return seq.load(std::memory_order_acquire);
+    }
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "orderbook.h"
+
+/** market data record published to the shared memory ring, fixed size so it can be copied into a slot */
+struct MarketDataRecord {
+    enum Type : uint8_t { LEVEL, ORDER, TRADE };
+    Type type = LEVEL;
+    /** ORDER only */
+    OrderEvent::Type event = OrderEvent::ADD;
+    /** book side for LEVEL and ORDER, the aggressor's side for TRADE */
+    Order::Side side = Order::BUY;
+    /** NUL terminated unless all 16 characters are used */
+    char instrument[16] = {};
+    /** the book's LevelDelta or OrderEvent sequence, for TRADE the sequence of the aggressor's EXECUTE event */
+    uint64_t sequence = 0;
+    /** ORDER: the order, TRADE: the resting order */
+    long exchangeId = 0;
+    /** TRADE only */
+    long aggressorId = 0;
+    F price = 0;
+    int quantity = 0;
+    /** ORDER only, see OrderEvent::remaining */
+    int remaining = 0;
+
+    std::string_view instrumentName() const {
+        return {instrument, strnlen(instrument, sizeof instrument)};
+    }
+};
+
+/** layout of the shared memory segment: a ShmRingHeader followed by capacity slots */
+struct ShmRingHeader {
+    static constexpr uint64_t MAGIC = 0x4f424d4452494e47; // "OBMDRING"
+    static constexpr uint32_t VERSION = 1;
+    uint64_t magic = 0;
+    uint32_t version = 0;
+    uint32_t slotSize = 0;
+    uint64_t capacity = 0;
+    /** number of records published, readers joining the ring start here */
+    alignas(64) std::atomic<uint64_t> head{0};
+};
+
+/**
+ * per-slot seqlock: record n is in slot n % capacity, seq is 2n+1 while the writer copies it and 2n+2 once it is
+ * complete, so a reader can tell a slot that is not yet written from one that was overwritten by a later lap.
+ */
+struct alignas(64) ShmSlot {
+    std::atomic<uint64_t> seq{0};
+    MarketDataRecord record;
+};
+
+/**
+ * single writer of a POSIX shared memory ring. The writer never waits for readers, a reader that falls more than
+ * capacity records behind is lapped and detects it, see ShmRingReader. The segment is unlinked by the destructor.
+ */
+class ShmRingWriter {
+private:
+    const std::string name;
+    void* base = nullptr;
+    size_t bytes = 0;
+    ShmRingHeader* header = nullptr;
+    ShmSlot* slots = nullptr;
+    uint64_t mask = 0;
+    uint64_t next = 0;
+public:
+    /** creates (or replaces) the segment, name must start with '/'. capacity is rounded up to a power of 2 */
+    ShmRingWriter(const std::string& name, size_t capacity);
+    ~ShmRingWriter();
+    ShmRingWriter(const ShmRingWriter&) = delete;
+    ShmRingWriter& operator=(const ShmRingWriter&) = delete;
+
+    void write(const MarketDataRecord& record);
+    uint64_t published() const {
+        return next;
+    }
+    size_t capacity() const {
+        return size_t(mask + 1);
+    }
+};
+
+/** one of many readers of a ShmRingWriter segment, possibly in another process. Never writes to the segment. */
+class ShmRingReader {
+private:
+    void* base = nullptr;
+    size_t bytes = 0;
+    const ShmRingHeader* header = nullptr;
+    const ShmSlot* slots = nullptr;
+    uint64_t mask = 0;
+    uint64_t next = 0;
+    uint64_t _lost = 0;
+public:
+    enum Status {
+        OK,
+        /** no record available yet */
+        EMPTY,
+        /** the writer overwrote unread records, the reader skipped ahead to the head of the ring and must resynchronize */
+        LAPPED
+    };
+    /** @param fromOldest start at the oldest record still in the ring rather than at the next one published */
+    explicit ShmRingReader(const std::string& name, bool fromOldest = false);
+    ~ShmRingReader();
+    ShmRingReader(const ShmRingReader&) = delete;
+    ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+    Status read(MarketDataRecord& record);
+    /** records published but not yet read, a reader whose lag approaches capacity() is about to be lapped */
+    uint64_t lag() const {
+        return header->head.load(std::memory_order_acquire) - next;
+    }
+    /** records skipped because the reader was lapped */
+    uint64_t lost() const {
+        return _lost;
+    }
+    size_t capacity() const {
+        return size_t(mask + 1);
+    }
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+
+#include "order.h"
+
+/**
+ * On-disk layout of an Exchange snapshot, see Exchange::saveSnapshot. All records are padded to a multiple of 8 and
+ * strings follow their record. The file is
+ *
+ *   SnapshotHeader
+ *   per book: SnapshotBook, instrument,
+ *             bids in priority order, asks in priority order, then the book's orders not resting (SnapshotOrder each),
+ *             SnapshotQuote for every quote of the book
+ *   per quoting session: SnapshotProtection, session id, its fills within the window (SnapshotFill each)
+ *
+ * so a book is rebuilt in one linear pass, the order records of each side are already in price-time order, and
+ * books are independent of each other.
+ */
+struct SnapshotHeader {
+    static constexpr uint64_t MAGIC = 0x50414e53424f4c43; // "CLOBSNAP" little endian
+    static constexpr uint32_t VERSION = 3;
+    uint64_t magic = MAGIC;
+    uint32_t version = VERSION;
+    uint32_t bookCount = 0;
+    /** the exchange id counter, new orders continue after it */
+    int64_t lastId = 0;
+    uint64_t orderCount = 0;
+    /** of the whole file, a shorter file was truncated */
+    uint64_t size = 0;
+    /** the end of the journal the snapshot covers, see JournalPosition; -1 if no journal was attached */
+    int32_t journalSegment = -1;
+    uint32_t protectionCount = 0;
+    uint64_t journalOffset = 0;
+};
+static_assert(sizeof(SnapshotHeader) == 56, "SnapshotHeader is the on-disk format");
+
+struct SnapshotBook {
+    /** of the book's whole section, so the books of a snapshot can be located without parsing them */
+    uint64_t size = 0;
+    uint32_t instrumentLength = 0;
+    uint32_t quoteCount = 0;
+    uint64_t bidCount = 0;
+    uint64_t askCount = 0;
+    /** filled or cancelled orders, kept so Exchange::getOrder reports them after a restart */
+    uint64_t inactiveCount = 0;
+};
+static_assert(sizeof(SnapshotBook) == 40, "SnapshotBook is the on-disk format");
+
+/** followed by the session id and client order id */
+struct SnapshotOrder {
+    /** including the strings and padding */
+    uint32_t size = 0;
+    uint8_t side = 0;
+    uint8_t isQuote = 0;
+    uint16_t sessionLength = 0;
+    uint16_t orderIdLength = 0;
+    uint16_t reserved = 0;
+    int32_t quantity = 0;
+    int32_t remaining = 0;
+    int32_t filled = 0;
+    int32_t cumQty = 0;
+    int32_t reserved2 = 0;
+    int64_t exchangeId = 0;
+    F price = 0;
+    F avgPrice = 0;
+};
+static_assert(sizeof(SnapshotOrder) == 56, "SnapshotOrder is the on-disk format");
+
+/** followed by the session id and quote id, the orders are referenced by exchange id, 0 if the quote has no such side */
+struct SnapshotQuote {
+    uint32_t size = 0;
+    uint16_t sessionLength = 0;
+    uint16_t quoteIdLength = 0;
+    int64_t bidId = 0;
+    int64_t askId = 0;
+};
+static_assert(sizeof(SnapshotQuote) == 24, "SnapshotQuote is the on-disk format");
+
+/**
+ * a session's market maker protection, so that commands replayed after the snapshot's journal position count fills
+ * and trip as they did. Followed by the session id, padded, then fillCount SnapshotFill, oldest first
+ */
+struct SnapshotProtection {
+    /** including the session id, padding and fills */
+    uint32_t size = 0;
+    uint16_t sessionLength = 0;
+    uint8_t tripped = 0;
+    uint8_t reserved = 0;
+    int32_t quantityLimit = 0;
+    int32_t fillLimit = 0;
+    /** nanoseconds */
+    int64_t window = 0;
+    uint64_t fillCount = 0;
+};
+static_assert(sizeof(SnapshotProtection) == 32, "SnapshotProtection is the on-disk format");
+
+struct SnapshotFill {
+    /** nanoseconds since the epoch of the exchange's clock */
+    int64_t time = 0;
+    int32_t quantity = 0;
+    int32_t reserved = 0;
+};
+static_assert(sizeof(SnapshotFill) == 16, "SnapshotFill is the on-disk format");
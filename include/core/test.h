@@ -5,6 +5,7 @@
 #include <vector>
 #include <optional>
 #include <ranges>
+#include <algorithm>
 
 #include "exchange.h"
 #include "orderbook.h"
@@ -101,7 +102,7 @@ public:
 namespace TestUtils {
     // Create a test order book with smart pointers
     inline std::unique_ptr<OrderBook> createTestOrderBook(OrderBookListener& listener) {
-        return std::make_unique<OrderBook>("TEST", listener);
+        return std::make_unique<BasicOrderBook<>>("TEST", listener);
     }
     
     // Helper to validate order book state
@@ -0,0 +1,38 @@
+#include "core/conflator.h"
+
+uint32_t MarketDataFanout::add(std::shared_ptr<OrderBook> book) {
+    Guard guard(mu);
+    books.push_back(std::move(book));
+    return uint32_t(books.size() - 1);
+}
+
+std::shared_ptr<RingBuffer<BookUpdate>> MarketDataFanout::subscribe(size_t capacity) {
+    auto stream = std::make_shared<RingBuffer<BookUpdate>>(capacity);
+    Guard guard(mu);
+    streams.push_back(stream);
+    return stream;
+}
+
+std::shared_ptr<ConflatedLevels> MarketDataFanout::subscribeConflated() {
+    auto levels = std::make_shared<ConflatedLevels>();
+    Guard guard(mu);
+    conflated.push_back(levels);
+    return levels;
+}
+
+size_t MarketDataFanout::poll() {
+    Guard guard(mu);
+    size_t n = 0;
+    for (uint32_t i = 0; i < books.size(); i++) {
+        auto deltas = books[i]->levelDeltas();
+        if (!deltas) continue;
+        n += deltas->drain([&](const LevelDelta& delta) {
+            const BookUpdate update{i, delta};
+            for (auto& stream : streams) {
+                if (!stream->push(update)) dropped++;
+            }
+            for (auto& levels : conflated) levels->update(update);
+        });
+    }
+    return n;
+}
@@ -1,17 +1,28 @@
 #include "core/exchange.h"
 #include "core/orderbook.h"
+#include <algorithm>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 
 // Mutex lock guard macro for consistent locking
 #define LOCK_EXCHANGE() std::lock_guard<std::mutex> lock(mu)
 
+namespace {
+/** sessions whose protection tripped during the calling thread's command, their quotes are pulled after it */
+thread_local std::vector<SessionProtection*> trippedSessions;
+/** the journaled time of the command being applied, protection windows are measured in command time on replay */
+thread_local int64_t appliedTimestamp = 0;
+/** set while the calling thread applies a journaled command, whose trips are pulled by the journal's PULL records */
+thread_local bool applying = false;
+}
+
 // Get order details by exchange ID with thread-safe access
 std::optional<Order> Exchange::getOrder(long exchangeId) const {
     auto order = allOrders.get(exchangeId);
     if (!order) return std::nullopt;
     
-    auto book = books.get(order->instrument);
+    auto book = bookOf(*order);
     if (!book) return std::nullopt;
     
     auto bookGuard = book->lock();
@@ -27,8 +38,52 @@ std::optional<Book> Exchange::book(std::string_view instrument) const {
     return book->book();
 }
 
+// Level-aggregated depth snapshot into caller buffers
+std::optional<DepthSize> Exchange::depth(std::string_view instrument, std::span<BookLevel> bids, std::span<BookLevel> asks) const {
+    auto book = books.get(instrument);
+    if (!book) return std::nullopt;
+
+    auto bookGuard = book->lock();
+    return book->depth(bids, asks);
+}
+
+// Order-by-order snapshot of one side into a caller buffer
+std::optional<int> Exchange::depthByOrder(std::string_view instrument, Order::Side side, std::span<BookOrder> orders) const {
+    auto book = books.get(instrument);
+    if (!book) return std::nullopt;
+
+    auto bookGuard = book->lock();
+    return book->depthByOrder(side, orders);
+}
+
+// Best bid and offer for specified instrument, without locking the book
+std::optional<TopOfBook> Exchange::topOfBook(std::string_view instrument) const {
+    auto book = books.get(instrument);
+    if (!book) return std::nullopt;
+    return book->topOfBook();
+}
+
+std::optional<TopOfBook> Exchange::topOfBook(InstrumentId instrument) const {
+    auto book = books.get(instrument);
+    if (!book) return std::nullopt;
+    return book->topOfBook();
+}
+
+// Book for specified instrument, for consumers of the book's feeds
+std::shared_ptr<OrderBook> Exchange::orderBook(std::string_view instrument) const {
+    return books.get(instrument);
+}
+
+std::shared_ptr<OrderBook> Exchange::orderBook(InstrumentId instrument) const {
+    return books.get(instrument);
+}
+
 // Cancel order with session validation and thread safety
 CancelResult Exchange::cancel(long exchangeId, std::string_view sessionId) {
+    return cancel(exchangeId, sessionId, false);
+}
+
+CancelResult Exchange::cancel(long exchangeId, std::string_view sessionId, bool replay) {
     auto order = allOrders.get(exchangeId);
     if (!order) {
         return false;
@@ -38,32 +93,188 @@ CancelResult Exchange::cancel(long exchangeId, std::string_view sessionId) {
         return false;
     }
     
-    auto book = books.get(order->instrument);
+    auto book = bookOf(*order);
     if (!book) {
         return false;
     }
 
     auto bookGuard = book->lock();
+    if (journal && !replay && order->isOnList()) {
+        JournalRecord record;
+        record.type = JournalRecord::CANCEL;
+        record.exchangeId = exchangeId;
+        record.timestamp = now().count();
+        journal->append(record, sessionId, book->instrument, "");
+    }
     auto result = book->cancelOrder(order);
     return result == 0;
 }
 
+ModifyResult Exchange::modify(long exchangeId, std::string_view sessionId, F price, int quantity) {
+    return modify(exchangeId, sessionId, price, quantity, false);
+}
+
+ModifyResult Exchange::modify(long exchangeId, std::string_view sessionId, F price, int quantity, bool replay) {
+    auto order = allOrders.get(exchangeId);
+    if (!order || order->sessionId() != sessionId) {
+        return false;
+    }
+
+    auto book = bookOf(*order);
+    if (!book) {
+        return false;
+    }
+
+    bool modified;
+    {
+        auto bookGuard = book->lock();
+        if (journal && !replay && order->isOnList()) {
+            JournalRecord record;
+            record.type = JournalRecord::MODIFY;
+            record.quantity = quantity;
+            record.exchangeId = exchangeId;
+            record.timestamp = now().count();
+            record.price = price;
+            journal->append(record, sessionId, book->instrument, "");
+        }
+        modified = book->modifyOrder(order, price, quantity) == 0;
+    }
+    pullTripped();
+    return modified;
+}
+
+void Exchange::setProtection(std::string_view sessionId, const ProtectionConfig& config) {
+    setProtection(sessionId, config, false);
+}
+
+void Exchange::setProtection(std::string_view sessionId, const ProtectionConfig& config, bool replay) {
+    if (journal && !replay) {
+        JournalRecord record;
+        record.type = JournalRecord::PROTECT;
+        record.quantity = config.quantityLimit;
+        record.askQuantity = config.fillLimit;
+        record.askExchangeId = config.window.count();
+        record.timestamp = now().count();
+        journal->append(record, sessionId, "", "");
+    }
+    sessionProtection(sessionId).configure(config);
+}
+
+bool Exchange::isProtectionTripped(std::string_view sessionId) {
+    return sessionProtection(sessionId).isTripped();
+}
+
+std::shared_ptr<OrderBook> Exchange::bookOf(const Order& order) const {
+    auto book = books.get(order.instrument);
+    // the name may have been registered again since the order's instrument was closed
+    return book && &book->instrument == &order.instrument ? book : nullptr;
+}
+
+SessionProtection& Exchange::sessionProtection(std::string_view sessionId) {
+    Guard guard(protectionsLock);
+    auto it = protections.find(sessionId);
+    if (it == protections.end()) {
+        it = protections.emplace(std::string(sessionId), std::make_unique<SessionProtection>(std::string(sessionId))).first;
+    }
+    return *it->second;
+}
+
+void Exchange::onQuoteFill(const Order& quote, int quantity) {
+    const int64_t time = appliedTimestamp ? appliedTimestamp : now().count();
+    if (quote.protection->onFill(time, quantity)) trippedSessions.push_back(quote.protection);
+}
+
+bool Exchange::pullsQuote(const Order& quote) {
+    // only a trip by this command: it is journaled before the trades that follow it, so a replay pulls the same quotes
+    return std::find(trippedSessions.begin(), trippedSessions.end(), quote.protection) != trippedSessions.end();
+}
+
+void Exchange::pullTripped() {
+    while (!trippedSessions.empty()) {
+        auto protection = trippedSessions.back();
+        trippedSessions.pop_back();
+        if (replaying || applying) {
+            listener.onProtectionTrip(protection->sessionId);
+            continue;
+        }
+        thread_local std::vector<std::shared_ptr<Order>> resting;
+        resting.clear();
+        protection->restingQuotes(resting);
+        // the bid and ask of a quote rest together, so quotes of one book are usually adjacent and pulled under one lock
+        for (size_t i = 0, end; i < resting.size(); i = end) {
+            for (end = i + 1; end < resting.size() && &resting[end]->instrument == &resting[i]->instrument; end++) {}
+            // the instrument was closed, cancelling its quotes
+            auto book = bookOf(*resting[i]);
+            if (!book) continue;
+            auto bookGuard = book->lock();
+            for (size_t q = i; q < end; q++) {
+                // filled or cancelled since
+                if (resting[q]->isOnList()) pullQuote(*book, resting[q], false);
+            }
+        }
+        resting.clear();
+        listener.onProtectionTrip(protection->sessionId);
+    }
+}
+
+void Exchange::pullQuote(OrderBook& book, const std::shared_ptr<Order>& quote, bool replay) {
+    if (journal && !replay) {
+        JournalRecord record;
+        record.type = JournalRecord::PULL;
+        record.exchangeId = quote->exchangeId;
+        record.timestamp = now().count();
+        journal->append(record, quote->sessionId(), book.instrument, "");
+    }
+    QuoteOrders orders;
+    (quote->side == Order::BUY ? orders.bid : orders.ask) = quote;
+    book.quote(orders, 0, 0, 0, 0);
+}
+
 OrderResult Exchange::insertOrder(
     std::string_view sessionId,
     std::string_view instrument,
     F price,
     int quantity,
     Order::Side side,
-    std::string_view orderId
+    std::string_view orderId,
+    long replayId
 ) {
+    std::shared_ptr<OrderBook> book;
+    try {
+        book = books.getOrCreate(instrument, *this, bookConfigure);
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+    return insertOrder(sessionId, book, price, quantity, side, orderId, replayId);
+}
+
+OrderResult Exchange::insertOrder(
+    std::string_view sessionId,
+    const std::shared_ptr<OrderBook>& book,
+    F price,
+    int quantity,
+    Order::Side side,
+    std::string_view orderId,
+    long replayId
+) {
+    if (!book) {
+        return std::nullopt;
+    }
+    long id;
     try {
-        auto book = books.getOrCreate(std::string(instrument), *this);
-        if (!book) {
-            return std::nullopt;
-        }
-        
         auto bookGuard = book->lock();
-        long id = nextID();
+        // closed since it was looked up
+        if (book->isClosed()) return std::nullopt;
+        id = replayId ? replayId : nextID();
+        if (journal && !replayId) {
+            JournalRecord record;
+            record.type = side == Order::BUY ? JournalRecord::BUY : JournalRecord::SELL;
+            record.quantity = quantity;
+            record.exchangeId = id;
+            record.timestamp = now().count();
+            record.price = price;
+            journal->append(record, sessionId, book->instrument, orderId);
+        }
         
         auto order = Order::create(
             std::string(sessionId),
@@ -77,10 +288,11 @@ OrderResult Exchange::insertOrder(
         
         allOrders.add(order);
         book->insertOrder(order);
-        return id;
     } catch (const std::exception&) {
         return std::nullopt;
     }
+    pullTripped();
+    return id;
 }
 
 OrderResult Exchange::buy(
@@ -103,6 +315,74 @@ OrderResult Exchange::sell(
     return insertOrder(sessionId, instrument, price, quantity, Order::SELL, orderId);
 }
 
+InstrumentId Exchange::registerInstrument(std::string_view instrument) {
+    return books.add(instrument);
+}
+
+bool Exchange::closeInstrument(std::string_view instrument) {
+    auto id = books.find(instrument);
+    return id && closeInstrument(*id);
+}
+
+bool Exchange::closeInstrument(InstrumentId instrument) {
+    return closeInstrument(instrument, false);
+}
+
+bool Exchange::closeInstrument(InstrumentId instrument, bool replay) {
+    // an instrument that never traded gets a book too, so that closing it is serialized by the book lock
+    auto book = books.getOrCreate(instrument, *this, bookConfigure);
+    if (!book) return false;
+
+    auto bookGuard = book->lock();
+    // closed by another thread since it was looked up
+    if (book->isClosed()) return false;
+    if (journal && !replay) {
+        JournalRecord record;
+        record.type = JournalRecord::CLOSE;
+        record.timestamp = now().count();
+        journal->append(record, "", book->instrument, "");
+    }
+    // commands that looked the book up are rejected from now on
+    book->close();
+    // the name is freed only once CLOSE is journaled: a new listing of the name journals after it, and replay,
+    // which resolves CLOSE by name, closes the right instrument
+    books.retire(instrument);
+    std::vector<long> resting;
+    for (auto side : {Order::BUY, Order::SELL}) {
+        book->forEachOrder(side, [&](const Order& order) { resting.push_back(order.exchangeId); });
+    }
+    for (auto id : resting) book->cancelOrder(allOrders.get(id));
+    Guard guard(mu);
+    closedNames.push_back(book->instrumentName());
+    return true;
+}
+
+OrderResult Exchange::buy(std::string_view sessionId, InstrumentId instrument, F price, int quantity, std::string_view orderId) {
+    return insertOrder(sessionId, books.getOrCreate(instrument, *this, bookConfigure), price, quantity, Order::BUY, orderId);
+}
+
+OrderResult Exchange::sell(std::string_view sessionId, InstrumentId instrument, F price, int quantity, std::string_view orderId) {
+    return insertOrder(sessionId, books.getOrCreate(instrument, *this, bookConfigure), price, quantity, Order::SELL, orderId);
+}
+
+void Exchange::quote(
+    std::string_view sessionId,
+    InstrumentId instrument,
+    F bidPrice,
+    int bidQuantity,
+    F askPrice,
+    int askQuantity,
+    std::string_view quoteId
+) {
+    auto book = books.getOrCreate(instrument, *this, bookConfigure);
+    if (!book) return;
+    {
+        auto bookGuard = book->lock();
+        quoteLocked(*book, sessionId, bidPrice, bidQuantity, askPrice, askQuantity, quoteId, nullptr);
+    }
+    pullTripped();
+}
+
 void Exchange::quote(
     std::string_view sessionId,
     std::string_view instrument,
@@ -112,50 +392,234 @@ void Exchange::quote(
     int askQuantity,
     std::string_view quoteId
 ) {
-    auto book = books.getOrCreate(std::string(instrument), *this);
-    auto bookGuard = book->lock();
-    
-    auto orders = book->getQuotes(
-        std::string(sessionId),
-        std::string(quoteId),
+    quote(sessionId, instrument, bidPrice, bidQuantity, askPrice, askQuantity, quoteId, nullptr);
+}
+
+void Exchange::quote(
+    std::string_view sessionId,
+    std::string_view instrument,
+    F bidPrice,
+    int bidQuantity,
+    F askPrice,
+    int askQuantity,
+    std::string_view quoteId,
+    const JournalRecord* replay
+) {
+    {
+        auto book = books.getOrCreate(instrument, *this, bookConfigure);
+        if (!book) return;
+        auto bookGuard = book->lock();
+        quoteLocked(*book, sessionId, bidPrice, bidQuantity, askPrice, askQuantity, quoteId, replay);
+    }
+    pullTripped();
+}
+
+QuoteStatus Exchange::quoteLocked(
+    OrderBook& book,
+    std::string_view sessionId,
+    F bidPrice,
+    int bidQuantity,
+    F askPrice,
+    int askQuantity,
+    std::string_view quoteId,
+    const JournalRecord* replay
+) {
+    if (book.isClosed()) return QuoteStatus::NO_BOOK;
+    // rejected while the session's protection is tripped, before a new quote takes ids for its orders; a journaled
+    // quote was accepted, its session may have tripped on another book before the quote's record was journaled
+    auto& protection = sessionProtection(sessionId);
+    if (!replay && !replaying && protection.isTripped()) return QuoteStatus::PROTECTED;
+    const auto& orders = book.getQuotes(
+        sessionId,
+        quoteId,
         [&]() -> QuoteOrders {
+            // the ids are copied only into a new quote's orders
+            const std::string session(sessionId);
+            const std::string id(quoteId);
             QuoteOrders result;
             
             if (bidQuantity > 0) {
                 result.bid = Order::create(
-                    std::string(sessionId),
-                    std::string(quoteId),
-                    book->instrument,
+                    session,
+                    id,
+                    book.instrument,
                     bidPrice,
                     bidQuantity,
                     Order::BUY,
-                    nextID()
+                    replay ? long(replay->exchangeId) : nextID()
                 );
+                result.bid->_isQuote = true;
                 allOrders.add(result.bid);
             }
             
             if (askQuantity > 0) {
                 result.ask = Order::create(
-                    std::string(sessionId),
-                    std::string(quoteId),
-                    book->instrument,
+                    session,
+                    id,
+                    book.instrument,
                     askPrice,
                     askQuantity,
                     Order::SELL,
-                    nextID()
+                    replay ? long(replay->askExchangeId) : nextID()
                 );
+                result.ask->_isQuote = true;
                 allOrders.add(result.ask);
             }
             
+            if (result.bid) protection.add(*result.bid);
+            if (result.ask) protection.add(*result.ask);
             return result;
         }
     );
     
-    book->quote(orders, bidPrice, bidQuantity, askPrice, askQuantity);
+    if (journal && !replay) {
+        JournalRecord record;
+        record.type = JournalRecord::QUOTE;
+        record.quantity = bidQuantity;
+        record.askQuantity = askQuantity;
+        // the ids of the quote's orders, replay creates them with the same ids
+        record.exchangeId = orders.bid ? orders.bid->exchangeId : 0;
+        record.askExchangeId = orders.ask ? orders.ask->exchangeId : 0;
+        record.timestamp = now().count();
+        record.price = bidPrice;
+        record.askPrice = askPrice;
+        journal->append(record, sessionId, book.instrument, quoteId);
+    }
+    book.quote(orders, bidPrice, bidQuantity, askPrice, askQuantity);
+    return QuoteStatus::ACCEPTED;
+}
+
+namespace {
+
+/**
+ * groups massQuote entries by book in one pass: an open addressing table keyed by the book pointer heads a chain of
+ * entry indexes per book, in entry order. Sorting instead costs more than the locks it saves when, as usual, each
+ * series is quoted once per update. The books are held until reset, an instrument may be closed meanwhile.
+ */
+struct QuoteGroups {
+    static constexpr uint32_t NONE = UINT32_MAX;
+    struct Group {
+        std::shared_ptr<OrderBook> book;
+        uint32_t first = NONE;
+        uint32_t last = NONE;
+    };
+    std::vector<Group> table;
+    /** occupied table slots in first seen order */
+    std::vector<uint32_t> groups;
+    /** the next entry index of the same book */
+    std::vector<uint32_t> next;
+    size_t mask = 0;
+
+    void reset(size_t entries) {
+        size_t size = 16;
+        while (size < entries * 2) size *= 2;
+        if (table.size() < size) table.resize(size);
+        for (auto slot : groups) table[slot] = Group{};
+        groups.clear();
+        mask = table.size() - 1;
+        next.resize(entries);
+    }
+    void add(std::shared_ptr<OrderBook> book, uint32_t entry) {
+        auto slot = size_t((reinterpret_cast<uintptr_t>(book.get()) >> 4) * 0x9E3779B97F4A7C15ull) & mask;
+        while (table[slot].book && table[slot].book != book) slot = (slot + 1) & mask;
+        auto& group = table[slot];
+        next[entry] = NONE;
+        if (!group.book) {
+            group = Group{std::move(book), entry, entry};
+            groups.push_back(uint32_t(slot));
+        } else {
+            next[group.last] = entry;
+            group.last = entry;
+        }
+    }
+};
+
+}
+
+size_t Exchange::massQuote(std::string_view sessionId, std::span<const QuoteEntry> entries, std::span<QuoteStatus> status) {
+    if (status.size() < entries.size()) throw std::invalid_argument("massQuote status buffer smaller than the entries");
+    thread_local QuoteGroups grouped;
+    grouped.reset(entries.size());
+    size_t accepted = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const auto& entry = entries[i];
+        if (entry.bidQuantity < 0 || entry.askQuantity < 0) {
+            status[i] = QuoteStatus::INVALID;
+            continue;
+        }
+        try {
+            auto book = books.getOrCreate(entry.instrument, *this, bookConfigure);
+            if (book) {
+                grouped.add(std::move(book), uint32_t(i));
+                continue;
+            }
+        } catch (const std::runtime_error&) {
+        }
+        status[i] = QuoteStatus::NO_BOOK;
+    }
+
+    for (auto slot : grouped.groups) {
+        auto& book = *grouped.table[slot].book;
+        auto bookGuard = book.lock();
+        for (auto i = grouped.table[slot].first; i != QuoteGroups::NONE; i = grouped.next[i]) {
+            const auto& entry = entries[i];
+            status[i] = quoteLocked(book, sessionId, entry.bidPrice, entry.bidQuantity, entry.askPrice, entry.askQuantity, entry.quoteId, nullptr);
+            if (status[i] == QuoteStatus::ACCEPTED) accepted++;
+        }
+    }
+    // releases the books
+    grouped.reset(0);
+    pullTripped();
+    return accepted;
 }
 
 // C++26: Modern atomic ID generation
 long Exchange::nextID() {
-    static std::atomic<long> id = 0;
-    return ++id;
+    return ids ? ids() : ++lastId;
+}
+
+size_t Exchange::recover(const std::string& directory) {
+    return Journal::replay(directory, [this](const JournalEntry& entry) { apply(entry); }, recoverFrom);
+}
+
+void Exchange::apply(const JournalEntry& entry) {
+    const auto& record = entry.record;
+    appliedTimestamp = record.timestamp;
+    applying = true;
+    switch (record.type) {
+        case JournalRecord::BUY:
+        case JournalRecord::SELL:
+            insertOrder(entry.sessionId, entry.instrument, record.price, record.quantity,
+                        record.type == JournalRecord::BUY ? Order::BUY : Order::SELL, entry.clientId, long(record.exchangeId));
+            break;
+        case JournalRecord::QUOTE:
+            quote(entry.sessionId, entry.instrument, record.price, record.quantity, record.askPrice, record.askQuantity, entry.clientId, &record);
+            break;
+        case JournalRecord::CANCEL:
+            cancel(long(record.exchangeId), entry.sessionId, true);
+            break;
+        case JournalRecord::MODIFY:
+            modify(long(record.exchangeId), entry.sessionId, record.price, record.quantity, true);
+            break;
+        case JournalRecord::PROTECT:
+            setProtection(entry.sessionId, {std::chrono::nanoseconds(record.askExchangeId), record.quantity, record.askQuantity}, true);
+            break;
+        case JournalRecord::CLOSE:
+            if (auto id = books.find(entry.instrument)) closeInstrument(*id, true);
+            break;
+        case JournalRecord::PULL:
+            if (auto quote = allOrders.get(long(record.exchangeId)); quote && quote->isQuote()) {
+                auto book = bookOf(*quote);
+                if (!book) break;
+                auto bookGuard = book->lock();
+                if (quote->isOnList()) pullQuote(*book, quote, true);
+            }
+            break;
+    }
+    appliedTimestamp = 0;
+    applying = false;
+    if (record.type == JournalRecord::PROTECT || record.type == JournalRecord::CLOSE || record.type == JournalRecord::PULL) return;
+    // the id counter continues after the highest id recorded
+    const long id = std::max(long(record.exchangeId), long(record.askExchangeId));
+    if (id > lastId.load(std::memory_order_relaxed)) lastId.store(id, std::memory_order_relaxed);
 }
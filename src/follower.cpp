@@ -0,0 +1,47 @@
+#include "core/follower.h"
+
+#include <mutex>
+
+JournalFollower::JournalFollower(Exchange& exchange, const std::string& directory) : exchange(exchange), tailer(directory) {}
+
+JournalFollower::~JournalFollower() {
+    stop();
+}
+
+size_t JournalFollower::poll() {
+    std::lock_guard<SpinLock> guard(histogramLock);
+    return tailer.poll([&](const JournalEntry& entry) {
+        exchange.apply(entry);
+        const int64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>(epoch()).count() - entry.record.timestamp;
+        histogram.record(uint64_t(std::max<int64_t>(lag, 0)));
+        lastLag.store(lag, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+    });
+}
+
+void JournalFollower::start(std::chrono::microseconds idleSleep) {
+    if (running.exchange(true)) return;
+    thread = std::thread([this, idleSleep]() {
+        while (running.load(std::memory_order_relaxed)) {
+            if (poll() == 0 && idleSleep.count() > 0) std::this_thread::sleep_for(idleSleep);
+        }
+    });
+}
+
+void JournalFollower::stop() {
+    if (running.exchange(false)) thread.join();
+}
+
+uint64_t JournalFollower::promote() {
+    stop();
+    // the primary is dead, what it left torn is skipped exactly as a recovery of the directory would
+    tailer.writerStopped();
+    while (poll() > 0) {
+    }
+    return applied();
+}
+
+LatencyHistogram JournalFollower::lagHistogram() const {
+    std::lock_guard<SpinLock> guard(histogramLock);
+    return histogram;
+}
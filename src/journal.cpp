@@ -0,0 +1,314 @@
+#include "core/journal.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+std::vector<std::string> Journal::segmentFiles(const std::string& directory) {
+    std::vector<std::string> files;
+    if (!std::filesystem::is_directory(directory)) return files;
+    for (auto& entry : std::filesystem::directory_iterator(directory)) {
+        auto name = entry.path().filename().string();
+        if (name.starts_with("journal.")) files.push_back(entry.path().string());
+    }
+    // fixed width sequence numbers, lexical order is journal order
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+#ifndef _WIN32
+
+/** the sequence number in a segment file name */
+static int segmentNumber(const std::string& path) {
+    return std::stoi(std::filesystem::path(path).extension().string().substr(1));
+}
+
+static std::runtime_error journalError(const std::string& what, const std::string& path) {
+    return std::runtime_error(what + " failed for journal " + path + ": " + std::strerror(errno));
+}
+
+Journal::Journal(const JournalConfig& config) : config(config) {
+    if (config.segmentSize < 4096) throw std::invalid_argument("journal segment size too small");
+    std::filesystem::create_directories(config.directory);
+    for (auto& file : segmentFiles(config.directory)) {
+        nextSegment = std::max(nextSegment, segmentNumber(file) + 1);
+    }
+    segments.reserve(1024);
+    openSegment();
+    if (config.sync == JournalSync::GROUP) {
+        running = true;
+        syncThread = std::thread([this]() {
+            while (running.load(std::memory_order_relaxed)) {
+                std::this_thread::sleep_for(this->config.groupCommitInterval);
+                std::lock_guard<std::mutex> guard(rollover);
+                syncSegments();
+            }
+        });
+    }
+}
+
+Journal::~Journal() {
+    if (running.exchange(false)) syncThread.join();
+    std::lock_guard<std::mutex> guard(rollover);
+    if (config.sync != JournalSync::NONE) syncSegments();
+    for (auto& segment : segments) munmap(segment->base, segment->capacity);
+}
+
+/** must hold rollover, or be called from the constructor */
+void Journal::openSegment() {
+    char name[32];
+    std::snprintf(name, sizeof name, "journal.%06d", nextSegment++);
+    const auto path = (std::filesystem::path(config.directory) / name).string();
+
+    int fd = open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) throw journalError("open", path);
+    if (ftruncate(fd, off_t(config.segmentSize)) != 0) {
+        close(fd);
+        throw journalError("ftruncate", path);
+    }
+    void* base = mmap(nullptr, config.segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) throw journalError("mmap", path);
+#ifdef MADV_WILLNEED
+    madvise(base, config.segmentSize, MADV_WILLNEED);
+#endif
+
+    auto segment = std::make_unique<Segment>();
+    segment->base = static_cast<char*>(base);
+    segment->capacity = config.segmentSize;
+    segment->number = nextSegment - 1;
+    current.store(segment.get(), std::memory_order_release);
+    segments.push_back(std::move(segment));
+}
+
+/** must hold rollover */
+void Journal::syncSegments() {
+    const long page = sysconf(_SC_PAGESIZE);
+    for (auto& segment : segments) {
+        const auto end = std::min(segment->reserved.load(std::memory_order_acquire), segment->capacity);
+        if (end <= segment->synced) continue;
+        const auto start = segment->synced & ~size_t(page - 1);
+        msync(segment->base + start, end - start, MS_SYNC);
+        segment->synced = end;
+    }
+}
+
+void Journal::sync() {
+    std::lock_guard<std::mutex> guard(rollover);
+    syncSegments();
+}
+
+JournalPosition Journal::position() const {
+    const Segment* segment = current.load(std::memory_order_acquire);
+    return {segment->number, std::min(segment->reserved.load(std::memory_order_acquire), segment->capacity)};
+}
+
+void Journal::write(Segment* segment, size_t offset, const JournalRecord& header, std::string_view session,
+                    std::string_view instrument, std::string_view clientId) {
+    char* dst = segment->base + offset;
+    auto* record = reinterpret_cast<JournalRecord*>(dst);
+    // the size first, readers can step over the record while it is written, or if it is torn by a crash
+    std::atomic_ref<uint32_t>(record->size).store(header.size, std::memory_order_release);
+    // complete is left 0 (segments are zero filled) until the rest is written
+    record->type = header.type;
+    constexpr size_t body = offsetof(JournalRecord, sessionLength);
+    std::memcpy(dst + body, reinterpret_cast<const char*>(&header) + body, sizeof(JournalRecord) - body);
+    char* strings = dst + sizeof(JournalRecord);
+    std::memcpy(strings, session.data(), session.size());
+    std::memcpy(strings + session.size(), instrument.data(), instrument.size());
+    std::memcpy(strings + session.size() + instrument.size(), clientId.data(), clientId.size());
+    // publishing complete last makes the record visible to a concurrent reader only once written
+    std::atomic_ref<uint8_t>(record->complete).store(1, std::memory_order_release);
+}
+
+void Journal::append(JournalRecord record, std::string_view sessionId, std::string_view instrument, std::string_view clientId) {
+    record.sessionLength = uint16_t(std::min<size_t>(sessionId.size(), UINT16_MAX));
+    record.instrumentLength = uint16_t(std::min<size_t>(instrument.size(), UINT16_MAX));
+    record.clientIdLength = uint16_t(std::min<size_t>(clientId.size(), UINT16_MAX));
+    const size_t size = align8(sizeof(JournalRecord) + record.sessionLength + record.instrumentLength + record.clientIdLength);
+    if (size > config.segmentSize) throw std::invalid_argument("journal record larger than a segment");
+    record.size = uint32_t(size);
+
+    while (true) {
+        Segment* segment = current.load(std::memory_order_acquire);
+        const size_t offset = segment->reserved.fetch_add(size, std::memory_order_relaxed);
+        if (offset + size <= segment->capacity) {
+            write(segment, offset, record, sessionId.substr(0, record.sessionLength), instrument.substr(0, record.instrumentLength),
+                  clientId.substr(0, record.clientIdLength));
+            if (config.sync == JournalSync::EVERY) {
+                const long page = sysconf(_SC_PAGESIZE);
+                const auto start = offset & ~size_t(page - 1);
+                msync(segment->base + start, offset + size - start, MS_SYNC);
+            }
+            return;
+        }
+        if (offset <= segment->capacity) {
+            // exactly one append crosses the end of the segment, it links the segment to the next one
+            if (offset + sizeof(uint32_t) <= segment->capacity) {
+                std::atomic_ref<uint32_t>(*reinterpret_cast<uint32_t*>(segment->base + offset)).store(JournalRecord::SEGMENT_END, std::memory_order_release);
+            }
+            std::lock_guard<std::mutex> guard(rollover);
+            openSegment();
+        } else {
+            while (current.load(std::memory_order_acquire) == segment) std::this_thread::yield();
+        }
+    }
+}
+
+size_t Journal::replay(const std::string& directory, const std::function<void(const JournalEntry&)>& fn, JournalPosition from) {
+    size_t count = 0;
+    for (auto& path : segmentFiles(directory)) {
+        const int number = segmentNumber(path);
+        if (number < from.segment) continue;
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw journalError("open", path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw journalError("fstat", path);
+        }
+        const size_t capacity = size_t(st.st_size);
+        if (capacity == 0) {
+            close(fd);
+            continue;
+        }
+        void* base = mmap(nullptr, capacity, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) throw journalError("mmap", path);
+#ifdef MADV_SEQUENTIAL
+        madvise(base, capacity, MADV_SEQUENTIAL);
+#endif
+        const char* data = static_cast<const char*>(base);
+        size_t offset = number == from.segment ? from.offset : 0;
+        // a segment ends at its end marker, at its end, or at the first space reserved but never sized (e.g. a crash)
+        while (offset + sizeof(JournalRecord) <= capacity) {
+            const auto& record = *reinterpret_cast<const JournalRecord*>(data + offset);
+            const auto size = std::atomic_ref<uint32_t>(const_cast<uint32_t&>(record.size)).load(std::memory_order_acquire);
+            if (size == 0 || size == JournalRecord::SEGMENT_END || size < sizeof(JournalRecord) || offset + size > capacity) break;
+            // torn by a crash while it was written, the records after it are intact
+            if (std::atomic_ref<uint8_t>(const_cast<uint8_t&>(record.complete)).load(std::memory_order_acquire) == 0) {
+                offset += size;
+                continue;
+            }
+            const char* strings = data + offset + sizeof(JournalRecord);
+            const JournalEntry entry{
+                record,
+                std::string_view(strings, record.sessionLength),
+                std::string_view(strings + record.sessionLength, record.instrumentLength),
+                std::string_view(strings + record.sessionLength + record.instrumentLength, record.clientIdLength),
+            };
+            fn(entry);
+            count++;
+            offset += size;
+        }
+        munmap(base, capacity);
+    }
+    return count;
+}
+
+JournalTailer::JournalTailer(std::string directory) : directory(std::move(directory)) {}
+
+JournalTailer::~JournalTailer() {
+    if (base) munmap(const_cast<char*>(base), capacity);
+}
+
+bool JournalTailer::openNext() {
+    const auto files = Journal::segmentFiles(directory);
+    const auto next = std::upper_bound(files.begin(), files.end(), path);
+    if (next == files.end()) return false;
+    int fd = open(next->c_str(), O_RDONLY);
+    if (fd < 0) throw journalError("open", *next);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw journalError("fstat", *next);
+    }
+    // created but not yet preallocated by the writer
+    if (size_t(st.st_size) < sizeof(JournalRecord)) {
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) throw journalError("mmap", *next);
+    if (base) munmap(const_cast<char*>(base), capacity);
+    base = static_cast<const char*>(mapping);
+    capacity = size_t(st.st_size);
+    offset = 0;
+    path = *next;
+    return true;
+}
+
+size_t JournalTailer::poll(const std::function<void(const JournalEntry&)>& fn, size_t max) {
+    size_t count = 0;
+    if (!base && !openNext()) return 0;
+    while (count < max) {
+        if (offset + sizeof(JournalRecord) <= capacity) {
+            const auto& record = *reinterpret_cast<const JournalRecord*>(base + offset);
+            const auto size = std::atomic_ref<uint32_t>(const_cast<uint32_t&>(record.size)).load(std::memory_order_acquire);
+            // reserved or not yet written, or never sized by a dead writer: the segment ends here, as for replay()
+            if (size == 0 && !stopped) break;
+            if (size != 0 && size != JournalRecord::SEGMENT_END) {
+                if (size < sizeof(JournalRecord) || offset + size > capacity) throw std::runtime_error("corrupt journal record in " + path);
+                if (std::atomic_ref<uint8_t>(const_cast<uint8_t&>(record.complete)).load(std::memory_order_acquire) == 0) {
+                    if (!stopped) break;
+                    // torn by the writer's crash, replay() skips it too
+                    offset += size;
+                    continue;
+                }
+                const char* strings = base + offset + sizeof(JournalRecord);
+                const JournalEntry entry{
+                    record,
+                    std::string_view(strings, record.sessionLength),
+                    std::string_view(strings + record.sessionLength, record.instrumentLength),
+                    std::string_view(strings + record.sessionLength + record.instrumentLength, record.clientIdLength),
+                };
+                fn(entry);
+                count++;
+                offset += size;
+                continue;
+            }
+        }
+        // the segment is complete, the journal continues in the next one once it exists
+        if (!openNext()) break;
+    }
+    return count;
+}
+
+#else
+
+Journal::Journal(const JournalConfig& config) : config(config) {
+    throw std::runtime_error("the journal requires POSIX memory mapped files");
+}
+Journal::~Journal() {}
+void Journal::append(JournalRecord, std::string_view, std::string_view, std::string_view) {}
+void Journal::sync() {}
+JournalPosition Journal::position() const {
+    return {};
+}
+size_t Journal::replay(const std::string&, const std::function<void(const JournalEntry&)>&, JournalPosition) {
+    throw std::runtime_error("the journal requires POSIX memory mapped files");
+}
+JournalTailer::JournalTailer(std::string directory) : directory(std::move(directory)) {
+    throw std::runtime_error("the journal requires POSIX memory mapped files");
+}
+JournalTailer::~JournalTailer() {}
+size_t JournalTailer::poll(const std::function<void(const JournalEntry&)>&, size_t) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#include "core/mdpublisher.h"
+
+#include <algorithm>
+
+void MarketDataPublisher::add(std::shared_ptr<OrderBook> book) {
+    Source source;
+    const auto n = std::min(book->instrument.size(), sizeof(source.prototype.instrument));
+    std::memcpy(source.prototype.instrument, book->instrument.data(), n);
+    source.book = std::move(book);
+    Guard guard(mu);
+    sources.push_back(std::move(source));
+}
+
+size_t MarketDataPublisher::poll() {
+    Guard guard(mu);
+    size_t n = 0;
+    for (auto& source : sources) n += poll(source);
+    return n;
+}
+
+size_t MarketDataPublisher::poll(Source& source) {
+    size_t n = 0;
+    if (auto deltas = source.book->levelDeltas()) {
+        deltas->drain([&](const LevelDelta& delta) {
+            MarketDataRecord record = source.prototype;
+            record.type = MarketDataRecord::LEVEL;
+            record.side = delta.side;
+            record.sequence = delta.sequence;
+            record.price = delta.price;
+            record.quantity = delta.quantity;
+            ring.write(record);
+            n++;
+        });
+    }
+    if (auto events = source.book->orderEvents()) {
+        events->drain([&](const OrderEvent& event) {
+            MarketDataRecord record = source.prototype;
+            record.type = MarketDataRecord::ORDER;
+            record.event = event.type;
+            record.side = event.side;
+            record.sequence = event.sequence;
+            record.exchangeId = event.exchangeId;
+            record.price = event.price;
+            record.quantity = event.quantity;
+            record.remaining = event.remaining;
+            ring.write(record);
+            n++;
+
+            if (event.type != OrderEvent::EXECUTE) return;
+            // the aggressor's EXECUTE immediately follows the resting order's, unless events were dropped
+            const auto& first = source.execute;
+            if (first.sequence == 0 || first.sequence + 1 != event.sequence || first.side == event.side
+                || first.quantity != event.quantity || !(first.price == event.price)) {
+                source.execute = event;
+                return;
+            }
+            record.type = MarketDataRecord::TRADE;
+            record.exchangeId = source.execute.exchangeId;
+            record.aggressorId = event.exchangeId;
+            record.remaining = 0;
+            ring.write(record);
+            n++;
+            source.execute.sequence = 0;
+        });
+    }
+    return n;
+}
+
+void MarketDataPublisher::start() {
+    if (running.exchange(true)) return;
+    thread = std::thread([this]() {
+        while (running.load(std::memory_order_relaxed)) {
+            if (poll() == 0) std::this_thread::yield();
+        }
+        poll();
+    });
+}
+
+void MarketDataPublisher::stop() {
+    if (!running.exchange(false)) return;
+    thread.join();
+}
@@ -11,7 +11,8 @@
 
 #define LOCK_BOOK() std::lock_guard<std::recursive_mutex> lock(mu)
 
-void OrderBook::insertOrder(std::shared_ptr<Order> order) {
+template <typename Levels>
+void BasicOrderBook<Levels>::insertOrder(std::shared_ptr<Order> order) {
     // Add null pointer check
     if (!order) {
         return;
@@ -22,24 +23,64 @@ void OrderBook::insertOrder(std::shared_ptr<Order> order) {
         return;
     }
     
-    auto list = order->side == Order::BUY ? &bids : &asks;
-    
-    // Add safety check for list
-    if (!list) {
+    listener.onOrder(*order);
+    match(order);
+    publish();
+}
+
+template <typename Levels>
+void BasicOrderBook<Levels>::match(const std::shared_ptr<Order>& order) {
+    // the opposite side is walked directly, only the residual is inserted: a marketable order creates no level
+    auto& opposite = order->side == Order::BUY ? asks : bids;
+    while (order->remaining > 0 && !opposite.empty()) {
+        auto resting = opposite.front();
+        if (order->side == Order::BUY ? order->_price < resting->_price : order->_price > resting->_price) break;
+        if (pullProtected(opposite, resting)) continue;
+        int qty = MIN(order->remaining, resting->remaining);
+        F price = MIN(order->_price, resting->_price);
+
+        order->fill(qty, price);
+        resting->fill(qty, price);
+        int level = opposite.frontList()->reduce(qty);
+
+        const Trade trade(price, qty, *order, *resting, long(now().count()));
+
+        if (resting->remaining == 0) {
+            level = opposite.removeOrder(resting);
+        }
+        touch(resting->side, resting->_price, level);
+        event(OrderEvent::EXECUTE, *resting, price, qty);
+        event(OrderEvent::EXECUTE, *order, price, qty);
+        if (resting->protection) listener.onQuoteFill(*resting, qty);
+        const auto& bid = order->side == Order::BUY ? *order : *resting;
+        const auto& ask = order->side == Order::BUY ? *resting : *order;
+        listener.onOrder(bid);
+        listener.onOrder(ask);
+        listener.onTrade(trade);
+    }
+    if (order->remaining == 0) return;
+    // cancel remaining market order
+    // TODO support convert to limit order
+    if (order->isMarket()) {
+        order->cancel();
+        listener.onOrder(*order);
         return;
     }
-    
-    list->insertOrder(order);
-    listener.onOrder(*order);
-    matchOrders(order->side);
+    auto& levels = order->side == Order::BUY ? bids : asks;
+    const int level = levels.insertOrder(order);
+    touch(order->side, order->_price, level, level == order->remaining);
+    event(OrderEvent::ADD, *order, order->_price, order->remaining);
 }
 
-void OrderBook::matchOrders(Order::Side aggressorSide) {
+template <typename Levels>
+void BasicOrderBook<Levels>::matchOrders(Order::Side aggressorSide) {
     while (!bids.empty() && !asks.empty()) {
         auto bid = bids.front();
         auto ask = asks.front();
 
         if (bid->_price >= ask->_price) {
+            // a quote of a session whose protection tripped is pulled instead of traded
+            if (pullProtected(bids, bid) | pullProtected(asks, ask)) continue;
             int qty = MIN(bid->remaining, ask->remaining);
             F price = MIN(bid->_price, ask->_price);
 
@@ -48,15 +89,23 @@ void OrderBook::matchOrders(Order::Side aggressorSide) {
 
             bid->fill(qty,price);
             ask->fill(qty,price);
+            int bidLevel = bids.frontList()->reduce(qty);
+            int askLevel = asks.frontList()->reduce(qty);
 
-            const Trade trade(price, qty, *aggressor, *opposite);
+            const Trade trade(price, qty, *aggressor, *opposite, long(now().count()));
 
             if (bid->remaining == 0) {
-                bids.removeOrder(bid);
+                bidLevel = bids.removeOrder(bid);
             }
             if (ask->remaining == 0) {
-                asks.removeOrder(ask);
+                askLevel = asks.removeOrder(ask);
             }
+            touch(Order::BUY, bid->_price, bidLevel);
+            touch(Order::SELL, ask->_price, askLevel);
+            event(OrderEvent::EXECUTE, *opposite, price, qty);
+            event(OrderEvent::EXECUTE, *aggressor, price, qty);
+            if (bid->protection) listener.onQuoteFill(*bid, qty);
+            if (ask->protection) listener.onQuoteFill(*ask, qty);
             listener.onOrder(*bid);
             listener.onOrder(*ask);
             listener.onTrade(trade);
@@ -64,57 +113,82 @@ void OrderBook::matchOrders(Order::Side aggressorSide) {
             break;
         }
     }
-    // cancel remaining market order
-    // TODO support convert to limit order
-    auto orders = aggressorSide == Order::BUY ? &bids : &asks;
-    if (!orders->empty()) {
-        auto order = orders->front();
-        if (order && order->isMarket()) {
-            order->cancel();
-            orders->removeOrder(order);
-            listener.onOrder(*order);
-        }
-    }
 }
 
-QuoteOrders OrderBook::getQuotes(const std::string& sessionId, const std::string& quoteId, std::function<QuoteOrders()> createOrders) {
-    auto key = SessionQuoteId(sessionId, quoteId);
-    auto itr = quotes.find(key);
-    if (itr == quotes.end()) {
-        return quotes[key] = createOrders();
-    } else {
-        return itr->second;
+template <typename Levels>
+void BasicOrderBook<Levels>::quote(const QuoteOrders& quotes, F bidPrice, int bidQuantity, F askPrice, int askQuantity) {
+    requote(bids, quotes.bid, bidPrice, bidQuantity);
+    requote(asks, quotes.ask, askPrice, askQuantity);
+    // a single matching pass, only if the update crossed the book
+    auto bid = bids.frontList();
+    auto ask = asks.frontList();
+    if (bid && ask && bid->price() >= ask->price()) {
+        const bool bidCrossed = quotes.bid && quotes.bid->isOnList() && quotes.bid->_price >= ask->price();
+        matchOrders(bidCrossed ? Order::BUY : Order::SELL);
     }
+    publish();
 }
 
-void OrderBook::quote(const QuoteOrders& quotes, F bidPrice, int bidQuantity, F askPrice, int askQuantity) {
-    auto bid = quotes.bid;
-    auto ask = quotes.ask;
-    if(bid->isOnList()) {
-        bids.removeOrder(bid);
+template <typename Levels>
+bool BasicOrderBook<Levels>::pullProtected(Levels& levels, const std::shared_ptr<Order>& order) {
+    if (!order->protection || !listener.pullsQuote(*order)) return false;
+    touch(order->side, order->_price, levels.removeOrder(order));
+    event(OrderEvent::REMOVE, *order, order->_price, order->remaining);
+    return true;
+}
+
+template <typename Levels>
+void BasicOrderBook<Levels>::requote(Levels& levels, const std::shared_ptr<Order>& order, F price, int quantity) {
+    // the quote was created without this side
+    if (!order) return;
+    const bool resting = order->isOnList();
+    if (resting && quantity == order->remaining && price == order->_price) {
+        // unchanged
+        order->_quantity = quantity;
+        order->filled = 0;
+        return;
     }
-    if(ask->isOnList()) {
-        asks.removeOrder(ask);
+    if (resting && quantity > 0 && quantity < order->remaining && price == order->_price) {
+        // size down only, adjusted in place and the quote keeps its priority
+        const int reduction = order->remaining - quantity;
+        order->_quantity = quantity;
+        order->remaining = quantity;
+        order->filled = 0;
+        touch(order->side, price, levels.reduceOrder(order, reduction));
+        event(OrderEvent::REDUCE, *order, price, reduction);
+        return;
+    }
+    if (resting && quantity > 0 && levels.repriceLevel(order, price)) {
+        // alone on its level and the level keeps its position: a new price or more size without erasing or
+        // inserting a level
+        touch(order->side, order->_price, 0);
+        event(OrderEvent::REMOVE, *order, order->_price, order->remaining);
+        const int change = order->remaining - quantity;
+        order->_price = price;
+        order->_quantity = quantity;
+        order->remaining = quantity;
+        order->filled = 0;
+        touch(order->side, price, levels.reduceOrder(order, change), true);
+        event(OrderEvent::ADD, *order, price, quantity);
+        return;
     }
-    if (bidQuantity != 0) {
-        bid->_price = bidPrice;
-        bid->_quantity = bidQuantity;
-        bid->remaining = bidQuantity;
-        bid->filled = 0;
-        bids.insertOrder(bid);
-        matchOrders(Order::BUY);
+    if (resting) {
+        touch(order->side, order->_price, levels.removeOrder(order));
+        event(OrderEvent::REMOVE, *order, order->_price, order->remaining);
     }
-    if (askQuantity != 0) {
-        ask->_price = askPrice;
-        ask->_quantity = askQuantity;
-        ask->remaining = askQuantity;
-        ask->filled = 0;
-        asks.insertOrder(ask);
-        matchOrders(Order::SELL);
+    if (quantity != 0) {
+        order->_price = price;
+        order->_quantity = quantity;
+        order->remaining = quantity;
+        order->filled = 0;
+        const int level = levels.insertOrder(order);
+        touch(order->side, price, level, level == quantity);
+        event(OrderEvent::ADD, *order, price, quantity);
     }
 }
 
-int OrderBook::cancelOrder(std::shared_ptr<Order> order) {
+template <typename Levels>
+int BasicOrderBook<Levels>::cancelOrder(std::shared_ptr<Order> order) {
     // Add null pointer check
     if (!order) {
         return -1;
@@ -122,16 +196,20 @@ int OrderBook::cancelOrder(std::shared_ptr<Order> order) {
     
     // Add bounds checking for remaining quantity
     if (order->remaining > 0) {
-        order->cancel();
         auto orders = order->side == Order::BUY ? &bids : &asks;
         
         // Add safety check before removal
         if (orders && order->isOnList()) {
-            orders->removeOrder(order);
+            // removed before cancel() so the level quantity is reduced by the remaining quantity
+            touch(order->side, order->_price, orders->removeOrder(order));
+            event(OrderEvent::REMOVE, *order, order->_price, order->remaining);
+            order->cancel();
             listener.onOrder(*order);
+            publish();
             return 0;
         } else {
             // Order not found in lists or not on list
+            order->cancel();
             return -1;
         }
     } else {
@@ -139,16 +217,82 @@ int OrderBook::cancelOrder(std::shared_ptr<Order> order) {
     }
 }
 
-const Book OrderBook::book() const {
+template <typename Levels>
+int BasicOrderBook<Levels>::modifyOrder(const std::shared_ptr<Order>& order, F price, int quantity) {
+    if (!order || !order->isOnList() || order->_isQuote || quantity <= 0 || price == DBL_MAX || price == -DBL_MAX) {
+        return -1;
+    }
+    auto& orders = order->side == Order::BUY ? bids : asks;
+    const int remaining = quantity - order->filled;
+    if (remaining <= 0) {
+        // nothing left to rest, the same as a cancel
+        touch(order->side, order->_price, orders.removeOrder(order));
+        event(OrderEvent::REMOVE, *order, order->_price, order->remaining);
+        order->cancel();
+        listener.onOrder(*order);
+        publish();
+        return 0;
+    }
+    if (price == order->_price && remaining <= order->remaining) {
+        // reduced in place, the order keeps its place in the queue
+        const int reduction = order->remaining - remaining;
+        order->_quantity = quantity;
+        if (reduction > 0) {
+            order->remaining = remaining;
+            touch(order->side, price, orders.reduceOrder(order, reduction));
+            event(OrderEvent::REDUCE, *order, price, reduction);
+        }
+        listener.onOrder(*order);
+        publish();
+        return 0;
+    }
+    // loses priority, the same Order and Node move to the back of the new level, if anything is left after matching
+    touch(order->side, order->_price, orders.removeOrder(order));
+    event(OrderEvent::REMOVE, *order, order->_price, order->remaining);
+    order->_price = price;
+    order->_quantity = quantity;
+    order->remaining = remaining;
+    listener.onOrder(*order);
+    match(order);
+    publish();
+    return 0;
+}
+
+template <typename Levels>
+void BasicOrderBook<Levels>::load(std::span<const std::shared_ptr<Order>> bidOrders, std::span<const std::shared_ptr<Order>> askOrders) {
+    if (!bids.empty() || !asks.empty()) throw std::invalid_argument("bulk load into a non-empty book");
+    // validated in full first, so a bad run leaves the book untouched
+    auto validate = [](std::span<const std::shared_ptr<Order>> orders, Order::Side side) {
+        for (size_t i = 0; i < orders.size(); i++) {
+            const auto& order = orders[i];
+            if (!order || order->side != side || order->remaining <= 0 || order->isOnList()) {
+                throw std::invalid_argument("bulk load order is null, on the wrong side, already booked or has nothing remaining");
+            }
+            if (i > 0 && (side == Order::BUY ? order->_price > orders[i - 1]->_price : order->_price < orders[i - 1]->_price)) {
+                throw std::invalid_argument("bulk load orders not in price priority order");
+            }
+        }
+    };
+    validate(bidOrders, Order::BUY);
+    validate(askOrders, Order::SELL);
+    if (!bidOrders.empty() && !askOrders.empty() && !(bidOrders.front()->_price < askOrders.front()->_price)) {
+        throw std::invalid_argument("bulk load would cross the book");
+    }
+
+    for (auto& order : bidOrders) bids.appendOrder(order);
+    for (auto& order : askOrders) asks.appendOrder(order);
+    publishTopOfBook();
+}
+
+template <typename Levels>
+const Book BasicOrderBook<Levels>::book() const {
     Book book;
-    auto snap = [](const PriceLevels& src, std::vector<BookLevel>& dst, std::vector<long>& oids) {
+    auto snap = [](const Levels& src, std::vector<BookLevel>& dst, std::vector<long>& oids) {
         auto fn = [&](const OrderList* orders) {
-            int quantity(0);
             for (auto itr = orders->begin(); itr != orders->end(); ++itr) {
-                quantity = quantity + (*itr)->remainingQuantity();
                 oids.push_back((*itr)->exchangeId);
             }
-            dst.push_back({orders->price(), quantity});
+            dst.push_back({orders->price(), orders->quantity()});
         };
         src.forEach(fn);
     };
@@ -159,9 +303,136 @@ const Book OrderBook::book() const {
     return book;
 }
 
+template <typename Levels>
+DepthSize BasicOrderBook<Levels>::depth(std::span<BookLevel> bidLevels, std::span<BookLevel> askLevels) const {
+    auto copy = [](const Levels& src, std::span<BookLevel> dst) {
+        int n = 0;
+        if (dst.empty()) return n;
+        src.forEachUntil([&](const OrderList* orders) {
+            dst[n++] = {orders->price(), orders->quantity()};
+            return size_t(n) < dst.size();
+        });
+        return n;
+    };
+    return {copy(bids, bidLevels), copy(asks, askLevels)};
+}
+
+template <typename Levels>
+int BasicOrderBook<Levels>::depthByOrder(Order::Side side, std::span<BookOrder> dst) const {
+    int n = 0;
+    if (dst.empty()) return n;
+    (side == Order::BUY ? bids : asks).forEachUntil([&](const OrderList* orders) {
+        for (auto itr = orders->begin(); itr != orders->end(); ++itr) {
+            auto order = *itr;
+            dst[n++] = {order->exchangeId, order->_price, order->remaining};
+            if (size_t(n) == dst.size()) return false;
+        }
+        return true;
+    });
+    return n;
+}
+
+template <typename Levels>
+void BasicOrderBook<Levels>::forEachOrder(Order::Side side, const std::function<void(const Order&)>& fn) const {
+    (side == Order::BUY ? bids : asks).forEachUntil([&](const OrderList* orders) {
+        for (auto itr = orders->begin(); itr != orders->end(); ++itr) {
+            fn(*(*itr));
+        }
+        return true;
+    });
+}
+
+template <typename Levels>
+void BasicOrderBook<Levels>::publishTopOfBook() {
+    TopOfBook current;
+    if (auto level = bids.frontList()) {
+        current.bidPrice = level->price();
+        current.bidQuantity = level->quantity();
+    }
+    if (auto level = asks.frontList()) {
+        current.askPrice = level->price();
+        current.askQuantity = level->quantity();
+    }
+    if (!(current == published)) {
+        published = current;
+        top.store(current);
+    }
+}
+
+template <typename Levels>
+void BasicOrderBook<Levels>::touch(Order::Side side, F price, int quantity, bool created) {
+    if (!deltas) return;
+    // an operation touches few levels, a linear scan is cheaper than any lookup structure
+    for (auto& entry : pending) {
+        if (entry.delta.side == side && entry.delta.price == price) {
+            entry.delta.quantity = quantity;
+            return;
+        }
+    }
+    PendingDelta entry;
+    entry.delta.price = price;
+    entry.delta.quantity = quantity;
+    entry.delta.side = side;
+    entry.created = created;
+    pending.push_back(entry);
+}
+
+template <typename Levels>
+void BasicOrderBook<Levels>::publishDeltas() {
+    for (auto& entry : pending) {
+        // e.g. a marketable order that was fully filled, the level was never visible to consumers
+        if (entry.created && entry.delta.quantity == 0) continue;
+        // the sequence is consumed even if the delta is dropped, so the consumer can detect the gap
+        entry.delta.sequence = ++deltaSequence;
+        if (!deltas->push(entry.delta)) {
+            droppedDeltas.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    pending.clear();
+}
+
+template <typename Levels>
+void BasicOrderBook<Levels>::event(OrderEvent::Type type, const Order& order, F price, int quantity) {
+    if (!events) return;
+    OrderEvent e;
+    e.sequence = ++eventSequence;
+    e.exchangeId = order.exchangeId;
+    e.price = price;
+    e.quantity = quantity;
+    // a REMOVE is recorded before the order is cancelled, nothing rests after it
+    e.remaining = type == OrderEvent::REMOVE ? 0 : order.remaining;
+    e.side = order.side;
+    e.type = type;
+    if (!events->push(e)) {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
 const Order OrderBook::getOrder(std::shared_ptr<Order> order) {
     if (!order) {
         throw std::invalid_argument("Order cannot be null");
     }
     return *order;
 }
+
+std::shared_ptr<OrderBook> OrderBook::create(const std::string& instrument, OrderBookListener& listener, const InstrumentConfig& config) {
+    switch (config.levels) {
+        case PriceLevelsType::DEQUE_PTR:
+            return std::make_shared<BasicOrderBook<DequeuePtrPriceLevels>>(instrument, listener, config);
+        case PriceLevelsType::VECTOR_PTR:
+            return std::make_shared<BasicOrderBook<VectorPtrPriceLevels>>(instrument, listener, config);
+        case PriceLevelsType::VECTOR:
+            return std::make_shared<BasicOrderBook<VectorPriceLevels>>(instrument, listener, config);
+        case PriceLevelsType::STD_MAP:
+            return std::make_shared<BasicOrderBook<StdMapPriceLevels>>(instrument, listener, config);
+        case PriceLevelsType::STD_MAP_PTR:
+            return std::make_shared<BasicOrderBook<StdMapPtrPriceLevels>>(instrument, listener, config);
+    }
+    throw std::invalid_argument("unknown PriceLevelsType");
+}
+
+template class BasicOrderBook<DequeuePtrPriceLevels>;
+template class BasicOrderBook<VectorPtrPriceLevels>;
+template class BasicOrderBook<VectorPriceLevels>;
+template class BasicOrderBook<StdMapPriceLevels>;
+template class BasicOrderBook<StdMapPtrPriceLevels>;
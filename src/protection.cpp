@@ -0,0 +1,63 @@
+#include "core/protection.h"
+
+#include <algorithm>
+
+void SessionProtection::restingQuotes(std::vector<std::shared_ptr<Order>>& out) {
+    std::lock_guard<SpinLock> guard(quotesLock);
+    // a linked order is on its list, which holds it and is only detached after unlinking
+    for (auto quote = quotes; quote; quote = quote->nextProtected) out.push_back(quote->node->order.lock());
+}
+
+void SessionProtection::configure(const ProtectionConfig& config) {
+    std::lock_guard<SpinLock> guard(mu);
+    this->config = config;
+    first = count = 0;
+    quantity = 0;
+    tripped.store(false, std::memory_order_release);
+}
+
+bool SessionProtection::save(ProtectionConfig& config, std::vector<Fill>& fills) {
+    std::lock_guard<SpinLock> guard(mu);
+    config = this->config;
+    fills.clear();
+    for (size_t i = 0; i < count; i++) fills.push_back(this->fills[(first + i) % this->fills.size()]);
+    return tripped.load(std::memory_order_relaxed);
+}
+
+void SessionProtection::restore(const ProtectionConfig& config, std::span<const Fill> fills, bool tripped) {
+    std::lock_guard<SpinLock> guard(mu);
+    this->config = config;
+    this->fills.assign(std::max<size_t>(16, fills.size() + 1), Fill{});
+    std::copy(fills.begin(), fills.end(), this->fills.begin());
+    first = 0;
+    count = fills.size();
+    quantity = 0;
+    for (const auto& fill : fills) quantity += fill.quantity;
+    this->tripped.store(tripped, std::memory_order_release);
+}
+
+bool SessionProtection::onFill(int64_t time, int filled) {
+    std::lock_guard<SpinLock> guard(mu);
+    if (tripped.load(std::memory_order_relaxed) || (!config.quantityLimit && !config.fillLimit)) return false;
+    // expire the fills that left the window
+    while (count && fills[first].time <= time - config.window.count()) {
+        quantity -= fills[first].quantity;
+        first = (first + 1) % fills.size();
+        count--;
+    }
+    if (count == fills.size()) {
+        std::vector<Fill> grown(fills.size() * 2);
+        for (size_t i = 0; i < count; i++) grown[i] = fills[(first + i) % fills.size()];
+        fills.swap(grown);
+        first = 0;
+    }
+    fills[(first + count) % fills.size()] = {time, filled};
+    count++;
+    quantity += filled;
+    if ((config.quantityLimit && quantity >= config.quantityLimit) || (config.fillLimit && count >= size_t(config.fillLimit))) {
+        tripped.store(true, std::memory_order_release);
+        trips.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,331 @@
+#include "core/replay.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+#include "core/spinlock.h"
+
+void TradeDigest::onTrade(const Trade& trade) {
+    mix(std::bit_cast<uint64_t>(double(trade.price)));
+    mix(uint64_t(trade.quantity));
+    mix(uint64_t(trade.aggressor.exchangeId));
+    mix(uint64_t(trade.opposite.exchangeId));
+    trades++;
+}
+
+void ReplayContext::prepare(const JournalRecord& record) {
+    timestamp = record.timestamp;
+    pendingCount = nextPending = 0;
+    for (auto id : {record.exchangeId, record.askExchangeId}) {
+        // CANCEL, MODIFY and PULL name an existing order, they assign no id; PROTECT and CLOSE hold no ids
+        if (record.type == JournalRecord::PROTECT || record.type == JournalRecord::CLOSE) break;
+        if (id && record.type != JournalRecord::CANCEL && record.type != JournalRecord::MODIFY && record.type != JournalRecord::PULL) pendingIds[pendingCount++] = long(id);
+        lastId = std::max(lastId, long(id));
+    }
+}
+
+long ReplayContext::nextId() {
+    if (nextPending < pendingCount) return pendingIds[nextPending++];
+    // the command was journaled without the id, e.g. by an older version
+    return ++lastId;
+}
+
+namespace {
+
+/** applies a journaled command through the public API, @return the operation for the latency report */
+ReplayReport::Operation apply(Exchange& exchange, const JournalRecord& record, std::string_view sessionId, std::string_view instrument, std::string_view clientId) {
+    switch (record.type) {
+        case JournalRecord::BUY:
+            exchange.buy(sessionId, instrument, record.price, record.quantity, clientId);
+            return ReplayReport::ORDER;
+        case JournalRecord::SELL:
+            exchange.sell(sessionId, instrument, record.price, record.quantity, clientId);
+            return ReplayReport::ORDER;
+        case JournalRecord::QUOTE:
+            exchange.quote(sessionId, instrument, record.price, record.quantity, record.askPrice, record.askQuantity, clientId);
+            return ReplayReport::QUOTE;
+        case JournalRecord::CANCEL:
+            exchange.cancel(long(record.exchangeId), sessionId);
+            return ReplayReport::CANCEL;
+        case JournalRecord::MODIFY:
+            exchange.modify(long(record.exchangeId), sessionId, record.price, record.quantity);
+            return ReplayReport::MODIFY;
+        case JournalRecord::PROTECT:
+            exchange.setProtection(sessionId, {std::chrono::nanoseconds(record.askExchangeId), record.quantity, record.askQuantity});
+            return ReplayReport::PROTECT;
+        case JournalRecord::CLOSE:
+            exchange.closeInstrument(instrument);
+            return ReplayReport::CLOSE;
+        case JournalRecord::PULL:
+            // not a command of the public API, a quote pulled by a protection trip
+            exchange.apply({record, sessionId, instrument, clientId});
+            return ReplayReport::PULL;
+    }
+    return ReplayReport::ORDER;
+}
+
+/** the exchange replays for the duration of a run, see Exchange::setReplaying */
+struct Replaying {
+    Exchange& exchange;
+    explicit Replaying(Exchange& exchange) : exchange(exchange) {
+        exchange.setReplaying(true);
+    }
+    ~Replaying() {
+        exchange.setReplaying(false);
+    }
+};
+
+/** one instrument's commands in journal order, with the session and client ids of each stored back to back */
+struct Partition {
+    std::string instrument;
+    std::vector<JournalRecord> records;
+    std::string strings;
+    TradeDigest digest;
+    /** the records and strings applied so far */
+    size_t next = 0;
+    size_t nextString = 0;
+    /** records and barriers of the instrument */
+    size_t commands = 0;
+    /** the last phase the partition has records in, 0 for none, and its task in that phase */
+    size_t phase = 0;
+    size_t task = 0;
+};
+
+/** the next records of a partition, applied by one worker within a phase */
+struct Task {
+    size_t partition = 0;
+    size_t records = 0;
+};
+
+/**
+ * a command that affects more than one instrument (PROTECT, a session's limits) or that must see the instrument's
+ * earlier commands applied regardless of the other partitions (CLOSE), applied alone between two phases
+ */
+struct Barrier {
+    JournalRecord record;
+    size_t partition = 0;
+    std::string sessionId;
+    std::string clientId;
+};
+
+/** the replay state of a ParallelReplay worker thread */
+struct Worker {
+    ReplayContext context;
+    Partition* partition = nullptr;
+};
+thread_local Worker* worker = nullptr;
+
+/** per worker deques of partition indexes: a worker takes from the front of its own, and steals from the back of others */
+class WorkStealingQueues {
+private:
+    struct Queue {
+        SpinLock lock;
+        std::deque<size_t> tasks;
+    };
+    std::vector<Queue> queues;
+public:
+    explicit WorkStealingQueues(size_t workers) : queues(workers) {}
+    void push(size_t worker, size_t task) {
+        queues[worker].tasks.push_back(task);
+    }
+    std::optional<size_t> take(size_t worker) {
+        for (size_t k = 0; k < queues.size(); k++) {
+            auto& queue = queues[(worker + k) % queues.size()];
+            std::lock_guard<SpinLock> guard(queue.lock);
+            if (queue.tasks.empty()) continue;
+            size_t task;
+            if (k == 0) {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            } else {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            return task;
+        }
+        return std::nullopt;
+    }
+};
+
+void mix(uint64_t& hash, uint64_t value) {
+    for (int i = 0; i < 8; i++, value >>= 8) {
+        hash = (hash ^ (value & 0xff)) * 1099511628211ull;
+    }
+}
+
+}
+
+JournalReplay::JournalReplay(const ReplayOptions& options) : options(options) {
+    target = std::make_unique<Exchange>(digest, options.configure);
+    target->setClock([this]() { return std::chrono::nanoseconds(context.timestamp); });
+    target->setIdGenerator([this]() { return context.nextId(); });
+}
+
+ReplayReport JournalReplay::run(const std::string& directory) {
+    using Clock = std::chrono::steady_clock;
+    ReplayReport report;
+    Replaying replaying(*target);
+    const uint64_t tradesBefore = digest.count();
+    const auto start = Clock::now();
+    int64_t first = -1;
+
+    report.commands = Journal::replay(directory, [&](const JournalEntry& entry) {
+        const auto& record = entry.record;
+        context.prepare(record);
+
+        auto scheduled = Clock::now();
+        if (options.originalPacing) {
+            if (first < 0) first = record.timestamp;
+            scheduled = start + std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(int64_t(double(record.timestamp - first) / options.speed)));
+            // sleep while far from the scheduled time, then spin for precision
+            for (auto now = Clock::now(); now < scheduled; now = Clock::now()) {
+                if (scheduled - now > std::chrono::milliseconds(1)) std::this_thread::sleep_for(scheduled - now - std::chrono::microseconds(500));
+            }
+        }
+
+        const auto operation = apply(*target, record, entry.sessionId, entry.instrument, entry.clientId);
+        report.latency[operation].record(Clock::now() - scheduled);
+    });
+
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report.trades = digest.count() - tradesBefore;
+    report.digest = digest.value();
+    return report;
+}
+
+void ParallelReplay::TradeRouter::onTrade(const Trade& trade) {
+    worker->partition->digest.onTrade(trade);
+}
+
+ParallelReplay::ParallelReplay(unsigned threads, const ReplayOptions& options)
+    : options(options), threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {
+    target = std::make_unique<Exchange>(router, options.configure);
+    // outside run(), e.g. commands sent to the replayed state, the system clock and ids after the replayed ones
+    target->setClock([]() {
+        return worker ? std::chrono::nanoseconds(worker->context.timestamp) : std::chrono::duration_cast<std::chrono::nanoseconds>(epoch());
+    });
+    target->setIdGenerator([this]() { return worker ? worker->context.nextId() : ++lastId; });
+}
+
+ReplayReport ParallelReplay::run(const std::string& directory) {
+    using Clock = std::chrono::steady_clock;
+    ReplayReport report;
+    Replaying replaying(*target);
+    const auto start = Clock::now();
+
+    // partition by instrument, copying out of the mapping which is released segment by segment; every barrier
+    // ends a phase, the records of a partition are applied phase by phase
+    std::vector<Partition> partitions;
+    std::unordered_map<std::string, size_t> index;
+    std::vector<std::vector<Task>> phases(1);
+    std::vector<Barrier> barriers;
+    report.commands = Journal::replay(directory, [&](const JournalEntry& entry) {
+        auto [it, inserted] = index.try_emplace(std::string(entry.instrument), partitions.size());
+        if (inserted) partitions.emplace_back().instrument = entry.instrument;
+        auto& partition = partitions[it->second];
+        partition.commands++;
+        if (entry.record.type == JournalRecord::PROTECT || entry.record.type == JournalRecord::CLOSE) {
+            barriers.push_back({entry.record, it->second, std::string(entry.sessionId), std::string(entry.clientId)});
+            phases.emplace_back();
+            return;
+        }
+        auto& tasks = phases.back();
+        if (partition.phase != phases.size()) {
+            partition.phase = phases.size();
+            partition.task = tasks.size();
+            tasks.push_back({it->second, 0});
+        }
+        tasks[partition.task].records++;
+        partition.records.push_back(entry.record);
+        partition.strings.append(entry.sessionId).append(entry.clientId);
+    });
+
+    std::vector<std::array<LatencyHistogram, ReplayReport::N_OPERATIONS>> latency(std::max<size_t>(1, threads));
+    std::exception_ptr failure;
+    std::mutex failureLock;
+    // the ids assigned outside run() continue after the highest one replayed
+    auto replayed = [this](const Worker& state) {
+        long seen = lastId.load();
+        while (seen < state.context.lastId && !lastId.compare_exchange_weak(seen, state.context.lastId)) {}
+    };
+
+    auto runPhase = [&](std::vector<Task>& tasks) {
+        // seed the largest tasks first, dealt round robin, so workers start balanced and steal the small ones
+        std::stable_sort(tasks.begin(), tasks.end(), [](const Task& a, const Task& b) { return a.records > b.records; });
+        const size_t workers = std::min<size_t>(threads, tasks.size());
+        WorkStealingQueues queues(workers);
+        for (size_t i = 0; i < tasks.size(); i++) queues.push(i % workers, i);
+
+        auto work = [&](size_t id) {
+            Worker state;
+            worker = &state;
+            try {
+                while (auto task = queues.take(id)) {
+                    auto& partition = partitions[tasks[*task].partition];
+                    state.partition = &partition;
+                    std::string_view strings = std::string_view(partition.strings).substr(partition.nextString);
+                    for (size_t n = 0; n < tasks[*task].records; n++) {
+                        const auto& record = partition.records[partition.next++];
+                        const auto sessionId = strings.substr(0, record.sessionLength);
+                        const auto clientId = strings.substr(record.sessionLength, record.clientIdLength);
+                        strings.remove_prefix(size_t(record.sessionLength) + record.clientIdLength);
+                        partition.nextString += size_t(record.sessionLength) + record.clientIdLength;
+                        state.context.prepare(record);
+                        const auto begin = Clock::now();
+                        const auto operation = apply(*target, record, sessionId, partition.instrument, clientId);
+                        latency[id][operation].record(Clock::now() - begin);
+                    }
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(failureLock);
+                if (!failure) failure = std::current_exception();
+            }
+            replayed(state);
+            worker = nullptr;
+        };
+        std::vector<std::thread> pool;
+        for (size_t id = 1; id < workers; id++) pool.emplace_back(work, id);
+        work(0);
+        for (auto& thread : pool) thread.join();
+        if (failure) std::rethrow_exception(failure);
+    };
+
+    for (size_t phase = 0; phase < phases.size(); phase++) {
+        if (!phases[phase].empty()) runPhase(phases[phase]);
+        if (phase == barriers.size()) break;
+        // every partition has applied its commands journaled before the barrier, nothing runs concurrently with it
+        const auto& barrier = barriers[phase];
+        Worker state;
+        state.partition = &partitions[barrier.partition];
+        worker = &state;
+        state.context.prepare(barrier.record);
+        const auto begin = Clock::now();
+        const auto operation = apply(*target, barrier.record, barrier.sessionId, state.partition->instrument, barrier.clientId);
+        latency[0][operation].record(Clock::now() - begin);
+        replayed(state);
+        worker = nullptr;
+    }
+
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (const auto& histograms : latency) {
+        for (size_t op = 0; op < histograms.size(); op++) report.latency[op].merge(histograms[op]);
+    }
+    std::sort(partitions.begin(), partitions.end(), [](const Partition& a, const Partition& b) { return a.instrument < b.instrument; });
+    uint64_t digest = 14695981039346656037ull;
+    for (const auto& partition : partitions) {
+        report.instruments.push_back({partition.instrument, partition.commands, partition.digest.count(), partition.digest.value()});
+        report.trades += partition.digest.count();
+        mix(digest, partition.instrument.size());
+        for (char c : partition.instrument) mix(digest, uint64_t(uint8_t(c)));
+        mix(digest, partition.digest.value());
+    }
+    report.digest = digest;
+    return report;
+}
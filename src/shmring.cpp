@@ -0,0 +1,111 @@
+#include "core/shmring.h"
+
+#include <atomic>
+#include <bit>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static std::runtime_error shmError(const std::string& what, const std::string& name) {
+    return std::runtime_error(what + " failed for shared memory " + name + ": " + std::strerror(errno));
+}
+
+ShmRingWriter::ShmRingWriter(const std::string& name, size_t capacity) : name(name) {
+    const size_t n = std::bit_ceil(capacity < 2 ? size_t(2) : capacity);
+    bytes = sizeof(ShmRingHeader) + n * sizeof(ShmSlot);
+
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_EXCL, 0644);
+    if (fd < 0) throw shmError("shm_open", name);
+    if (ftruncate(fd, off_t(bytes)) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw shmError("ftruncate", name);
+    }
+    base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw shmError("mmap", name);
+    }
+
+    slots = reinterpret_cast<ShmSlot*>(static_cast<char*>(base) + sizeof(ShmRingHeader));
+    for (size_t i = 0; i < n; i++) new (&slots[i]) ShmSlot();
+    mask = n - 1;
+    header = new (base) ShmRingHeader();
+    header->version = ShmRingHeader::VERSION;
+    header->slotSize = uint32_t(sizeof(ShmSlot));
+    header->capacity = n;
+    // stored last with release, a reader that acquires the magic sees the rest of the header
+    std::atomic_ref<uint64_t>(header->magic).store(ShmRingHeader::MAGIC, std::memory_order_release);
+}
+
+ShmRingWriter::~ShmRingWriter() {
+    munmap(base, bytes);
+    shm_unlink(name.c_str());
+}
+
+void ShmRingWriter::write(const MarketDataRecord& record) {
+    auto& slot = slots[next & mask];
+    slot.seq.store(2 * next + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.record = record;
+    slot.seq.store(2 * next + 2, std::memory_order_release);
+    header->head.store(++next, std::memory_order_release);
+}
+
+ShmRingReader::ShmRingReader(const std::string& name, bool fromOldest) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) throw shmError("shm_open", name);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(ShmRingHeader)) {
+        close(fd);
+        throw std::runtime_error("shared memory " + name + " is not a market data ring");
+    }
+    bytes = size_t(st.st_size);
+    base = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) throw shmError("mmap", name);
+
+    header = static_cast<const ShmRingHeader*>(base);
+    // the mapping is read-only, an atomic load does not write
+    const auto magic = std::atomic_ref<uint64_t>(const_cast<uint64_t&>(header->magic)).load(std::memory_order_acquire);
+    if (magic != ShmRingHeader::MAGIC || header->version != ShmRingHeader::VERSION || header->slotSize != sizeof(ShmSlot)
+        || !std::has_single_bit(header->capacity)
+        || header->capacity > (bytes - sizeof(ShmRingHeader)) / sizeof(ShmSlot)) {
+        munmap(base, bytes);
+        throw std::runtime_error("shared memory " + name + " is not a compatible market data ring");
+    }
+    slots = reinterpret_cast<const ShmSlot*>(static_cast<const char*>(base) + sizeof(ShmRingHeader));
+    mask = header->capacity - 1;
+    next = header->head.load(std::memory_order_acquire);
+    if (fromOldest) next = next > header->capacity ? next - header->capacity : 0;
+}
+
+ShmRingReader::~ShmRingReader() {
+    munmap(base, bytes);
+}
+
+ShmRingReader::Status ShmRingReader::read(MarketDataRecord& record) {
+    const auto& slot = slots[next & mask];
+    const auto expected = 2 * next + 2;
+    const auto s0 = slot.seq.load(std::memory_order_acquire);
+    if (s0 < expected) return EMPTY;
+    if (s0 == expected) {
+        record = slot.record;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == expected) {
+            next++;
+            return OK;
+        }
+    }
+    // overwritten before or while it was copied, continue with the next record to be published
+    const auto head = header->head.load(std::memory_order_acquire);
+    _lost += head - next;
+    next = head;
+    return LAPPED;
+}
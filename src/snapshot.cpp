@@ -0,0 +1,409 @@
+#include "core/exchange.h"
+#include "core/snapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+static std::runtime_error snapshotError(const std::string& what, const std::string& path) {
+    return std::runtime_error(what + " for snapshot " + path);
+}
+
+namespace {
+
+/** buffered sequential writer, records are padded to a multiple of 8 */
+class SnapshotWriter {
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+    std::ofstream out;
+    std::unique_ptr<char[]> buffer = std::make_unique<char[]>(BUFFER_SIZE);
+    size_t buffered = 0;
+    uint64_t written = 0;
+public:
+    explicit SnapshotWriter(const std::string& path) : out(path, std::ios::binary | std::ios::trunc) {}
+    bool good() const {
+        return out.good();
+    }
+    void put(const void* data, size_t size) {
+        if (buffered + size > BUFFER_SIZE) flush();
+        if (size > BUFFER_SIZE) {
+            out.write(static_cast<const char*>(data), std::streamsize(size));
+        } else {
+            std::memcpy(buffer.get() + buffered, data, size);
+            buffered += size;
+        }
+        written += size;
+    }
+    void put(std::string_view s) {
+        put(s.data(), s.size());
+    }
+    void pad() {
+        static const char zeros[8] = {};
+        put(zeros, align8(written) - written);
+    }
+    uint64_t size() const {
+        return written;
+    }
+    void flush() {
+        out.write(buffer.get(), std::streamsize(buffered));
+        buffered = 0;
+    }
+    /** rewrites the header once the totals are known */
+    void close(const SnapshotHeader& header) {
+        flush();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof header);
+        out.close();
+    }
+};
+
+/** the whole snapshot file, memory mapped where available */
+class SnapshotFile {
+    const char* base = nullptr;
+    size_t length = 0;
+    std::vector<char> copy;
+public:
+    explicit SnapshotFile(const std::string& path) {
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw snapshotError(std::string("open failed: ") + std::strerror(errno), path);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw snapshotError(std::string("fstat failed: ") + std::strerror(errno), path);
+        }
+        length = size_t(st.st_size);
+        if (length > 0) {
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw snapshotError(std::string("mmap failed: ") + std::strerror(errno), path);
+            }
+#ifdef MADV_SEQUENTIAL
+            madvise(mapped, length, MADV_SEQUENTIAL);
+#endif
+            base = static_cast<const char*>(mapped);
+        }
+        close(fd);
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) throw snapshotError("open failed", path);
+        copy.resize(size_t(in.tellg()));
+        in.seekg(0);
+        in.read(copy.data(), std::streamsize(copy.size()));
+        base = copy.data();
+        length = copy.size();
+#endif
+    }
+    ~SnapshotFile() {
+#ifndef _WIN32
+        if (base) munmap(const_cast<char*>(base), length);
+#endif
+    }
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator=(const SnapshotFile&) = delete;
+    const char* data() const {
+        return base;
+    }
+    size_t size() const {
+        return length;
+    }
+};
+
+/** bounds checked cursor over a SnapshotFile */
+class SnapshotReader {
+    const char* data;
+    size_t size;
+    size_t offset = 0;
+    const std::string& path;
+public:
+    SnapshotReader(const SnapshotFile& file, const std::string& path) : data(file.data()), size(file.size()), path(path) {}
+    /** a reader of the bytes [begin, end) of file */
+    SnapshotReader(const SnapshotFile& file, size_t begin, size_t end, const std::string& path) : data(file.data()), size(end), offset(begin), path(path) {}
+    size_t position() const {
+        return offset;
+    }
+    template <typename T>
+    const T& record() {
+        if (offset + sizeof(T) > size) throw snapshotError("truncated file", path);
+        return *reinterpret_cast<const T*>(data + offset);
+    }
+    /** the string_views of a record's trailing strings */
+    std::string_view string(size_t at, size_t length) const {
+        if (offset + at + length > size) throw snapshotError("truncated file", path);
+        return std::string_view(data + offset + at, length);
+    }
+    /** moves past the current record of size bytes */
+    void skip(size_t bytes) {
+        if (bytes == 0 || offset + bytes > size) throw snapshotError("corrupt record", path);
+        offset += bytes;
+    }
+};
+
+} // namespace
+
+void Exchange::saveSnapshot(const std::string& path) {
+    const std::string temporary = path + ".tmp";
+    SnapshotWriter out(temporary);
+    if (!out.good()) throw snapshotError("create failed", temporary);
+
+    SnapshotHeader header;
+    header.lastId = lastId.load();
+    if (journal) {
+        const auto position = journal->position();
+        header.journalSegment = position.segment;
+        header.journalOffset = position.offset;
+    }
+    out.put(&header, sizeof header);
+
+    // orders no longer resting are written with the book of their instrument
+    std::unordered_map<std::string_view, std::vector<std::shared_ptr<const Order>>> inactive;
+    for (auto& order : allOrders.all()) {
+        if (!order->isOnList()) inactive[order->instrument].push_back(order);
+    }
+
+    auto orderSize = [](const Order& order) {
+        return align8(sizeof(SnapshotOrder) + std::min<size_t>(order._sessionId.size(), UINT16_MAX) + std::min<size_t>(order._orderId.size(), UINT16_MAX));
+    };
+    auto quoteSize = [](std::string_view sessionId, std::string_view quoteId) {
+        return align8(sizeof(SnapshotQuote) + std::min<size_t>(sessionId.size(), UINT16_MAX) + std::min<size_t>(quoteId.size(), UINT16_MAX));
+    };
+
+    auto writeOrder = [&](const Order& order) {
+        SnapshotOrder record;
+        record.sessionLength = uint16_t(std::min<size_t>(order._sessionId.size(), UINT16_MAX));
+        record.orderIdLength = uint16_t(std::min<size_t>(order._orderId.size(), UINT16_MAX));
+        record.size = uint32_t(orderSize(order));
+        record.side = uint8_t(order.side);
+        record.isQuote = order._isQuote;
+        record.quantity = order._quantity;
+        record.remaining = order.remaining;
+        record.filled = order.filled;
+        record.cumQty = order._cumQty;
+        record.exchangeId = order.exchangeId;
+        record.price = order._price;
+        record.avgPrice = order._avgPrice;
+        out.put(&record, sizeof record);
+        out.put(std::string_view(order._sessionId).substr(0, record.sessionLength));
+        out.put(std::string_view(order._orderId).substr(0, record.orderIdLength));
+        out.pad();
+        header.orderCount++;
+    };
+
+    for (auto& instrument : books.instruments()) {
+        auto book = books.get(instrument);
+        // closed since it was listed
+        if (!book) continue;
+        auto bookGuard = book->lock();
+        // the orders cannot go away while the book is locked
+        std::vector<const Order*> orders;
+        book->forEachOrder(Order::BUY, [&](const Order& order) { orders.push_back(&order); });
+        const size_t bidCount = orders.size();
+        book->forEachOrder(Order::SELL, [&](const Order& order) { orders.push_back(&order); });
+        auto& others = inactive[book->instrument];
+
+        SnapshotBook record;
+        record.instrumentLength = uint32_t(instrument.size());
+        record.bidCount = bidCount;
+        record.askCount = orders.size() - bidCount;
+        record.inactiveCount = others.size();
+        record.size = align8(sizeof record + instrument.size());
+        for (auto order : orders) record.size += orderSize(*order);
+        for (auto& order : others) record.size += orderSize(*order);
+        book->forEachQuote([&](std::string_view sessionId, std::string_view quoteId, const QuoteOrders&) {
+            record.quoteCount++;
+            record.size += quoteSize(sessionId, quoteId);
+        });
+        out.put(&record, sizeof record);
+        out.put(instrument);
+        out.pad();
+
+        for (auto order : orders) writeOrder(*order);
+        for (auto& order : others) writeOrder(*order);
+
+        book->forEachQuote([&](std::string_view sessionId, std::string_view quoteId, const QuoteOrders& orders) {
+            SnapshotQuote quote;
+            quote.sessionLength = uint16_t(std::min<size_t>(sessionId.size(), UINT16_MAX));
+            quote.quoteIdLength = uint16_t(std::min<size_t>(quoteId.size(), UINT16_MAX));
+            quote.size = uint32_t(quoteSize(sessionId, quoteId));
+            quote.bidId = orders.bid ? orders.bid->exchangeId : 0;
+            quote.askId = orders.ask ? orders.ask->exchangeId : 0;
+            out.put(&quote, sizeof quote);
+            out.put(sessionId.substr(0, quote.sessionLength));
+            out.put(quoteId.substr(0, quote.quoteIdLength));
+            out.pad();
+        });
+        header.bookCount++;
+    }
+
+    {
+        Guard guard(protectionsLock);
+        std::vector<SessionProtection::Fill> fills;
+        for (auto& [sessionId, protection] : protections) {
+            SnapshotProtection record;
+            ProtectionConfig config;
+            record.tripped = protection->save(config, fills);
+            record.sessionLength = uint16_t(std::min<size_t>(sessionId.size(), UINT16_MAX));
+            record.quantityLimit = config.quantityLimit;
+            record.fillLimit = config.fillLimit;
+            record.window = config.window.count();
+            record.fillCount = fills.size();
+            record.size = uint32_t(align8(sizeof record + record.sessionLength) + fills.size() * sizeof(SnapshotFill));
+            out.put(&record, sizeof record);
+            out.put(std::string_view(sessionId).substr(0, record.sessionLength));
+            out.pad();
+            for (const auto& fill : fills) {
+                SnapshotFill saved;
+                saved.time = fill.time;
+                saved.quantity = fill.quantity;
+                out.put(&saved, sizeof saved);
+            }
+            header.protectionCount++;
+        }
+    }
+
+    header.size = out.size();
+    out.close(header);
+    if (!out.good()) throw snapshotError("write failed", temporary);
+    std::filesystem::rename(temporary, path);
+}
+
+size_t Exchange::loadSnapshot(const std::string& path) {
+    const SnapshotFile file(path);
+    SnapshotReader in(file, path);
+
+    const auto header = in.record<SnapshotHeader>();
+    if (header.magic != SnapshotHeader::MAGIC) throw snapshotError("not a snapshot", path);
+    if (header.version != SnapshotHeader::VERSION) throw snapshotError("unsupported version " + std::to_string(header.version), path);
+    if (header.size != file.size()) throw snapshotError("truncated file", path);
+    in.skip(sizeof header);
+    if (header.journalSegment >= 0) recoverFrom = {header.journalSegment, size_t(header.journalOffset)};
+
+    // books are independent, locate them all and rebuild them in parallel
+    std::vector<size_t> offsets;
+    offsets.reserve(header.bookCount + 1);
+    for (uint32_t b = 0; b < header.bookCount; b++) {
+        offsets.push_back(in.position());
+        in.skip(in.record<SnapshotBook>().size);
+    }
+    offsets.push_back(in.position());
+
+    auto loadBook = [&](size_t b, std::vector<std::shared_ptr<Order>>& resting) {
+        SnapshotReader in(file, offsets[b], offsets[b + 1], path);
+        const auto record = in.record<SnapshotBook>();
+        const auto instrument = in.string(sizeof record, record.instrumentLength);
+        in.skip(align8(sizeof record + record.instrumentLength));
+
+        auto book = books.getOrCreate(instrument, *this, bookConfigure);
+        auto bookGuard = book->lock();
+
+        auto readOrder = [&]() {
+            const auto& order = in.record<SnapshotOrder>();
+            auto restored = Order::create(
+                std::string(in.string(sizeof order, order.sessionLength)),
+                std::string(in.string(sizeof order + order.sessionLength, order.orderIdLength)),
+                book->instrument,
+                order.price,
+                order.quantity,
+                order.side == Order::BUY ? Order::BUY : Order::SELL,
+                long(order.exchangeId)
+            );
+            restored->remaining = order.remaining;
+            restored->filled = order.filled;
+            restored->_cumQty = order.cumQty;
+            restored->_avgPrice = order.avgPrice;
+            restored->_isQuote = order.isQuote;
+            in.skip(order.size);
+            allOrders.add(restored);
+            return restored;
+        };
+
+        resting.clear();
+        resting.reserve(record.bidCount + record.askCount);
+        for (uint64_t i = 0; i < record.bidCount + record.askCount; i++) resting.push_back(readOrder());
+        try {
+            book->load(std::span(resting).first(record.bidCount), std::span(resting).subspan(record.bidCount));
+        } catch (const std::invalid_argument& e) {
+            throw snapshotError(std::string("invalid book ") + book->instrument + ": " + e.what(), path);
+        }
+        for (uint64_t i = 0; i < record.inactiveCount; i++) readOrder();
+
+        for (uint32_t q = 0; q < record.quoteCount; q++) {
+            const auto& quote = in.record<SnapshotQuote>();
+            const auto sessionId = in.string(sizeof quote, quote.sessionLength);
+            const auto quoteId = in.string(sizeof quote + quote.sessionLength, quote.quoteIdLength);
+            const QuoteOrders orders{quote.bidId ? allOrders.get(long(quote.bidId)) : nullptr, quote.askId ? allOrders.get(long(quote.askId)) : nullptr};
+            in.skip(quote.size);
+            book->getQuotes(sessionId, quoteId, [&]() {
+                // the session's limits and window are restored after the books
+                auto& protection = sessionProtection(sessionId);
+                if (orders.bid) protection.add(*orders.bid);
+                if (orders.ask) protection.add(*orders.ask);
+                return orders;
+            });
+        }
+    };
+
+    // the order map and book map take concurrent inserts, each book is locked by the thread rebuilding it
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&]() {
+        std::vector<std::shared_ptr<Order>> resting;
+        for (size_t b; (b = next.fetch_add(1)) < header.bookCount;) {
+            try {
+                loadBook(b, resting);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(errorMutex);
+                if (!error) error = std::current_exception();
+            }
+        }
+    };
+    const size_t threads = std::min<size_t>(header.bookCount, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++) workers.emplace_back(worker);
+    worker();
+    for (auto& thread : workers) thread.join();
+    if (error) std::rethrow_exception(error);
+
+    // the sessions' limits, windows and trips as of the journal position, which recover() continues from
+    SnapshotReader protections(file, offsets.back(), file.size(), path);
+    std::vector<SessionProtection::Fill> fills;
+    for (uint32_t p = 0; p < header.protectionCount; p++) {
+        const auto record = protections.record<SnapshotProtection>();
+        const auto sessionId = protections.string(sizeof record, record.sessionLength);
+        const size_t fillsAt = align8(sizeof record + record.sessionLength);
+        if (record.size != fillsAt + record.fillCount * sizeof(SnapshotFill)) throw snapshotError("corrupt record", path);
+        protections.skip(fillsAt);
+        fills.clear();
+        for (uint64_t f = 0; f < record.fillCount; f++) {
+            const auto& fill = protections.record<SnapshotFill>();
+            fills.push_back({fill.time, fill.quantity});
+            protections.skip(sizeof fill);
+        }
+        sessionProtection(sessionId).restore({std::chrono::nanoseconds(record.window), record.quantityLimit, record.fillLimit}, fills, record.tripped);
+    }
+
+    lastId = header.lastId;
+    return header.orderCount;
+}
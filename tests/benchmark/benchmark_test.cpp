@@ -21,7 +21,7 @@ struct TestListener : OrderBookListener {
 void insertOrders(const bool withTrades,const int PRICE_LEVELS) {
 
     TestListener listener;
-    OrderBook ob(dummy_instrument,listener);
+    BasicOrderBook<> ob(std::string(dummy_instrument), listener);
 
     static const int N_ORDERS = 5000000;
     static const int TOTAL_ORDERS = N_ORDERS * 2;
@@ -45,7 +45,7 @@ void insertOrders(const bool withTrades,const int PRICE_LEVELS) {
 /** tests the time to remove an order at a random position in the OrderBook */
 void cancelOrders(const int PRICE_LEVELS) {
     OrderBookListener listener;
-    OrderBook ob(dummy_instrument,listener);
+    BasicOrderBook<> ob(std::string(dummy_instrument), listener);
 
     static const int N_ORDERS = 1000000;
 
@@ -55,10 +55,11 @@ void cancelOrders(const int PRICE_LEVELS) {
     orders.reserve(N_ORDERS);
 
     for(int i=0;i<N_ORDERS;i++) {
-        auto order = TestOrder::create(i,100.0 + 1 * (i%PRICE_LEVELS),10,Order::BUY);
-        ob.insertOrder(order);
-        orders.push_back(order);
+        orders.push_back(TestOrder::create(i,100.0 + 1 * (i%PRICE_LEVELS),10,Order::BUY));
     }
+    // build the book in one pass, bids best price first and in time order within a level
+    std::stable_sort(orders.begin(),orders.end(),[](const auto& a,const auto& b) { return a->price() > b->price(); });
+    ob.load(orders,{});
 
     std::random_device rd;
     std::mt19937 g(rd());
@@ -0,0 +1,67 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/exchange.h"
+
+/**
+ * Instrument registration and book lookup for an options venue sized instrument universe: registration, the first
+ * order of each series (which creates its book), lookup by name (hashing the string) against by InstrumentId
+ * (indexing), and order submission by name against by id.
+ *
+ * usage: bookmap_benchmark_test [instruments, default 300000] [lookups, default 2000000]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double nanos(Clock::time_point start) {
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::stoi(argv[1]) : 300000;
+    const long lookups = argc > 2 ? std::stol(argv[2]) : 2000000;
+    std::cout << std::fixed << std::setprecision(1);
+
+    std::vector<std::string> names;
+    for (int i = 0; i < n; i++) names.push_back("OPT.XYZ.20261218." + std::to_string(1000 + i) + (i % 2 ? "C" : "P"));
+    auto exchange = std::make_unique<Exchange>();
+    std::vector<InstrumentId> ids;
+    auto start = Clock::now();
+    for (const auto& name : names) ids.push_back(exchange->registerInstrument(name));
+    std::cout << "BM_Register/instruments:" << n << ": " << nanos(start) / n << " ns/instrument\n";
+    // books are created by the first order of each series
+    start = Clock::now();
+    for (const auto id : ids) exchange->buy("s", id, 1, 1);
+    std::cout << "BM_FirstOrder/instruments:" << n << ": " << nanos(start) / n << " ns/instrument\n";
+
+    // the same random sequence for both lookups
+    std::mt19937 rng(3);
+    std::vector<uint32_t> sequence(static_cast<size_t>(lookups));
+    for (auto& i : sequence) i = uint32_t(rng() % uint32_t(n));
+    size_t found = 0;
+    start = Clock::now();
+    for (auto i : sequence) found += exchange->orderBook(names[i]) != nullptr;
+    std::cout << "BM_GetByName/instruments:" << n << ": " << nanos(start) / double(lookups) << " ns/lookup\n";
+    start = Clock::now();
+    for (auto i : sequence) found += exchange->orderBook(ids[i]) != nullptr;
+    std::cout << "BM_GetById/instruments:" << n << ": " << nanos(start) / double(lookups) << " ns/lookup\n";
+    if (found != 2 * size_t(lookups)) {
+        std::cout << "lookup failed\n";
+        return 1;
+    }
+
+    // resting orders far from each other, nothing trades
+    const long orders = std::min<long>(lookups, 500000);
+    start = Clock::now();
+    for (long k = 0; k < orders; k++) exchange->buy("s", names[sequence[size_t(k)]], 1 + double(k % 100), 1);
+    std::cout << "BM_BuyByName/instruments:" << n << ": " << nanos(start) / double(orders) << " ns/order\n";
+    start = Clock::now();
+    for (long k = 0; k < orders; k++) exchange->buy("s", ids[sequence[size_t(k)]], 1 + double(k % 100), 1);
+    std::cout << "BM_BuyById/instruments:" << n << ": " << nanos(start) / double(orders) << " ns/order\n";
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/bookmap.h"
+#include "core/exchange.h"
+
+/**
+ * BookMap::getOrCreate for existing instruments whose names all collide, the submission path of an order by name:
+ * every name hashes to the same slot modulo 4096, so each lookup walks a probe chain as long as the number of
+ * instruments registered before it. Reports the time per lookup and the number of books constructed per lookup,
+ * counted through the configure hook, which must be 0 once every instrument exists; then the same through
+ * Exchange::buy.
+ *
+ * usage: bookmap_collision_benchmark_test [instruments, default 1000] [lookups, default 200000]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double nanos(Clock::time_point start) {
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? std::stoi(argv[1]) : 1000;
+    const long lookups = argc > 2 ? std::stol(argv[2]) : 200000;
+    std::cout << std::fixed << std::setprecision(1);
+
+    std::vector<std::string> names;
+    const auto target = std::hash<std::string_view>{}("OPT.COLLIDE") % 4096;
+    for (long k = 0; int(names.size()) < n; k++) {
+        auto name = "OPT.COLLIDE." + std::to_string(k);
+        if (std::hash<std::string_view>{}(name) % 4096 == target) names.push_back(std::move(name));
+    }
+
+    std::mt19937 rng(5);
+    std::vector<uint32_t> sequence(static_cast<size_t>(lookups));
+    for (auto& i : sequence) i = uint32_t(rng() % uint32_t(n));
+
+    OrderBookListener listener;
+    long built = 0;
+    InstrumentConfigHook configure = [&](std::string_view) {
+        built++;
+        return InstrumentConfig{};
+    };
+    auto books = std::make_unique<BookMap>();
+    for (const auto& name : names) books->getOrCreate(name, listener, configure);
+    if (built != n) {
+        std::cout << "expected " << n << " books, built " << built << "\n";
+        return 1;
+    }
+
+    built = 0;
+    size_t found = 0;
+    auto start = Clock::now();
+    for (auto i : sequence) found += books->getOrCreate(names[i], listener, configure)->instrument.size();
+    std::cout << "BM_GetOrCreateColliding/instruments:" << n << ": " << nanos(start) / double(lookups) << " ns/lookup, "
+              << std::setprecision(3) << double(built) / double(lookups) << " books built/lookup\n" << std::setprecision(1);
+    if (!found) return 1;
+
+    // resting orders far from each other, nothing trades
+    auto exchange = std::make_unique<Exchange>();
+    for (const auto& name : names) exchange->buy("s", name, 1, 1);
+    start = Clock::now();
+    for (long k = 0; k < lookups; k++) exchange->buy("s", names[sequence[size_t(k)]], 1 + double(k % 100), 1);
+    std::cout << "BM_BuyColliding/instruments:" << n << ": " << nanos(start) / double(lookups) << " ns/order\n";
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/bookreplica.h"
+#include "core/order.h"
+#include "core/orderbook.h"
+
+/**
+ * BookReplica apply throughput. The update streams are produced by running random orders and cancels through
+ * real books with both feeds enabled, then timed when applied to replicas:
+ *
+ *   single  - one replica applying the whole stream, the replica stays in cache
+ *   fan-out - many replicas (one per instrument, streams interleaved update by update), as a strategy process
+ *             following thousands of books sees them
+ *
+ * usage: bookreplica_benchmark_test [updates, default 1000000] [replicas, default 2000]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static const std::string session("session");
+
+struct Streams {
+    std::vector<std::vector<LevelDelta>> deltas;
+    std::vector<std::vector<OrderEvent>> events;
+    size_t totalDeltas = 0;
+    size_t totalEvents = 0;
+};
+
+/** roughly `updates` level deltas spread over `books` independent books */
+static Streams generate(long updates, int books) {
+    Streams streams;
+    streams.deltas.resize(size_t(books));
+    streams.events.resize(size_t(books));
+    OrderBookListener listener;
+    InstrumentConfig config;
+    config.levelDeltaCapacity = 1 << 12;
+    config.orderEventCapacity = 1 << 12;
+    std::mt19937 rng(42);
+    std::normal_distribution<double> ticks(0.0, 10.0);
+    const long perBook = std::max(1L, updates / books);
+
+    for (int b = 0; b < books; b++) {
+        static const std::string instrument("SYM");
+        auto book = OrderBook::create(instrument, listener, config);
+        std::vector<std::shared_ptr<Order>> live;
+        long id = 0;
+        auto& deltas = streams.deltas[size_t(b)];
+        auto& events = streams.events[size_t(b)];
+        while (long(deltas.size()) < perBook) {
+            if (live.size() > 200 || (!live.empty() && rng() % 3 == 0)) {
+                auto index = rng() % live.size();
+                book->cancelOrder(live[index]);
+                live[index] = live.back();
+                live.pop_back();
+            } else {
+                auto side = rng() % 2 ? Order::BUY : Order::SELL;
+                double price = 1000 + std::round(ticks(rng)) + (side == Order::BUY ? -3 : 3);
+                live.push_back(Order::create(session, "", instrument, F(price), int(1 + rng() % 100), side, ++id));
+                book->insertOrder(live.back());
+            }
+            book->levelDeltas()->drain([&](const LevelDelta& delta) { deltas.push_back(delta); });
+            book->orderEvents()->drain([&](const OrderEvent& event) { events.push_back(event); });
+        }
+        streams.totalDeltas += deltas.size();
+        streams.totalEvents += events.size();
+    }
+    return streams;
+}
+
+template <typename Update>
+static double applySingle(const std::vector<Update>& stream) {
+    BookReplica replica;
+    auto start = Clock::now();
+    for (auto& update : stream) replica.apply(update);
+    auto elapsed = Clock::now() - start;
+    if (!replica.inSync()) std::cerr << "replica out of sync\n";
+    return std::chrono::duration<double, std::nano>(elapsed).count() / double(stream.size());
+}
+
+template <typename Update>
+static double applyFanOut(const std::vector<std::vector<Update>>& streams, size_t total) {
+    std::vector<BookReplica> replicas(streams.size());
+    size_t longest = 0;
+    for (auto& stream : streams) longest = std::max(longest, stream.size());
+    auto start = Clock::now();
+    for (size_t i = 0; i < longest; i++) {
+        for (size_t r = 0; r < streams.size(); r++) {
+            if (i < streams[r].size()) replicas[r].apply(streams[r][i]);
+        }
+    }
+    auto elapsed = Clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / double(total);
+}
+
+static void print(const std::string& name, double nanosPerUpdate) {
+    // ns per update is also ms per million updates
+    std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1) << std::setw(10)
+              << nanosPerUpdate << " ms/million updates" << std::setw(10) << 1000.0 / nanosPerUpdate << " M updates/sec\n";
+}
+
+int main(int argc, char** argv) {
+    const long updates = argc > 1 ? std::stol(argv[1]) : 1000000;
+    const int replicas = argc > 2 ? std::stoi(argv[2]) : 2000;
+
+    auto single = generate(updates, 1);
+    std::cout << "single book: " << single.totalDeltas << " level deltas, " << single.totalEvents << " order events\n";
+    print("BM_ApplyLevelDeltas/replicas:1", applySingle(single.deltas[0]));
+    print("BM_ApplyOrderEvents/replicas:1", applySingle(single.events[0]));
+
+    auto many = generate(updates, replicas);
+    std::cout << replicas << " books: " << many.totalDeltas << " level deltas, " << many.totalEvents << " order events\n";
+    print("BM_ApplyLevelDeltas/replicas:" + std::to_string(replicas), applyFanOut(many.deltas, many.totalDeltas));
+    print("BM_ApplyOrderEvents/replicas:" + std::to_string(replicas), applyFanOut(many.events, many.totalEvents));
+}
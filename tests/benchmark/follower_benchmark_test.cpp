@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/exchange.h"
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "core/follower.h"
+#endif
+
+/**
+ * Hot standby failover: a primary process journals random orders and cancels while a JournalFollower applies them to
+ * a standby. The primary is killed mid-stream and the standby promoted. Reports the follower's lag while streaming,
+ * the failover time (kill to promoted) and, for comparison, the time to rebuild the same books from the journal.
+ *
+ * usage: follower_benchmark_test [commands before the kill, default 500000] [journal directory]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+#ifdef _WIN32
+    std::cout << "the journal requires POSIX memory mapped files\n";
+    return 0;
+#else
+    const uint64_t n = argc > 1 ? std::stoull(argv[1]) : 500000;
+    const std::string dir = argc > 2 ? argv[2] : (std::filesystem::temp_directory_path() / "orderbook_follower_benchmark").string();
+    std::filesystem::remove_all(dir);
+
+    const pid_t child = fork();
+    if (child < 0) return 1;
+    if (child == 0) {
+        auto primary = std::make_unique<Exchange>();
+        JournalConfig config;
+        config.directory = dir;
+        primary->setJournal(std::make_shared<Journal>(config));
+        std::mt19937 rng(42);
+        std::normal_distribution<double> ticks(0.0, 20.0);
+        std::vector<long> live;
+        while (true) {
+            const auto instrument = "SYM" + std::to_string(rng() % 16);
+            if (rng() % 4 == 0 && !live.empty()) {
+                const auto index = rng() % live.size();
+                primary->cancel(live[index], "session");
+                live[index] = live.back();
+                live.pop_back();
+                continue;
+            }
+            const bool buy = rng() % 2;
+            const double price = 1000 + std::round(ticks(rng)) + (buy ? -10 : 10);
+            auto id = buy ? primary->buy("session", instrument, price, 1 + int(rng() % 100)) : primary->sell("session", instrument, price, 1 + int(rng() % 100));
+            if (id) live.push_back(*id);
+        }
+    }
+
+    auto standby = std::make_unique<Exchange>();
+    JournalFollower follower(*standby, dir);
+    follower.start(std::chrono::microseconds(0));
+    const auto deadline = Clock::now() + std::chrono::seconds(120);
+    while (follower.applied() < n && Clock::now() < deadline) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    const auto killed = Clock::now();
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    const auto total = follower.promote();
+    const auto failover = std::chrono::duration<double, std::micro>(Clock::now() - killed).count();
+
+    const auto lag = follower.lagHistogram();
+    std::cout << "BM_FollowerLag: " << lag.count() << " commands, p50 " << lag.percentile(50) << " p99 " << lag.percentile(99)
+              << " p99.9 " << lag.percentile(99.9) << " max " << lag.max() << " ns\n";
+    std::cout << "BM_Failover: " << total << " commands applied, promoted " << std::fixed << std::setprecision(0) << failover
+              << " us after the kill\n";
+
+    auto rebuilt = std::make_unique<Exchange>();
+    const auto start = Clock::now();
+    const auto replayed = rebuilt->recover(dir);
+    std::cout << "BM_Rebuild: " << replayed << " commands in " << std::setprecision(3)
+              << std::chrono::duration<double>(Clock::now() - start).count() << " sec\n";
+    std::filesystem::remove_all(dir);
+    return replayed == total ? 0 : 1;
+#endif
+}
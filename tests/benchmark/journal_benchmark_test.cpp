@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/exchange.h"
+#include "core/journal.h"
+
+/**
+ * Journal overhead per command for each sync policy, and recovery time from the journal.
+ *
+ * usage: journal_benchmark_test [orders, default 500000] [journal directory, default under the temp directory]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+struct Command {
+    bool buy;
+    bool cancel;
+    double price;
+    int quantity;
+    uint32_t pick;
+};
+
+static std::vector<Command> generate(long n) {
+    std::mt19937 rng(42);
+    std::normal_distribution<double> ticks(0.0, 20.0);
+    std::vector<Command> commands;
+    commands.reserve(size_t(n));
+    for (long i = 0; i < n; i++) {
+        Command c{};
+        c.buy = rng() % 2;
+        c.cancel = rng() % 4 == 0;
+        c.price = 1000 + std::round(ticks(rng)) + (c.buy ? -10 : 10);
+        c.quantity = int(1 + rng() % 100);
+        c.pick = uint32_t(rng());
+        commands.push_back(c);
+    }
+    return commands;
+}
+
+/** @return nanoseconds per command */
+static double run(const std::vector<Command>& commands, std::shared_ptr<Journal> journal) {
+    auto exchange = std::make_unique<Exchange>();
+    if (journal) exchange->setJournal(journal);
+    static const std::string session("session");
+    static const std::string instrument("SYM1");
+    std::vector<long> live;
+    live.reserve(commands.size());
+
+    auto start = Clock::now();
+    for (auto& c : commands) {
+        if (c.cancel && !live.empty()) {
+            auto index = c.pick % live.size();
+            exchange->cancel(live[index], session);
+            live[index] = live.back();
+            live.pop_back();
+        } else {
+            auto id = c.buy ? exchange->buy(session, instrument, c.price, c.quantity) : exchange->sell(session, instrument, c.price, c.quantity);
+            if (id) live.push_back(*id);
+        }
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / double(commands.size());
+}
+
+static void print(const std::string& name, double nanos, double baseline) {
+    std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << nanos
+              << " ns/command" << std::setw(10) << nanos - baseline << " ns journal overhead\n";
+}
+
+int main(int argc, char** argv) {
+#ifdef _WIN32
+    std::cout << "the journal requires POSIX memory mapped files\n";
+    return 0;
+#endif
+    const long n = argc > 1 ? std::stol(argv[1]) : 500000;
+    const std::string dir = argc > 2 ? argv[2] : (std::filesystem::temp_directory_path() / "orderbook_journal_benchmark").string();
+
+    const auto commands = generate(n);
+    const auto baseline = run(commands, nullptr);
+    print("BM_Exchange/journal:off", baseline, baseline);
+
+    auto journaled = [&](const char* name, JournalSync sync, const std::vector<Command>& cmds) {
+        std::filesystem::remove_all(dir);
+        JournalConfig config;
+        config.directory = dir;
+        config.sync = sync;
+        print(name, run(cmds, std::make_shared<Journal>(config)), baseline);
+    };
+    journaled("BM_Exchange/journal:sync_every", JournalSync::EVERY, std::vector<Command>(commands.begin(), commands.begin() + std::min(n, 20000L)));
+    journaled("BM_Exchange/journal:sync_group", JournalSync::GROUP, commands);
+    journaled("BM_Exchange/journal:sync_none", JournalSync::NONE, commands);
+
+    // recover from the last (sync none) journal
+    auto exchange = std::make_unique<Exchange>();
+    auto start = Clock::now();
+    auto replayed = exchange->recover(dir);
+    auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "BM_Recover: " << replayed << " commands in " << std::setprecision(3) << seconds << " sec, "
+              << std::setprecision(1) << double(replayed) / seconds / 1e6 << " M commands/sec\n";
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/exchange.h"
+#include "core/latency.h"
+
+/**
+ * Open-loop latency benchmark. Operations are scheduled at a fixed rate and each latency is measured from the
+ * time the operation was *scheduled*, not from when it was actually issued, so a stall in the engine is charged
+ * to every operation queued behind it (no coordinated omission).
+ *
+ * usage: latency_benchmark_test [--rate ops/sec] [--duration secs] [--mix order:cancel:quote[:modify]]
+ *                               [--prices uniform|normal] [--levels n] [--instruments n] [--seed n]
+ *                               [--format csv|json] [--output file]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+enum OpType { ORDER, CANCEL, QUOTE, MODIFY, N_OP_TYPES };
+static const char* opNames[] = {"order", "cancel", "quote", "modify"};
+
+struct Config {
+    double rate = 100000;
+    double duration = 2.0;
+    int mix[N_OP_TYPES] = {60, 30, 10, 0};
+    bool normalPrices = false;
+    int levels = 100;
+    int instruments = 1;
+    unsigned seed = 42;
+    std::string format = "csv";
+    std::string output;
+};
+
+struct Op {
+    OpType type;
+    Order::Side side;
+    int instrument;
+    double price;
+    double spread;
+    int quantity;
+    uint32_t pick;
+};
+
+static std::vector<Op> generate(const Config& cfg) {
+    std::mt19937 rng(cfg.seed);
+    const long n = long(cfg.rate * cfg.duration);
+    const double mid = 1000.0;
+    std::discrete_distribution<int> mix(std::begin(cfg.mix), std::end(cfg.mix));
+    std::uniform_int_distribution<int> uniformTicks(-cfg.levels, cfg.levels);
+    std::normal_distribution<double> normalTicks(0.0, cfg.levels / 3.0);
+    std::uniform_int_distribution<int> qty(1, 100);
+    std::uniform_int_distribution<int> instrument(0, cfg.instruments - 1);
+    std::uniform_int_distribution<uint32_t> pick;
+
+    auto ticks = [&]() {
+        return cfg.normalPrices ? std::round(normalTicks(rng)) : double(uniformTicks(rng));
+    };
+
+    std::vector<Op> ops;
+    ops.reserve(n);
+    for (long i = 0; i < n; i++) {
+        Op op{};
+        op.type = OpType(mix(rng));
+        op.side = rng() % 2 ? Order::BUY : Order::SELL;
+        op.instrument = instrument(rng);
+        // orders are biased away from the touch so roughly a third of them are marketable
+        op.price = mid + ticks() + (op.side == Order::BUY ? -cfg.levels / 3.0 : cfg.levels / 3.0);
+        op.spread = 1 + std::abs(ticks()) / 4;
+        op.quantity = qty(rng);
+        op.pick = pick(rng);
+        ops.push_back(op);
+    }
+    return ops;
+}
+
+static void report(const Config& cfg, const LatencyHistogram* hist, double achievedRate, long trades) {
+    std::cout << "open-loop target rate " << cfg.rate << " ops/sec, achieved " << achievedRate << " ops/sec, trades " << trades << "\n";
+    for (int t = 0; t < N_OP_TYPES; t++) {
+        const auto& h = hist[t];
+        auto usec = [](uint64_t nanos) { return double(nanos) / 1000.0; };
+        std::cout << opNames[t] << ": count " << h.count() << ", usec p50 " << usec(h.percentile(50))
+                  << " p90 " << usec(h.percentile(90)) << " p99 " << usec(h.percentile(99))
+                  << " p99.9 " << usec(h.percentile(99.9)) << " max " << usec(h.max()) << "\n";
+    }
+
+    std::ofstream file;
+    if (!cfg.output.empty()) file.open(cfg.output);
+    std::ostream& out = cfg.output.empty() ? std::cout : file;
+
+    if (cfg.format == "json") {
+        out << "{\"rate\":" << cfg.rate << ",\"achieved\":" << achievedRate << ",\"duration\":" << cfg.duration
+            << ",\"levels\":" << cfg.levels << ",\"instruments\":" << cfg.instruments << ",\"ops\":{";
+        for (int t = 0; t < N_OP_TYPES; t++) {
+            const auto& h = hist[t];
+            out << (t ? "," : "") << "\"" << opNames[t] << "\":{\"count\":" << h.count() << ",\"p50_ns\":" << h.percentile(50)
+                << ",\"p90_ns\":" << h.percentile(90) << ",\"p99_ns\":" << h.percentile(99)
+                << ",\"p999_ns\":" << h.percentile(99.9) << ",\"max_ns\":" << h.max() << "}";
+        }
+        out << "}}\n";
+    } else {
+        out << "op,rate,achieved,count,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n";
+        for (int t = 0; t < N_OP_TYPES; t++) {
+            const auto& h = hist[t];
+            out << opNames[t] << "," << cfg.rate << "," << achievedRate << "," << h.count() << "," << h.percentile(50) << ","
+                << h.percentile(90) << "," << h.percentile(99) << "," << h.percentile(99.9) << "," << h.max() << "\n";
+        }
+    }
+}
+
+static bool parseArgs(int argc, char** argv, Config& cfg) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--rate") cfg.rate = std::stod(value);
+        else if (arg == "--duration") cfg.duration = std::stod(value);
+        else if (arg == "--mix") {
+            cfg.mix[MODIFY] = 0;
+            if (std::sscanf(value.c_str(), "%d:%d:%d:%d", &cfg.mix[ORDER], &cfg.mix[CANCEL], &cfg.mix[QUOTE], &cfg.mix[MODIFY]) < 3) return false;
+        }
+        else if (arg == "--prices") cfg.normalPrices = value == "normal";
+        else if (arg == "--levels") cfg.levels = std::max(1, std::stoi(value));
+        else if (arg == "--instruments") cfg.instruments = std::max(1, std::stoi(value));
+        else if (arg == "--seed") cfg.seed = unsigned(std::stoul(value));
+        else if (arg == "--format") cfg.format = value;
+        else if (arg == "--output") cfg.output = value;
+        else {
+            std::cerr << "unknown option " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Config cfg;
+    if (!parseArgs(argc, argv, cfg)) return 1;
+
+    struct CountingListener : ExchangeListener {
+        long trades = 0;
+        void onTrade(const Trade& trade) override { trades++; }
+    } listener;
+
+    // Exchange embeds the order map table, too large for the stack
+    auto exchange = std::make_unique<Exchange>(listener);
+
+    std::vector<std::string> instruments;
+    for (int i = 0; i < cfg.instruments; i++) instruments.push_back("i" + std::to_string(i + 1));
+    const std::string session("session");
+    const std::string maker("maker");
+    static const char* quoteIds[] = {"q0", "q1", "q2", "q3"};
+
+    const auto ops = generate(cfg);
+    std::vector<long> live;
+    live.reserve(ops.size());
+
+    LatencyHistogram hist[N_OP_TYPES];
+    const auto interval = std::chrono::duration<double, std::nano>(1e9 / cfg.rate);
+    const auto start = Clock::now();
+
+    for (size_t i = 0; i < ops.size(); i++) {
+        const Op& op = ops[i];
+        const auto scheduled = start + std::chrono::duration_cast<Clock::duration>(interval * double(i));
+        while (Clock::now() < scheduled) {
+            // spin, sleeping would add scheduler jitter to the measurement
+        }
+        const auto& instrument = instruments[op.instrument];
+        switch (op.type) {
+            case ORDER: {
+                auto id = op.side == Order::BUY
+                    ? exchange->buy(session, instrument, op.price, op.quantity)
+                    : exchange->sell(session, instrument, op.price, op.quantity);
+                if (id) live.push_back(*id);
+                break;
+            }
+            case CANCEL:
+                if (!live.empty()) {
+                    auto index = op.pick % live.size();
+                    exchange->cancel(live[index], session);
+                    live[index] = live.back();
+                    live.pop_back();
+                }
+                break;
+            case MODIFY:
+                // cancel/replace of a random live order to the operation's price and quantity, keeping its id
+                if (!live.empty()) {
+                    exchange->modify(live[op.pick % live.size()], session, op.price, op.quantity);
+                }
+                break;
+            case QUOTE:
+                exchange->quote(maker, instrument, op.price - op.spread, op.quantity, op.price + op.spread, op.quantity, quoteIds[op.pick % 4]);
+                break;
+            default:
+                break;
+        }
+        hist[op.type].record(Clock::now() - scheduled);
+    }
+
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    report(cfg, hist, double(ops.size()) / elapsed, listener.trades);
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/exchange.h"
+
+/**
+ * A market maker refreshing a two sided quote on every series of an option chain per update cycle, sent as one
+ * quote() call per series and as one massQuote. Reports the time per cycle and per quote; the books must end equal.
+ *
+ * usage: massquote_benchmark_test [series, default 2000] [cycles, default 200]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+    const int series = argc > 1 ? std::stoi(argv[1]) : 2000;
+    const int cycles = argc > 2 ? std::stoi(argv[2]) : 200;
+
+    std::vector<std::string> instruments;
+    for (int i = 0; i < series; i++) instruments.push_back("OPT" + std::to_string(i));
+    // one cycle's quotes, the same for both runs, in a shuffled series order
+    std::mt19937 rng(11);
+    std::vector<std::vector<QuoteEntry>> updates(static_cast<size_t>(cycles));
+    for (auto& update : updates) {
+        for (const auto& instrument : instruments) {
+            const double mid = 100 + double(rng() % 5);
+            update.push_back({instrument, "q", mid - 1, 1 + int(rng() % 50), mid + 1, 1 + int(rng() % 50)});
+        }
+        std::shuffle(update.begin(), update.end(), rng);
+    }
+
+    auto single = std::make_unique<Exchange>();
+    auto mass = std::make_unique<Exchange>();
+    // create the books outside the timed runs
+    for (const auto& instrument : instruments) {
+        single->quote("mm", instrument, 1, 1, 1000, 1, "q");
+        mass->quote("mm", instrument, 1, 1, 1000, 1, "q");
+    }
+
+    auto start = Clock::now();
+    for (const auto& update : updates) {
+        for (const auto& e : update) single->quote("mm", e.instrument, e.bidPrice, e.bidQuantity, e.askPrice, e.askQuantity, e.quoteId);
+    }
+    const double singleNanos = double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+    std::vector<QuoteStatus> status(static_cast<size_t>(series));
+    start = Clock::now();
+    for (const auto& update : updates) mass->massQuote("mm", update, status);
+    const double massNanos = double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+    const double quotes = double(series) * cycles;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "BM_Quote/series:" << series << ": " << singleNanos / cycles / 1000 << " us/cycle, " << singleNanos / quotes << " ns/quote\n";
+    std::cout << "BM_MassQuote/series:" << series << ": " << massNanos / cycles / 1000 << " us/cycle, " << massNanos / quotes << " ns/quote\n";
+
+    for (const auto& instrument : instruments) {
+        auto a = *single->book(instrument);
+        auto b = *mass->book(instrument);
+        if (a.bids.size() != b.bids.size() || a.asks.size() != b.asks.size() || a.bids[0].quantity != b.bids[0].quantity ||
+            a.asks[0].quantity != b.asks[0].quantity) {
+            std::cout << "massQuote book " << instrument << " differs\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "core/order.h"
+#include "core/orderbook.h"
+#include "core/pricelevels.h"
+
+/**
+ * Micro-benchmarks of every PriceLevels implementation in a single binary, so the container can be chosen per
+ * instrument class from data rather than by editing the PriceLevels typedef. Each benchmark performs the container
+ * operations OrderBook performs for the corresponding engine operation:
+ *
+ *   insert - insertOrder at a random resting price
+ *   match  - front() + removeOrder of the best order, as done by matchOrders for a fully filled order
+ *   cancel - removeOrder of an order selected by queue position (front of book, middle level, random)
+ *   book   - BasicOrderBook<Levels>::insertOrder of resting bids followed by offers that sweep them, with matching
+ *   bookVirtual - the same through the OrderBook returned by OrderBook::create, the cost of the virtual entry point
+ *   quote  - BasicOrderBook<Levels>::quote refreshing a two-sided quote inside the resting bids, 9 of 10 updates
+ *            change only size, the others move the price within the same gap between levels
+ *
+ * The sweep covers book depth (1, 10, 100, 1k, 10k levels) and orders per level (1, 10, 100).
+ * usage: pricelevels_benchmark_test [max orders per book, default 100000]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static const std::string instrument("SYM1");
+static const std::string session("session");
+
+// every run performs at least this many timed operations, so shallow books are repeated
+static const long MIN_OPS = 50000;
+
+enum CancelPosition { FRONT, MIDDLE, RANDOM };
+static const char* positionNames[] = {"front", "middle", "random"};
+
+struct Result {
+    double nanosPerOp;
+    long iterations;
+};
+
+struct BookOrders {
+    /** orders in the (random price) sequence they are inserted */
+    std::vector<std::shared_ptr<Order>> insertion;
+    /** the same orders in book priority: best level first, FIFO within a level */
+    std::vector<std::shared_ptr<Order>> priority;
+};
+
+static BookOrders makeOrders(int depth, int perLevel, std::mt19937& rng) {
+    BookOrders book;
+    const size_t n = size_t(depth) * perLevel;
+    book.priority.reserve(n);
+    book.insertion.reserve(n);
+    long id = 0;
+    for (int level = 0; level < depth; level++) {
+        for (int q = 0; q < perLevel; q++) {
+            book.priority.push_back(Order::create(session, "", instrument, F(1000.0 - level), 10, Order::BUY, ++id));
+        }
+    }
+    // levels are visited in random order, time priority within a level is preserved
+    std::vector<int> levels(depth);
+    std::iota(levels.begin(), levels.end(), 0);
+    std::shuffle(levels.begin(), levels.end(), rng);
+    for (int q = 0; q < perLevel; q++) {
+        for (int level : levels) book.insertion.push_back(book.priority[size_t(level) * perLevel + q]);
+    }
+    return book;
+}
+
+template <typename Levels>
+static Result benchInsert(int depth, int perLevel, std::mt19937& rng) {
+    const long perRep = long(depth) * perLevel;
+    const long reps = std::max(1L, MIN_OPS / perRep);
+    Clock::duration total{};
+    for (long r = 0; r < reps; r++) {
+        auto orders = makeOrders(depth, perLevel, rng).insertion;
+        Levels levels(false);
+        auto start = Clock::now();
+        for (auto& order : orders) levels.insertOrder(order);
+        total += Clock::now() - start;
+    }
+    return {std::chrono::duration<double, std::nano>(total).count() / double(reps * perRep), reps * perRep};
+}
+
+template <typename Levels>
+static Result benchMatch(int depth, int perLevel, std::mt19937& rng) {
+    const long perRep = long(depth) * perLevel;
+    const long reps = std::max(1L, MIN_OPS / perRep);
+    Clock::duration total{};
+    for (long r = 0; r < reps; r++) {
+        auto orders = makeOrders(depth, perLevel, rng).insertion;
+        Levels levels(false);
+        for (auto& order : orders) levels.insertOrder(order);
+        auto start = Clock::now();
+        while (!levels.empty()) {
+            levels.removeOrder(levels.front());
+        }
+        total += Clock::now() - start;
+    }
+    return {std::chrono::duration<double, std::nano>(total).count() / double(reps * perRep), reps * perRep};
+}
+
+template <typename Levels>
+static Result benchCancel(int depth, int perLevel, CancelPosition position, std::mt19937& rng) {
+    const long perRep = long(depth) * perLevel;
+    // cancel half the book so the middle/random positions still see a populated book
+    const long cancels = std::max(1L, perRep / 2);
+    const long reps = std::max(1L, MIN_OPS / cancels);
+    Clock::duration total{};
+    for (long r = 0; r < reps; r++) {
+        auto book = makeOrders(depth, perLevel, rng);
+        Levels levels(false);
+        for (auto& order : book.insertion) levels.insertOrder(order);
+
+        auto& targets = book.priority;
+        switch (position) {
+            case FRONT:
+                break;
+            case MIDDLE:
+                std::rotate(targets.begin(), targets.begin() + targets.size() / 4, targets.end());
+                break;
+            case RANDOM:
+                std::shuffle(targets.begin(), targets.end(), rng);
+                break;
+        }
+        auto start = Clock::now();
+        for (long i = 0; i < cancels; i++) {
+            levels.removeOrder(targets[i]);
+        }
+        total += Clock::now() - start;
+    }
+    return {std::chrono::duration<double, std::nano>(total).count() / double(reps * cancels), reps * cancels};
+}
+
+/** Book is BasicOrderBook<Levels>, whose final calls are bound statically, or OrderBook, called through OrderBook::create's virtual entry points */
+template <typename Levels, typename Book = BasicOrderBook<Levels>>
+static Result benchBook(int depth, int perLevel, std::mt19937& rng, PriceLevelsType type = {}) {
+    const long perRep = long(depth) * perLevel * 2;
+    const long reps = std::max(1L, MIN_OPS / perRep);
+    OrderBookListener listener;
+    Clock::duration total{};
+    for (long r = 0; r < reps; r++) {
+        auto bids = makeOrders(depth, perLevel, rng).insertion;
+        // the book holds weak references, the offers must outlive the matching
+        std::vector<std::shared_ptr<Order>> offers;
+        offers.reserve(bids.size());
+        for (size_t i = 0; i < bids.size(); i++) {
+            offers.push_back(Order::create(session, "", instrument, F(1000.0 - double(i % depth)), 10, Order::SELL, long(bids.size() + i + 1)));
+        }
+        std::shared_ptr<Book> book;
+        if constexpr (std::is_same_v<Book, OrderBook>) {
+            book = OrderBook::create(instrument, listener, {.levels = type});
+        } else {
+            book = std::make_shared<Book>(instrument, listener);
+        }
+        auto start = Clock::now();
+        for (auto& order : bids) book->insertOrder(order);
+        for (auto& order : offers) book->insertOrder(order);
+        total += Clock::now() - start;
+    }
+    return {std::chrono::duration<double, std::nano>(total).count() / double(reps * perRep), reps * perRep};
+}
+
+template <typename Levels>
+static Result benchQuote(int depth, int perLevel, std::mt19937& rng) {
+    OrderBookListener listener;
+    BasicOrderBook<Levels> book(instrument, listener);
+    auto bids = makeOrders(depth, perLevel, rng).insertion;
+    for (auto& order : bids) book.insertOrder(order);
+    // the quoted bid sits between two resting levels, the ask above the book
+    const double bid = 1000.5 - depth / 2;
+    auto quotes = QuoteOrders{Order::create("maker", "q", instrument, F(bid), 1, Order::BUY, -1), Order::create("maker", "q", instrument, F(1001.0), 1, Order::SELL, -2)};
+    std::uniform_int_distribution<int> size(1, 100);
+    std::vector<int> sizes(4096);
+    for (auto& s : sizes) s = size(rng);
+    const long n = std::max(MIN_OPS, 200000L);
+    auto start = Clock::now();
+    for (long i = 0; i < n; i++) {
+        const int qty = sizes[size_t(i) & 4095];
+        const double tick = i % 10 == 0 ? (i / 10 % 2 ? 0.25 : 0.0) : 0.0;
+        book.quote(quotes, F(bid + tick), qty, F(1001.0 + tick), qty);
+    }
+    return {std::chrono::duration<double, std::nano>(Clock::now() - start).count() / double(n), n};
+}
+
+static void print(const std::string& name, const Result& result) {
+    std::cout << std::left << std::setw(72) << name << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+              << result.nanosPerOp << " ns" << std::setw(12) << result.iterations << "\n";
+}
+
+template <typename Levels>
+static void benchmark(const char* name, PriceLevelsType type, long maxOrders) {
+    static const int depths[] = {1, 10, 100, 1000, 10000};
+    static const int perLevels[] = {1, 10, 100};
+    std::mt19937 rng(42);
+
+    for (int depth : depths) {
+        for (int perLevel : perLevels) {
+            if (long(depth) * perLevel > maxOrders) continue;
+            auto suffix = "/depth:" + std::to_string(depth) + "/per_level:" + std::to_string(perLevel);
+            print(std::string("BM_Insert<") + name + ">" + suffix, benchInsert<Levels>(depth, perLevel, rng));
+            print(std::string("BM_Match<") + name + ">" + suffix, benchMatch<Levels>(depth, perLevel, rng));
+            print(std::string("BM_Book<") + name + ">" + suffix, benchBook<Levels>(depth, perLevel, rng));
+            print(std::string("BM_BookVirtual<") + name + ">" + suffix, benchBook<Levels, OrderBook>(depth, perLevel, rng, type));
+            print(std::string("BM_Quote<") + name + ">" + suffix, benchQuote<Levels>(depth, perLevel, rng));
+            for (auto position : {FRONT, MIDDLE, RANDOM}) {
+                print(std::string("BM_Cancel<") + name + ">" + suffix + "/position:" + positionNames[position],
+                      benchCancel<Levels>(depth, perLevel, position, rng));
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    const long maxOrders = argc > 1 ? std::stol(argv[1]) : 100000;
+
+    std::cout << std::left << std::setw(72) << "Benchmark" << std::right << std::setw(15) << "Time" << std::setw(12) << "Iterations" << "\n";
+    std::cout << std::string(99, '-') << "\n";
+    benchmark<DequeuePtrPriceLevels>("DequeuePtrPriceLevels", PriceLevelsType::DEQUE_PTR, maxOrders);
+    benchmark<VectorPtrPriceLevels>("VectorPtrPriceLevels", PriceLevelsType::VECTOR_PTR, maxOrders);
+    benchmark<VectorPriceLevels>("VectorPriceLevels", PriceLevelsType::VECTOR, maxOrders);
+    benchmark<StdMapPriceLevels>("StdMapPriceLevels", PriceLevelsType::STD_MAP, maxOrders);
+    benchmark<StdMapPtrPriceLevels>("StdMapPtrPriceLevels", PriceLevelsType::STD_MAP_PTR, maxOrders);
+}
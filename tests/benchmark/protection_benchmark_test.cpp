@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/exchange.h"
+
+/**
+ * Market maker protection pull latency: a session quotes every series, then one order trips its protection and
+ * the call returns once every quote of the session is pulled from every book. Compared with the session pulling
+ * its quotes itself, one quote(..., 0, ..., 0) per series. Other sessions' resting orders are not scanned, the
+ * pull is proportional to the session's quotes only.
+ *
+ * usage: protection_benchmark_test [series, default 2000] [rounds, default 50] [other resting orders per series, default 100]
+ */
+
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+
+int main(int argc, char** argv) {
+    const int series = argc > 1 ? std::stoi(argv[1]) : 2000;
+    const int rounds = argc > 2 ? std::stoi(argv[2]) : 50;
+    const int resting = argc > 3 ? std::stoi(argv[3]) : 100;
+
+    std::vector<std::string> instruments;
+    for (int i = 0; i < series; i++) instruments.push_back("OPT" + std::to_string(i));
+    auto exchange = std::make_unique<Exchange>();
+    for (const auto& instrument : instruments) {
+        for (int i = 0; i < resting; i++) {
+            exchange->buy("other", instrument, 90 - i % 10, 1);
+            exchange->sell("other", instrument, 110 + i % 10, 1);
+        }
+    }
+    auto quoteAll = [&]() {
+        for (const auto& instrument : instruments) exchange->quote("mm", instrument, 99, 10, 101, 10, "q");
+    };
+
+    std::vector<double> trip, manual;
+    for (int r = 0; r < rounds; r++) {
+        exchange->setProtection("mm", {1s, 1, 0});
+        quoteAll();
+        auto start = Clock::now();
+        exchange->sell("taker", instruments[size_t(r) % instruments.size()], 99, 1);
+        trip.push_back(double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+        if (!exchange->isProtectionTripped("mm") || exchange->topOfBook(instruments[0])->bidPrice != F(90)) {
+            std::cout << "protection did not pull the quotes\n";
+            return 1;
+        }
+
+        exchange->setProtection("mm", {});
+        quoteAll();
+        start = Clock::now();
+        for (const auto& instrument : instruments) exchange->quote("mm", instrument, 99, 0, 101, 0, "q");
+        manual.push_back(double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+    }
+
+    auto report = [&](const char* name, std::vector<double>& samples) {
+        std::sort(samples.begin(), samples.end());
+        std::cout << name << "/series:" << series << ": p50 " << std::fixed << std::setprecision(1) << samples[samples.size() / 2] / 1000
+                  << " us, max " << samples.back() / 1000 << " us, " << samples[samples.size() / 2] / series << " ns/series\n";
+    };
+    report("BM_ProtectionTrip", trip);
+    report("BM_ManualPull", manual);
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/exchange.h"
+#include "core/journal.h"
+#include "core/replay.h"
+
+/**
+ * Replays an Exchange command journal into a fresh Exchange and reports throughput, per-operation latency
+ * percentiles and the trade digest. Without --journal, a random journal is recorded first and replayed twice, and
+ * both digests must match the recording's: a self check that the engine is deterministic. It is then replayed by
+ * ParallelReplay on one thread and on --threads, whose combined per-instrument digests must match each other.
+ * With --journal and --threads, the journal is replayed in parallel, --expect then checks the combined digest.
+ *
+ * usage: replay_benchmark_test [--journal dir] [--pacing max|original] [--speed x] [--expect digest] [--threads n]
+ *                              [--commands n] [--instruments n, for the self check]
+ */
+
+static const char* operationNames[] = {"order", "quote", "cancel", "modify", "protect", "close", "pull"};
+
+static void print(const char* name, const ReplayReport& report) {
+    std::cout << name << ": " << report.commands << " commands in " << std::fixed << std::setprecision(3) << report.seconds
+              << " sec, " << std::setprecision(2) << double(report.commands) / report.seconds / 1e6 << " M commands/sec, "
+              << report.trades << " trades, digest " << std::hex << report.digest << std::dec << "\n";
+    for (int op = 0; op < ReplayReport::N_OPERATIONS; op++) {
+        const auto& h = report.latency[size_t(op)];
+        if (h.count() == 0) continue;
+        std::cout << "  " << std::left << std::setw(8) << operationNames[op] << std::right << std::setw(10) << h.count()
+                  << "  p50 " << std::setw(7) << h.percentile(50) << "  p99 " << std::setw(7) << h.percentile(99)
+                  << "  p99.9 " << std::setw(7) << h.percentile(99.9) << "  max " << std::setw(9) << h.max() << " ns\n";
+    }
+}
+
+/** records n random commands over the instruments, @return the digest of the recorded run */
+static uint64_t record(const std::string& dir, long n, int instruments) {
+    TradeDigest digest;
+    auto exchange = std::make_unique<Exchange>(digest);
+    JournalConfig config;
+    config.directory = dir;
+    config.segmentSize = 4 << 20;
+    exchange->setJournal(std::make_shared<Journal>(config));
+
+    std::mt19937 rng(7);
+    std::normal_distribution<double> ticks(0.0, 5.0);
+    std::vector<std::pair<long, std::string>> live;
+    for (long i = 0; i < n; i++) {
+        const auto instrument = "SYM" + std::to_string(rng() % unsigned(instruments));
+        const auto session = "session" + std::to_string(rng() % 8);
+        const auto r = rng() % 10;
+        if (r < 3 && !live.empty()) {
+            auto index = rng() % live.size();
+            exchange->cancel(live[index].first, live[index].second);
+            live[index] = live.back();
+            live.pop_back();
+        } else if (r < 4) {
+            const double mid = 1000 + std::round(ticks(rng));
+            exchange->quote("mm", instrument, mid - 1, 1 + int(rng() % 50), mid + 1, 1 + int(rng() % 50), "q" + instrument);
+        } else {
+            const bool buy = rng() % 2;
+            const double price = 1000 + std::round(ticks(rng));
+            auto id = buy ? exchange->buy(session, instrument, price, 1 + int(rng() % 100)) : exchange->sell(session, instrument, price, 1 + int(rng() % 100));
+            if (id) live.emplace_back(*id, session);
+        }
+    }
+    return digest.value();
+}
+
+int main(int argc, char** argv) {
+    std::string journal;
+    ReplayOptions options;
+    std::string expect;
+    long commands = 200000;
+    int instruments = 4;
+    unsigned threads = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!std::strcmp(argv[i], "--journal")) journal = argv[i + 1];
+        else if (!std::strcmp(argv[i], "--pacing")) options.originalPacing = !std::strcmp(argv[i + 1], "original");
+        else if (!std::strcmp(argv[i], "--speed")) options.speed = std::stod(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "--expect")) expect = argv[i + 1];
+        else if (!std::strcmp(argv[i], "--commands")) commands = std::stol(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "--instruments")) instruments = std::stoi(argv[i + 1]);
+        else if (!std::strcmp(argv[i], "--threads")) threads = unsigned(std::stoul(argv[i + 1]));
+        else {
+            std::cerr << "unknown option " << argv[i] << "\n";
+            return 2;
+        }
+    }
+#ifdef _WIN32
+    std::cout << "the journal requires POSIX memory mapped files\n";
+    return 0;
+#endif
+
+    if (!journal.empty()) {
+        ReplayReport report;
+        if (threads) {
+            ParallelReplay replay(threads, options);
+            report = replay.run(journal);
+            print(("BM_ParallelReplay/threads:" + std::to_string(threads)).c_str(), report);
+        } else {
+            JournalReplay replay(options);
+            report = replay.run(journal);
+            print("BM_Replay", report);
+        }
+        if (!expect.empty() && std::stoull(expect, nullptr, 16) != report.digest) {
+            std::cout << "digest mismatch, expected " << expect << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    const auto dir = (std::filesystem::temp_directory_path() / "orderbook_replay_benchmark").string();
+    std::filesystem::remove_all(dir);
+    const auto recorded = record(dir, commands, instruments);
+    std::cout << "recorded " << commands << " commands issued, digest " << std::hex << recorded << std::dec << "\n";
+    int result = 0;
+    for (auto name : {"BM_Replay/run:1", "BM_Replay/run:2"}) {
+        JournalReplay replay(options);
+        auto report = replay.run(dir);
+        print(name, report);
+        if (report.digest != recorded) {
+            std::cout << "replay digest differs from the recording\n";
+            result = 1;
+        }
+    }
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t parallel = 0;
+    for (auto n : {1u, threads}) {
+        ParallelReplay replay(n, options);
+        auto report = replay.run(dir);
+        print(("BM_ParallelReplay/threads:" + std::to_string(n)).c_str(), report);
+        if (n > 1 && report.digest != parallel) {
+            std::cout << "parallel replay digest depends on the thread count\n";
+            result = 1;
+        }
+        parallel = report.digest;
+    }
+    std::filesystem::remove_all(dir);
+    return result;
+}
@@ -0,0 +1,69 @@
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "core/exchange.h"
+
+/**
+ * Exchange snapshot save and restore time for a book of resting orders spread over many instruments. The restart
+ * target is 5M resting orders restored in under a second.
+ *
+ * usage: snapshot_benchmark_test [resting orders, default 1000000] [instruments, default 100] [snapshot file]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    const long n = argc > 1 ? std::stol(argv[1]) : 1000000;
+    const int instruments = argc > 2 ? std::stoi(argv[2]) : 100;
+    const std::string path = argc > 3 ? argv[3] : (std::filesystem::temp_directory_path() / "orderbook_snapshot_benchmark").string();
+
+    auto exchange = std::make_unique<Exchange>();
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> ticks(1, 500);
+    auto start = Clock::now();
+    for (long i = 0; i < n; i++) {
+        const auto instrument = "SYM" + std::to_string(i % instruments);
+        const auto session = "session" + std::to_string(i % 16);
+        // bids below 1000, asks above, nothing matches
+        if (i % 2) {
+            exchange->buy(session, instrument, F(1000 - ticks(rng)), 1 + int(rng() % 100), "client");
+        } else {
+            exchange->sell(session, instrument, F(1000 + ticks(rng)), 1 + int(rng() % 100), "client");
+        }
+    }
+    std::cout << "built " << n << " resting orders in " << std::fixed << std::setprecision(3) << seconds(start) << " sec\n";
+
+    start = Clock::now();
+    exchange->saveSnapshot(path);
+    const auto saveTime = seconds(start);
+    std::cout << "BM_SaveSnapshot: " << saveTime << " sec, " << std::filesystem::file_size(path) / (1 << 20) << " MB\n";
+
+    auto restored = std::make_unique<Exchange>();
+    start = Clock::now();
+    const auto orders = restored->loadSnapshot(path);
+    const auto loadTime = seconds(start);
+    std::cout << "BM_LoadSnapshot: " << orders << " orders in " << loadTime << " sec, " << std::setprecision(1)
+              << double(orders) / loadTime / 1e6 << " M orders/sec\n";
+
+    std::filesystem::remove(path);
+    // the books must be identical, a mismatch fails the benchmark
+    for (int i = 0; i < instruments; i++) {
+        const auto instrument = "SYM" + std::to_string(i);
+        auto before = *exchange->book(instrument);
+        auto after = *restored->book(instrument);
+        if (after.bidOrderIds != before.bidOrderIds || after.askOrderIds != before.askOrderIds) {
+            std::cout << "restored book " << instrument << " differs\n";
+            return 1;
+        }
+    }
+    return 0;
+}
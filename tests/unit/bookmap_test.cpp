@@ -1,6 +1,12 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
 #include "core/bookmap.h"
+#include "core/exchange.h"
 
 static OrderBookListener listener;
 
@@ -42,3 +48,179 @@ TEST(BookMapTest, Instruments) {
         EXPECT_EQ(book->instruments().size(), 1u);
     }
 }
+
+TEST(BookMapTest, InstrumentConfigHook) {
+    BookMap books;
+    int calls = 0;
+    InstrumentConfigHook configure = [&](std::string_view instrument) {
+        calls++;
+        return InstrumentConfig{.levels = instrument.starts_with("OPT") ? PriceLevelsType::STD_MAP : PriceLevelsType::VECTOR};
+    };
+
+    auto option = books.getOrCreate("OPT1", listener, configure);
+    auto future = books.getOrCreate("FUT1", listener, configure);
+    EXPECT_EQ(books.getOrCreate("OPT1", listener, configure), option);
+    EXPECT_EQ(calls, 2);
+
+    EXPECT_NE(dynamic_cast<BasicOrderBook<StdMapPriceLevels>*>(option.get()), nullptr);
+    EXPECT_NE(dynamic_cast<BasicOrderBook<VectorPriceLevels>*>(future.get()), nullptr);
+}
+
+TEST(BookMapTest, GrowsWithDenseIds) {
+    BookMap books;
+    const int n = 100000;
+    for (int i = 0; i < n; i++) EXPECT_EQ(books.getOrCreate("SYM" + std::to_string(i), listener)->instrument, "SYM" + std::to_string(i));
+    EXPECT_EQ(books.size(), size_t(n));
+    EXPECT_EQ(books.instruments().size(), size_t(n));
+    for (int i = 0; i < n; i += 997) {
+        const auto name = "SYM" + std::to_string(i);
+        EXPECT_EQ(books.find(name), InstrumentId(i));
+        EXPECT_EQ(books.get(InstrumentId(i))->instrument, name);
+        EXPECT_EQ(books.get(name), books.get(InstrumentId(i)));
+    }
+    EXPECT_EQ(books.find("SYM"), std::nullopt);
+    EXPECT_EQ(books.get(InstrumentId(n)), nullptr);
+}
+
+TEST(BookMapTest, LookupsWhileGrowing) {
+    auto books = std::make_unique<BookMap>();
+    const int n = 50000;
+    std::atomic<int> added{0};
+    std::atomic<bool> failed{false};
+    std::thread reader([&]() {
+        while (added.load() < n) {
+            const int i = added.load() - 1;
+            if (i < 0) continue;
+            auto id = books->find("SYM" + std::to_string(i));
+            if (!id || books->get(*id)->instrument != "SYM" + std::to_string(i)) failed = true;
+        }
+    });
+    for (int i = 0; i < n; i++) {
+        books->getOrCreate("SYM" + std::to_string(i), listener);
+        added.store(i + 1);
+    }
+    reader.join();
+    EXPECT_FALSE(failed);
+}
+
+TEST(BookMapTest, BooksCreatedOnFirstUse) {
+    BookMap books;
+    int calls = 0;
+    auto configure = [&](std::string_view) {
+        calls++;
+        return InstrumentConfig{};
+    };
+    const auto id = books.add("SYM1");
+    EXPECT_EQ(books.add("SYM1"), id);
+    EXPECT_EQ(books.find("SYM1"), id);
+    EXPECT_EQ(books.size(), 1u);
+    EXPECT_EQ(books.get(id), nullptr);
+    EXPECT_EQ(books.get("SYM1"), nullptr);
+    EXPECT_TRUE(books.instruments().empty());
+
+    auto book = books.getOrCreate(id, listener, configure);
+    ASSERT_NE(book, nullptr);
+    EXPECT_EQ(book->instrument, "SYM1");
+    EXPECT_EQ(books.getOrCreate("SYM1", listener, configure), book);
+    EXPECT_EQ(books.get(id), book);
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(books.getOrCreate(InstrumentId(1), listener), nullptr);
+}
+
+TEST(BookMapTest, ExchangeInstrumentIds) {
+    auto exchange = std::make_unique<Exchange>();
+    const auto id = exchange->registerInstrument("SYM1");
+    EXPECT_EQ(exchange->registerInstrument("SYM1"), id);
+    EXPECT_NE(exchange->registerInstrument("SYM2"), id);
+    // no book until the first order
+    EXPECT_FALSE(exchange->topOfBook(id));
+    EXPECT_EQ(exchange->orderBook("SYM2"), nullptr);
+
+    exchange->quote("mm", id, 99, 10, 101, 10, "q");
+    auto buy = exchange->buy("s1", id, 101, 4);
+    ASSERT_TRUE(buy);
+    EXPECT_EQ(exchange->getOrder(*buy)->filledQuantity(), 4);
+    EXPECT_TRUE(exchange->sell("s1", "SYM1", 100, 1));
+    EXPECT_EQ(exchange->topOfBook(id)->askPrice, F(100));
+    EXPECT_EQ(exchange->orderBook(id), exchange->orderBook("SYM1"));
+
+    EXPECT_FALSE(exchange->buy("s1", InstrumentId(1000), 101, 1));
+    EXPECT_FALSE(exchange->topOfBook(InstrumentId(1000)));
+}
+
+TEST(BookMapTest, RetireLeavesTombstones) {
+    BookMap books;
+    const int n = 3000;
+    for (int i = 0; i < n; i++) books.getOrCreate("SYM" + std::to_string(i), listener);
+    // retiring every other instrument, then registering as many new ones rebuilds the index past the tombstones
+    for (int i = 0; i < n; i += 2) {
+        auto retired = books.retire(InstrumentId(i));
+        ASSERT_TRUE(retired);
+        EXPECT_EQ((*retired)->instrument, "SYM" + std::to_string(i));
+    }
+    EXPECT_FALSE(books.retire(InstrumentId(0)));
+    EXPECT_FALSE(books.retire(InstrumentId(n)));
+    EXPECT_EQ(books.find("SYM0"), std::nullopt);
+    EXPECT_EQ(books.get(InstrumentId(0)), nullptr);
+    EXPECT_EQ(books.getOrCreate(InstrumentId(0), listener), nullptr);
+    EXPECT_EQ(books.instruments().size(), size_t(n / 2));
+    for (int i = 0; i < n; i++) books.add("NEW" + std::to_string(i));
+    for (int i = 1; i < n; i += 2) EXPECT_EQ(books.get("SYM" + std::to_string(i))->instrument, "SYM" + std::to_string(i));
+
+    // the name is registered again as a new instrument
+    const auto id = books.add("SYM0");
+    EXPECT_EQ(id, InstrumentId(2 * n));
+    EXPECT_FALSE(books.getOrCreate(id, listener)->isClosed());
+    EXPECT_EQ(books.find("SYM0"), id);
+
+    // a series listed and retired over and over takes a new id each time, the index keeps resolving through rebuilds
+    for (int i = 0; i < 2 * n; i++) {
+        const auto listed = books.add("ROLL");
+        EXPECT_EQ(listed, InstrumentId(2 * n + 1 + i));
+        ASSERT_TRUE(books.retire(listed));
+    }
+    EXPECT_EQ(books.find("ROLL"), std::nullopt);
+    EXPECT_EQ(books.find("SYM0"), id);
+    EXPECT_EQ(books.size(), size_t(4 * n + 1));
+}
+
+TEST(BookMapTest, ExchangeCloseInstrument) {
+    auto exchange = std::make_unique<Exchange>();
+    const auto id = exchange->registerInstrument("SYM1");
+    auto buy = exchange->buy("s1", id, 99, 10);
+    exchange->quote("mm", id, 98, 10, 101, 10, "q");
+    std::weak_ptr<OrderBook> closed = exchange->orderBook(id);
+    // a reader holding the book keeps it alive
+    auto reader = exchange->orderBook(id);
+
+    EXPECT_TRUE(exchange->closeInstrument(id));
+    EXPECT_FALSE(exchange->closeInstrument(id));
+    EXPECT_FALSE(exchange->closeInstrument("SYM2"));
+    EXPECT_TRUE(reader->isClosed());
+    EXPECT_TRUE(reader->book().bids.empty());
+    EXPECT_TRUE(reader->book().asks.empty());
+    reader.reset();
+    EXPECT_TRUE(closed.expired());
+
+    EXPECT_FALSE(exchange->buy("s1", id, 99, 1));
+    EXPECT_FALSE(exchange->orderBook("SYM1"));
+    EXPECT_FALSE(exchange->getOrder(*buy));
+    EXPECT_TRUE(exchange->instruments().empty());
+    // the orders outlive the book
+    size_t cancelled = 0;
+    for (const auto& order : exchange->getAllOrders()) {
+        EXPECT_EQ(order->instrument, "SYM1");
+        cancelled += order->isCancelled();
+    }
+    EXPECT_EQ(cancelled, 3u);
+
+    // listed again
+    EXPECT_NE(exchange->registerInstrument("SYM1"), id);
+    EXPECT_TRUE(exchange->buy("s1", "SYM1", 99, 1));
+    EXPECT_EQ(exchange->topOfBook("SYM1")->bidPrice, F(99));
+    // the closed instrument's orders are not found through the new listing of the name
+    EXPECT_FALSE(exchange->getOrder(*buy));
+    EXPECT_FALSE(exchange->cancel(*buy, "s1"));
+    EXPECT_FALSE(exchange->modify(*buy, "s1", 98, 5));
+    EXPECT_EQ(exchange->topOfBook("SYM1")->bidQuantity, 1);
+}
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <random>
+#include <vector>
+
+#include "core/bookreplica.h"
+#include "core/test.h"
+
+struct ReplicaFixture {
+    OrderBookListener listener;
+    std::shared_ptr<OrderBook> book;
+    std::vector<std::shared_ptr<TestOrder>> orders;
+    std::mt19937 rng{42};
+    long id = 0;
+
+    ReplicaFixture() {
+        InstrumentConfig config;
+        config.levelDeltaCapacity = 1 << 14;
+        config.orderEventCapacity = 1 << 14;
+        book = OrderBook::create("SYM1", listener, config);
+    }
+    void randomOperations(int n) {
+        for (int i = 0; i < n; i++) {
+            if (!orders.empty() && rng() % 3 == 0) {
+                book->cancelOrder(orders[rng() % orders.size()]);
+            } else {
+                auto side = rng() % 2 ? Order::BUY : Order::SELL;
+                double price = 100 + double(rng() % 20) - (side == Order::BUY ? 5 : -5);
+                orders.push_back(TestOrder::create(++id, price, int(1 + rng() % 10), side));
+                book->insertOrder(orders.back());
+            }
+        }
+    }
+    void expectSame(const BookReplica& replica) {
+        std::array<BookLevel, 64> bids, asks, replicaBids, replicaAsks;
+        auto size = book->depth(bids, asks);
+        auto replicaSize = replica.depth(replicaBids, replicaAsks);
+        ASSERT_EQ(size.bids, replicaSize.bids);
+        ASSERT_EQ(size.asks, replicaSize.asks);
+        for (int i = 0; i < size.bids; i++) {
+            EXPECT_EQ(bids[i].price, replicaBids[i].price);
+            EXPECT_EQ(bids[i].quantity, replicaBids[i].quantity);
+        }
+        for (int i = 0; i < size.asks; i++) {
+            EXPECT_EQ(asks[i].price, replicaAsks[i].price);
+            EXPECT_EQ(asks[i].quantity, replicaAsks[i].quantity);
+        }
+        EXPECT_TRUE(book->topOfBook() == replica.topOfBook());
+    }
+};
+
+TEST(BookReplicaTest, FollowFeeds) {
+    ReplicaFixture f;
+    BookReplica byPrice, byOrder;
+    f.randomOperations(2000);
+
+    f.book->levelDeltas()->drain([&](const LevelDelta& delta) { EXPECT_EQ(byPrice.apply(delta), BookReplica::APPLIED); });
+    f.book->orderEvents()->drain([&](const OrderEvent& event) { EXPECT_EQ(byOrder.apply(event), BookReplica::APPLIED); });
+    EXPECT_TRUE(byPrice.inSync());
+    EXPECT_EQ(byPrice.lastSequence(), f.book->levelDeltaSequence());
+    f.expectSame(byPrice);
+    f.expectSame(byOrder);
+}
+
+TEST(BookReplicaTest, RecoverFromSnapshot) {
+    ReplicaFixture f;
+    BookReplica byPrice, byOrder;
+    f.randomOperations(500);
+    // the replicas join late, the first update they see is a gap
+    f.book->levelDeltas()->drain([](const LevelDelta&) {}, 100);
+    f.book->orderEvents()->drain([](const OrderEvent&) {}, 100);
+
+    f.book->levelDeltas()->drain([&](const LevelDelta& delta) { byPrice.apply(delta); }, 50);
+    f.book->orderEvents()->drain([&](const OrderEvent& event) { byOrder.apply(event); }, 50);
+    EXPECT_FALSE(byPrice.inSync());
+    EXPECT_FALSE(byOrder.inSync());
+
+    {
+        auto guard = f.book->lock();
+        std::array<BookLevel, 64> bids, asks;
+        auto size = f.book->depth(bids, asks);
+        byPrice.snapshot(std::span(bids).first(size_t(size.bids)), std::span(asks).first(size_t(size.asks)), f.book->levelDeltaSequence());
+
+        std::vector<BookOrder> bidOrders(f.orders.size()), askOrders(f.orders.size());
+        bidOrders.resize(size_t(f.book->depthByOrder(Order::BUY, bidOrders)));
+        askOrders.resize(size_t(f.book->depthByOrder(Order::SELL, askOrders)));
+        byOrder.snapshot(bidOrders, askOrders, f.book->orderEventSequence());
+    }
+    EXPECT_TRUE(byPrice.inSync());
+    EXPECT_TRUE(byOrder.inSync());
+
+    // updates already covered by the snapshot are ignored, later ones apply
+    f.randomOperations(500);
+    f.book->levelDeltas()->drain([&](const LevelDelta& delta) { byPrice.apply(delta); });
+    f.book->orderEvents()->drain([&](const OrderEvent& event) { byOrder.apply(event); });
+    EXPECT_TRUE(byPrice.inSync());
+    EXPECT_TRUE(byOrder.inSync());
+    f.expectSame(byPrice);
+    f.expectSame(byOrder);
+}
+
+TEST(BookReplicaTest, BufferIsBounded) {
+    ReplicaFixture f;
+    BookReplica replica(64);
+    f.randomOperations(300);
+    // joining late, the replica buffers up to its limit, then drops what it buffered
+    f.book->levelDeltas()->drain([](const LevelDelta&) {}, 10);
+    int gaps = 0, dropped = 0;
+    auto count = [&](BookReplica::Status status) {
+        gaps += status == BookReplica::GAP;
+        dropped += status == BookReplica::DROPPED;
+    };
+    f.book->levelDeltas()->drain([&](const LevelDelta& delta) { count(replica.apply(delta)); }, 100);
+    EXPECT_EQ(gaps, 64 + 35);
+    EXPECT_EQ(dropped, 1);
+    EXPECT_FALSE(replica.inSync());
+
+    // a snapshot taken before the drop cannot be completed, a later one can
+    replica.snapshot(std::span<const BookLevel>(), std::span<const BookLevel>(), 20);
+    EXPECT_FALSE(replica.inSync());
+    f.book->levelDeltas()->drain([&](const LevelDelta& delta) { count(replica.apply(delta)); });
+    {
+        auto guard = f.book->lock();
+        std::array<BookLevel, 64> bids, asks;
+        auto size = f.book->depth(bids, asks);
+        replica.snapshot(std::span(bids).first(size_t(size.bids)), std::span(asks).first(size_t(size.asks)), f.book->levelDeltaSequence());
+    }
+    EXPECT_TRUE(replica.inSync());
+    f.randomOperations(100);
+    f.book->levelDeltas()->drain([&](const LevelDelta& delta) { EXPECT_EQ(replica.apply(delta), BookReplica::APPLIED); });
+    f.expectSame(replica);
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "core/conflator.h"
+#include "core/test.h"
+
+TEST(ConflatorTest, FullAndConflatedSubscribers) {
+    OrderBookListener listener;
+    InstrumentConfig config;
+    config.levelDeltaCapacity = 256;
+    auto book = OrderBook::create("SYM1", listener, config);
+
+    MarketDataFanout fanout;
+    EXPECT_EQ(fanout.add(book), 0u);
+    auto full = fanout.subscribe(256);
+    auto slow = fanout.subscribeConflated();
+
+    std::vector<std::shared_ptr<TestOrder>> orders;
+    for (int i = 0; i < 10; i++) {
+        orders.push_back(TestOrder::create(i + 1, 100 + i % 2, 1, Order::BUY));
+        book->insertOrder(orders.back());
+    }
+    EXPECT_EQ(fanout.poll(), 10u);
+
+    std::vector<BookUpdate> updates;
+    full->drain([&](const BookUpdate& update) { updates.push_back(update); });
+    ASSERT_EQ(updates.size(), 10u);
+    EXPECT_EQ(updates.back().delta.sequence, 10u);
+
+    // two levels changed, only their latest state is delivered
+    updates.clear();
+    EXPECT_EQ(slow->drain([&](const BookUpdate& update) { updates.push_back(update); }), 2u);
+    EXPECT_EQ(updates[0].delta.price, 100);
+    EXPECT_EQ(updates[0].delta.quantity, 5);
+    EXPECT_EQ(updates[1].delta.price, 101);
+    EXPECT_EQ(updates[1].delta.quantity, 5);
+    EXPECT_EQ(slow->conflatedCount(), 8u);
+    EXPECT_EQ(slow->drain([](const BookUpdate&) {}), 0u);
+
+    book->cancelOrder(orders[0]);
+    fanout.poll();
+    updates.clear();
+    slow->drain([&](const BookUpdate& update) { updates.push_back(update); });
+    ASSERT_EQ(updates.size(), 1u);
+    EXPECT_EQ(updates[0].delta.quantity, 4);
+    EXPECT_EQ(fanout.droppedCount(), 0u);
+}
+
+TEST(ConflatorTest, ConflatedTopOfBook) {
+    OrderBookListener listener;
+    auto b1 = OrderBook::create("SYM1", listener);
+    auto b2 = OrderBook::create("SYM2", listener);
+    ConflatedTopOfBook tob;
+    tob.add(b1);
+    EXPECT_EQ(tob.add(b2), 1u);
+    EXPECT_EQ(tob.drain([](uint32_t, const TopOfBook&) {}), 0u);
+
+    std::vector<std::shared_ptr<TestOrder>> orders;
+    for (int i = 0; i < 5; i++) {
+        orders.push_back(TestOrder::create(i + 1, 100 + i, 1, Order::BUY));
+        b2->insertOrder(orders.back());
+    }
+    std::vector<std::pair<uint32_t, TopOfBook>> updates;
+    EXPECT_EQ(tob.drain([&](uint32_t book, const TopOfBook& top) { updates.push_back({book, top}); }), 1u);
+    EXPECT_EQ(updates[0].first, 1u);
+    EXPECT_EQ(updates[0].second.bidPrice, 104);
+    EXPECT_EQ(tob.drain([](uint32_t, const TopOfBook&) {}), 0u);
+}
+
+TEST(ConflatorTest, DrainedLevelsAreReclaimed) {
+    ConflatedLevels levels;
+    uint64_t sequence = 0;
+    auto update = [&](uint32_t book, F price, int quantity) {
+        levels.update({book, {++sequence, price, quantity, Order::BUY}});
+    };
+    // a day of levels that come and go, only those resting at once hold a slot
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 50; i++) update(uint32_t(i % 3), 100 + round * 50 + i, 10);
+        EXPECT_EQ(levels.drain([](const BookUpdate&) {}), 50u);
+        for (int i = 0; i < 50; i += 2) update(uint32_t(i % 3), 100 + round * 50 + i, 0);
+        EXPECT_EQ(levels.drain([](const BookUpdate&) {}), 25u);
+        for (int i = 1; i < 50; i += 2) update(uint32_t(i % 3), 100 + round * 50 + i, 0);
+        EXPECT_EQ(levels.levelCount(), 25u);
+        levels.drain([](const BookUpdate&) {});
+        EXPECT_EQ(levels.levelCount(), 0u);
+    }
+
+    // a level emptied and refilled before the drain keeps its slot
+    update(0, 100, 5);
+    update(0, 100, 0);
+    update(0, 100, 7);
+    std::vector<BookUpdate> updates;
+    levels.drain([&](const BookUpdate& u) { updates.push_back(u); });
+    ASSERT_EQ(updates.size(), 1u);
+    EXPECT_EQ(updates[0].delta.quantity, 7);
+    EXPECT_EQ(levels.levelCount(), 1u);
+    EXPECT_EQ(levels.conflatedCount(), 2u);
+}
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+
+#ifndef _WIN32
+
+#include <chrono>
+#include <cstddef>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "core/exchange.h"
+#include "core/follower.h"
+
+namespace {
+
+const int INSTRUMENTS = 8;
+
+std::string tempDir(const std::string& name) {
+    auto dir = (std::filesystem::temp_directory_path() / (name + "." + std::to_string(getpid()))).string();
+    std::filesystem::remove_all(dir);
+    return dir;
+}
+
+std::shared_ptr<Journal> smallJournal(const std::string& dir) {
+    JournalConfig config;
+    config.directory = dir;
+    // small segments, so the follower crosses several
+    config.segmentSize = 64 << 10;
+    return std::make_shared<Journal>(config);
+}
+
+/** a random mix of orders, quotes and cancels */
+class Flow {
+    std::mt19937 rng{3};
+    std::vector<std::pair<long, std::string>> live;
+public:
+    void step(Exchange& exchange) {
+        const auto instrument = "SYM" + std::to_string(rng() % INSTRUMENTS);
+        const auto session = "s" + std::to_string(rng() % 4);
+        const auto r = rng() % 10;
+        if (r < 3 && !live.empty()) {
+            auto index = rng() % live.size();
+            exchange.cancel(live[index].first, live[index].second);
+            live[index] = live.back();
+            live.pop_back();
+        } else if (r < 4) {
+            const double mid = 100 + double(rng() % 10);
+            exchange.quote("mm", instrument, mid - 1, 1 + int(rng() % 20), mid + 1, 1 + int(rng() % 20), "q");
+        } else {
+            const double price = 95 + double(rng() % 20);
+            auto id = rng() % 2 ? exchange.buy(session, instrument, price, 1 + int(rng() % 30)) : exchange.sell(session, instrument, price, 1 + int(rng() % 30));
+            if (id) live.emplace_back(*id, session);
+        }
+    }
+};
+
+void expectSameBooks(Exchange& expected, Exchange& actual) {
+    for (int i = 0; i < INSTRUMENTS; i++) {
+        const auto instrument = "SYM" + std::to_string(i);
+        auto a = expected.book(instrument);
+        auto b = actual.book(instrument);
+        ASSERT_EQ(a.has_value(), b.has_value()) << instrument;
+        if (!a) continue;
+        EXPECT_EQ(b->bidOrderIds, a->bidOrderIds) << instrument;
+        EXPECT_EQ(b->askOrderIds, a->askOrderIds) << instrument;
+    }
+}
+
+}
+
+TEST(FollowerTest, FollowsPrimaryInProcess) {
+    const auto dir = tempDir("orderbook_follower_test");
+    auto primary = std::make_unique<Exchange>();
+    primary->setJournal(smallJournal(dir));
+    auto standby = std::make_unique<Exchange>();
+    JournalFollower follower(*standby, dir);
+
+    Flow flow;
+    size_t applied = 0;
+    for (int i = 0; i < 20; i++) {
+        for (int j = 0; j < 500; j++) flow.step(*primary);
+        applied += follower.poll();
+        EXPECT_EQ(follower.applied(), applied);
+        expectSameBooks(*primary, *standby);
+    }
+    EXPECT_GT(Journal::segmentFiles(dir).size(), 2u);
+    EXPECT_EQ(follower.lagHistogram().count(), applied);
+    EXPECT_EQ(follower.poll(), 0u);
+
+    // the standby continues the primary's id sequence
+    follower.promote();
+    EXPECT_EQ(standby->buy("s1", "SYM0", 1, 1), primary->buy("s1", "SYM0", 1, 1));
+    std::filesystem::remove_all(dir);
+}
+
+TEST(FollowerTest, TakesOverWhenPrimaryIsKilled) {
+    const auto dir = tempDir("orderbook_failover_test");
+    const pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        // the primary trades until it is killed
+        auto primary = std::make_unique<Exchange>();
+        primary->setJournal(smallJournal(dir));
+        Flow flow;
+        while (true) flow.step(*primary);
+    }
+
+    auto standby = std::make_unique<Exchange>();
+    JournalFollower follower(*standby, dir);
+    follower.start();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (follower.applied() < 20000 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    kill(child, SIGKILL);
+    int status = 0;
+    waitpid(child, &status, 0);
+    ASSERT_GE(follower.applied(), 20000u);
+    const auto total = follower.promote();
+
+    // the standby has everything the primary journaled before it died, as recovery from the journal would
+    auto recovered = std::make_unique<Exchange>();
+    EXPECT_EQ(recovered->recover(dir), total);
+    expectSameBooks(*recovered, *standby);
+
+    // and takes over: journaling continues and the id sequence is unbroken
+    standby->setJournal(smallJournal(dir));
+    EXPECT_EQ(standby->buy("s1", "SYM0", 1, 1), recovered->buy("s1", "SYM0", 1, 1));
+    auto after = std::make_unique<Exchange>();
+    EXPECT_EQ(after->recover(dir), total + 1);
+    expectSameBooks(*standby, *after);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(FollowerTest, PromoteSkipsTornRecords) {
+    const auto dir = tempDir("orderbook_follower_torn_test");
+    {
+        auto primary = std::make_unique<Exchange>();
+        primary->setJournal(smallJournal(dir));
+        for (int i = 0; i < 3; i++) primary->buy("s1", "SYM0", 99 - i, 1 + i);
+    }
+    // the primary died while writing the second command, another thread completed the third
+    {
+        std::fstream file(Journal::segmentFiles(dir).front(), std::ios::in | std::ios::out | std::ios::binary);
+        JournalRecord first;
+        file.read(reinterpret_cast<char*>(&first), sizeof first);
+        file.seekp(std::streamoff(first.size + offsetof(JournalRecord, complete)));
+        file.put(0);
+    }
+
+    auto standby = std::make_unique<Exchange>();
+    JournalFollower follower(*standby, dir);
+    // still being written as far as the standby knows
+    EXPECT_EQ(follower.poll(), 1u);
+    EXPECT_EQ(follower.poll(), 0u);
+    EXPECT_EQ(follower.promote(), 2u);
+
+    auto recovered = std::make_unique<Exchange>();
+    EXPECT_EQ(recovered->recover(dir), 2u);
+    expectSameBooks(*recovered, *standby);
+    EXPECT_EQ(standby->book("SYM0")->bids.size(), 2u);
+    EXPECT_EQ(standby->buy("s1", "SYM0", 1, 1), recovered->buy("s1", "SYM0", 1, 1));
+    std::filesystem::remove_all(dir);
+}
+
+#endif
@@ -0,0 +1,271 @@
+#include <gtest/gtest.h>
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "core/exchange.h"
+#include "core/journal.h"
+
+static std::string journalDirectory(const char* test) {
+    auto dir = std::filesystem::temp_directory_path() / ("orderbook_journal_test." + std::string(test) + "." + std::to_string(getpid()));
+    std::filesystem::remove_all(dir);
+    return dir.string();
+}
+
+TEST(JournalTest, AppendReplayAcrossSegments) {
+    const auto dir = journalDirectory("Segments");
+    const int threads = 4;
+    const int perThread = 1000;
+    {
+        JournalConfig config;
+        config.directory = dir;
+        config.segmentSize = 4096;
+        config.sync = JournalSync::GROUP;
+        Journal journal(config);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < threads; t++) {
+            writers.emplace_back([&, t]() {
+                for (int i = 0; i < perThread; i++) {
+                    JournalRecord record;
+                    record.type = JournalRecord::BUY;
+                    record.quantity = i;
+                    record.exchangeId = t * perThread + i + 1;
+                    record.price = F(100.5);
+                    journal.append(record, "session" + std::to_string(t), "SYM1", "order");
+                }
+            });
+        }
+        for (auto& writer : writers) writer.join();
+    }
+    EXPECT_GT(Journal::segmentFiles(dir).size(), 10u);
+
+    std::vector<int> next(threads, 0);
+    bool ordered = true;
+    auto count = Journal::replay(dir, [&](const JournalEntry& entry) {
+        int t = entry.sessionId.back() - '0';
+        ordered &= entry.record.quantity == next[size_t(t)]++;
+        ordered &= entry.instrument == "SYM1" && entry.clientId == "order" && entry.record.price == F(100.5);
+    });
+    EXPECT_EQ(count, size_t(threads * perThread));
+    EXPECT_TRUE(ordered);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(JournalTest, TornRecordIsSkipped) {
+    const auto dir = journalDirectory("Torn");
+    {
+        JournalConfig config;
+        config.directory = dir;
+        Journal journal(config);
+        for (int i = 0; i < 3; i++) {
+            JournalRecord record;
+            record.quantity = i;
+            journal.append(record, "session", "SYM1", "order");
+        }
+    }
+    // a crash while the second record was written: sized but never completed
+    const auto segment = Journal::segmentFiles(dir).front();
+    {
+        std::fstream file(segment, std::ios::in | std::ios::out | std::ios::binary);
+        JournalRecord first;
+        file.read(reinterpret_cast<char*>(&first), sizeof first);
+        file.seekp(std::streamoff(first.size + offsetof(JournalRecord, complete)));
+        file.put(0);
+    }
+
+    std::vector<int> quantities;
+    EXPECT_EQ(Journal::replay(dir, [&](const JournalEntry& entry) { quantities.push_back(entry.record.quantity); }), 2u);
+    EXPECT_EQ(quantities, (std::vector<int>{0, 2}));
+    std::filesystem::remove_all(dir);
+}
+
+TEST(JournalTest, ExchangeRecovery) {
+    const auto dir = journalDirectory("Recovery");
+    JournalConfig config;
+    config.directory = dir;
+    Book before;
+    {
+        auto exchange = std::make_unique<Exchange>();
+        exchange->setJournal(std::make_shared<Journal>(config));
+        exchange->buy("s1", "SYM1", 100, 10, "o1");
+        auto o2 = exchange->buy("s1", "SYM1", 101, 5, "o2");
+        exchange->sell("s2", "SYM1", 102, 7, "o3");
+        exchange->sell("s2", "SYM1", 101, 3, "o4");
+        exchange->quote("mm", "SYM1", 99, 20, 103, 20, "q1");
+        exchange->quote("mm", "SYM1", 98, 25, 103, 15, "q1");
+        exchange->cancel(*o2, "s1");
+        before = *exchange->book("SYM1");
+    }
+
+    auto exchange = std::make_unique<Exchange>();
+    EXPECT_EQ(exchange->recover(dir), 7u);
+    auto after = *exchange->book("SYM1");
+    ASSERT_EQ(after.bids.size(), before.bids.size());
+    ASSERT_EQ(after.asks.size(), before.asks.size());
+    EXPECT_EQ(after.bidOrderIds, before.bidOrderIds);
+    EXPECT_EQ(after.askOrderIds, before.askOrderIds);
+    for (size_t i = 0; i < after.bids.size(); i++) EXPECT_EQ(after.bids[i].quantity, before.bids[i].quantity);
+
+    // new ids continue after the recovered ones, the journal continues in a new segment
+    exchange->setJournal(std::make_shared<Journal>(config));
+    auto id = exchange->buy("s1", "SYM1", 90, 1);
+    ASSERT_TRUE(id);
+    EXPECT_EQ(*id, 7);
+    EXPECT_EQ(Journal::segmentFiles(dir).size(), 2u);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(JournalTest, ModifyIsJournaled) {
+    const auto dir = journalDirectory("Modify");
+    JournalConfig config;
+    config.directory = dir;
+    Book before;
+    {
+        auto exchange = std::make_unique<Exchange>();
+        exchange->setJournal(std::make_shared<Journal>(config));
+        auto o1 = exchange->buy("s1", "SYM1", 100, 10, "o1");
+        auto o2 = exchange->buy("s1", "SYM1", 100, 5, "o2");
+        EXPECT_TRUE(exchange->modify(*o1, "s1", 100, 6));
+        EXPECT_FALSE(exchange->modify(*o1, "s2", 100, 2));
+        EXPECT_TRUE(exchange->modify(*o2, "s1", 101, 5));
+        exchange->sell("s2", "SYM1", 101, 2, "o3");
+        before = *exchange->book("SYM1");
+        EXPECT_EQ(before.bidOrderIds, (std::vector<long>{*o2, *o1}));
+        EXPECT_EQ(exchange->getOrder(*o2)->remainingQuantity(), 3);
+    }
+
+    auto exchange = std::make_unique<Exchange>();
+    EXPECT_EQ(exchange->recover(dir), 5u);
+    auto after = *exchange->book("SYM1");
+    EXPECT_EQ(after.bidOrderIds, before.bidOrderIds);
+    ASSERT_EQ(after.bids.size(), before.bids.size());
+    for (size_t i = 0; i < after.bids.size(); i++) EXPECT_EQ(after.bids[i].quantity, before.bids[i].quantity);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(JournalTest, MassQuoteIsJournaled) {
+    const auto dir = journalDirectory("MassQuote");
+    JournalConfig config;
+    config.directory = dir;
+    // the same quotes, one by one and in one massQuote with the instruments interleaved
+    const std::vector<QuoteEntry> entries = {
+        {"SYM2", "q1", 99, 10, 101, 10},
+        {"SYM1", "q1", 49, 5, 51, 5},
+        {"SYM2", "q1", 98, 20, 101, 5},
+        {"SYM1", "q2", 48, -1, 52, 5},
+        {"SYM3", "q1", 0, 0, 10, 3},
+    };
+    auto single = std::make_unique<Exchange>();
+    for (const auto& e : entries) {
+        if (e.bidQuantity >= 0) single->quote("mm", e.instrument, e.bidPrice, e.bidQuantity, e.askPrice, e.askQuantity, e.quoteId);
+    }
+
+    Book before;
+    {
+        auto exchange = std::make_unique<Exchange>();
+        exchange->setJournal(std::make_shared<Journal>(config));
+        std::vector<QuoteStatus> status(entries.size());
+        EXPECT_THROW(exchange->massQuote("mm", entries, std::span(status).first(2)), std::invalid_argument);
+        EXPECT_EQ(exchange->massQuote("mm", entries, status), 4u);
+        EXPECT_EQ(status, (std::vector<QuoteStatus>{QuoteStatus::ACCEPTED, QuoteStatus::ACCEPTED, QuoteStatus::ACCEPTED, QuoteStatus::INVALID, QuoteStatus::ACCEPTED}));
+        for (auto instrument : {"SYM1", "SYM2", "SYM3"}) {
+            auto expected = *single->book(instrument);
+            auto actual = *exchange->book(instrument);
+            ASSERT_EQ(actual.bids.size(), expected.bids.size());
+            ASSERT_EQ(actual.asks.size(), expected.asks.size());
+            for (size_t i = 0; i < actual.bids.size(); i++) EXPECT_EQ(actual.bids[i].quantity, expected.bids[i].quantity);
+            for (size_t i = 0; i < actual.asks.size(); i++) EXPECT_EQ(actual.asks[i].quantity, expected.asks[i].quantity);
+        }
+        EXPECT_EQ(exchange->book("SYM2")->bids[0].quantity, 20);
+        before = *exchange->book("SYM2");
+    }
+
+    auto exchange = std::make_unique<Exchange>();
+    EXPECT_EQ(exchange->recover(dir), 4u);
+    auto after = *exchange->book("SYM2");
+    EXPECT_EQ(after.bidOrderIds, before.bidOrderIds);
+    EXPECT_EQ(after.askOrderIds, before.askOrderIds);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(JournalTest, CloseIsJournaled) {
+    const auto dir = journalDirectory("Close");
+    JournalConfig config;
+    config.directory = dir;
+    Book before;
+    {
+        auto exchange = std::make_unique<Exchange>();
+        exchange->setJournal(std::make_shared<Journal>(config));
+        exchange->buy("s1", "SYM1", 99, 10);
+        exchange->quote("mm", "SYM1", 98, 10, 101, 10, "q");
+        EXPECT_TRUE(exchange->closeInstrument("SYM1"));
+        // a new listing of the name, not the closed book's orders
+        exchange->sell("s1", "SYM1", 100, 5);
+        before = *exchange->book("SYM1");
+    }
+
+    // recovered with a journal attached, which the replayed commands, the close included, do not grow
+    const auto replica = journalDirectory("CloseReplica");
+    config.directory = replica;
+    auto exchange = std::make_unique<Exchange>();
+    exchange->setJournal(std::make_shared<Journal>(config));
+    EXPECT_EQ(exchange->recover(dir), 4u);
+    EXPECT_EQ(Journal::replay(replica, [](const JournalEntry&) {}), 0u);
+    auto after = *exchange->book("SYM1");
+    EXPECT_TRUE(after.bids.empty());
+    EXPECT_EQ(after.askOrderIds, before.askOrderIds);
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove_all(replica);
+}
+
+TEST(JournalTest, CloseRacingNewListing) {
+    const auto dir = journalDirectory("CloseRace");
+    JournalConfig config;
+    config.directory = dir;
+    std::optional<Book> before;
+    std::map<long, bool> cancelledBefore;
+    {
+        auto exchange = std::make_unique<Exchange>();
+        exchange->setJournal(std::make_shared<Journal>(config));
+        // the name is listed again by the next buy after every close, replay must not apply it to the closed book
+        std::atomic<bool> done{false};
+        std::thread closer([&]() {
+            for (int i = 0; i < 500; i++) exchange->closeInstrument("SYM1");
+            done = true;
+        });
+        std::vector<std::thread> buyers;
+        for (int t = 0; t < 3; t++) {
+            buyers.emplace_back([&]() {
+                while (!done) exchange->buy("s1", "SYM1", 99, 1);
+            });
+        }
+        closer.join();
+        for (auto& buyer : buyers) buyer.join();
+        exchange->buy("s1", "SYM1", 99, 1);
+        before = exchange->book("SYM1");
+        for (const auto& order : exchange->getAllOrders()) cancelledBefore[order->exchangeId] = order->isCancelled();
+    }
+
+    auto exchange = std::make_unique<Exchange>();
+    exchange->recover(dir);
+    auto after = exchange->book("SYM1");
+    ASSERT_TRUE(before && after);
+    EXPECT_EQ(after->bidOrderIds, before->bidOrderIds);
+    std::map<long, bool> cancelledAfter;
+    for (const auto& order : exchange->getAllOrders()) cancelledAfter[order->exchangeId] = order->isCancelled();
+    EXPECT_EQ(cancelledAfter, cancelledBefore);
+    std::filesystem::remove_all(dir);
+}
+
+#endif
@@ -1,25 +1,28 @@
 #include <gtest/gtest.h>
 
+#include <array>
+#include <map>
+
 #include "core/order.h"
 #include "core/orderbook.h"
 #include "core/test.h"
 
 TEST(OrderBookTest, OrderbookCancel) {
     OrderBookListener listener;
-    OrderBook ob(dummy_instrument, listener);
+    BasicOrderBook<> ob(std::string(dummy_instrument), listener);
 
-    auto o1 = new TestOrder(1, 100, 10, Order::BUY);
+    auto o1 = TestOrder::create(1, 100, 10, Order::BUY);
     ob.insertOrder(o1);
     ob.cancelOrder(o1);
 
     auto levels = ob.book();
     EXPECT_EQ(levels.bids.size(), 0u);
 
-    auto o2 = new TestOrder(1, 100, 10, Order::BUY);
+    auto o2 = TestOrder::create(1, 100, 10, Order::BUY);
     ob.insertOrder(o2);
-    auto o3 = new TestOrder(1, 90, 10, Order::BUY);
+    auto o3 = TestOrder::create(1, 90, 10, Order::BUY);
     ob.insertOrder(o3);
-    auto o4 = new TestOrder(1, 80, 10, Order::BUY);
+    auto o4 = TestOrder::create(1, 80, 10, Order::BUY);
     ob.insertOrder(o4);
 
     ob.cancelOrder(o3);
@@ -33,9 +36,9 @@ TEST(OrderBookTest, OrderbookCancel) {
 
 TEST(OrderBookTest, Booklevels) {
     OrderBookListener listener;
-    OrderBook ob(dummy_instrument, listener);
+    BasicOrderBook<> ob(std::string(dummy_instrument), listener);
 
-    auto o1 = new TestOrder(1, 100, 10, Order::BUY);
+    auto o1 = TestOrder::create(1, 100, 10, Order::BUY);
     ob.insertOrder(o1);
 
     auto levels = ob.book();
@@ -47,11 +50,11 @@ TEST(OrderBookTest, Booklevels) {
 
 TEST(OrderBookTest, BooklevelsSum) {
     OrderBookListener listener;
-    OrderBook ob(dummy_instrument, listener);
+    BasicOrderBook<> ob(std::string(dummy_instrument), listener);
 
-    auto o1 = new TestOrder(1, 100, 10, Order::BUY);
+    auto o1 = TestOrder::create(1, 100, 10, Order::BUY);
     ob.insertOrder(o1);
-    auto o2 = new TestOrder(2, 100, 10, Order::BUY);
+    auto o2 = TestOrder::create(2, 100, 10, Order::BUY);
     ob.insertOrder(o2);
 
     auto levels = ob.book();
@@ -63,13 +66,13 @@ TEST(OrderBookTest, BooklevelsSum) {
 
 TEST(OrderBookTest, BooklevelsMultiple) {
     OrderBookListener listener;
-    OrderBook ob(dummy_instrument, listener);
+    BasicOrderBook<> ob(std::string(dummy_instrument), listener);
 
-    auto o1 = new TestOrder(1, 100, 10, Order::BUY);
+    auto o1 = TestOrder::create(1, 100, 10, Order::BUY);
     ob.insertOrder(o1);
-    auto o2 = new TestOrder(2, 100, 10, Order::BUY);
+    auto o2 = TestOrder::create(2, 100, 10, Order::BUY);
     ob.insertOrder(o2);
-    auto o3 = new TestOrder(2, 200, 30, Order::BUY);
+    auto o3 = TestOrder::create(2, 200, 30, Order::BUY);
     ob.insertOrder(o3);
 
     auto levels = ob.book();
@@ -83,17 +86,27 @@ TEST(OrderBookTest, BooklevelsMultiple) {
 
 TEST(OrderBookTest, BooklevelsOrder) {
     OrderBookListener listener;
-    OrderBook ob(dummy_instrument, listener);
-
-    ob.insertOrder(new TestOrder(1, 100, 10, Order::BUY));
-    ob.insertOrder(new TestOrder(1, 101, 10, Order::BUY));
-    ob.insertOrder(new TestOrder(1, 99, 10, Order::BUY));
-    ob.insertOrder(new TestOrder(1, 98, 10, Order::BUY));
-
-    ob.insertOrder(new TestOrder(1, 200, 10, Order::SELL));
-    ob.insertOrder(new TestOrder(1, 199, 10, Order::SELL));
-    ob.insertOrder(new TestOrder(1, 201, 10, Order::SELL));
-    ob.insertOrder(new TestOrder(1, 202, 10, Order::SELL));
+    BasicOrderBook<> ob(std::string(dummy_instrument), listener);
+
+    // the book only holds weak references, so the orders must be kept alive by the test
+    std::vector<std::shared_ptr<TestOrder>> orders;
+    orders.push_back(TestOrder::create(1, 100, 10, Order::BUY));
+    ob.insertOrder(orders.back());
+    orders.push_back(TestOrder::create(1, 101, 10, Order::BUY));
+    ob.insertOrder(orders.back());
+    orders.push_back(TestOrder::create(1, 99, 10, Order::BUY));
+    ob.insertOrder(orders.back());
+    orders.push_back(TestOrder::create(1, 98, 10, Order::BUY));
+    ob.insertOrder(orders.back());
+
+    orders.push_back(TestOrder::create(1, 200, 10, Order::SELL));
+    ob.insertOrder(orders.back());
+    orders.push_back(TestOrder::create(1, 199, 10, Order::SELL));
+    ob.insertOrder(orders.back());
+    orders.push_back(TestOrder::create(1, 201, 10, Order::SELL));
+    ob.insertOrder(orders.back());
+    orders.push_back(TestOrder::create(1, 202, 10, Order::SELL));
+    ob.insertOrder(orders.back());
 
     auto levels = ob.book();
 
@@ -140,12 +153,12 @@ TEST(OrderBookTest, SessionQuoteId) {
 
 TEST(OrderBookTest, Quoting) {
     OrderBookListener listener;
-    OrderBook ob(dummy_instrument,listener);
+    BasicOrderBook<> ob(std::string(dummy_instrument), listener);
 
     std::string sessionId("session");
     std::string quoteId("myquote");
 
-    auto quotes = QuoteOrders{new TestOrder(1,100,10,Order::BUY),new TestOrder(2,101,20,Order::SELL)};
+    auto quotes = QuoteOrders{TestOrder::create(1,100,10,Order::BUY),TestOrder::create(2,101,20,Order::SELL)};
 
     ob.quote(quotes,100,10,101,20);
 
@@ -186,3 +199,501 @@ TEST(OrderBookTest, Quoting) {
     EXPECT_EQ(levels.bids.size(), 0u);
     EXPECT_EQ(levels.asks.size(), 0u);
 }
+
+template <typename Levels>
+class OrderBookLevelsTest : public ::testing::Test {};
+
+using LevelTypes = ::testing::Types<DequeuePtrPriceLevels, VectorPtrPriceLevels, VectorPriceLevels, StdMapPriceLevels, StdMapPtrPriceLevels>;
+TYPED_TEST_SUITE(OrderBookLevelsTest, LevelTypes);
+
+TYPED_TEST(OrderBookLevelsTest, MatchAcrossLevels) {
+    struct TradeListener : OrderBookListener {
+        int trades = 0;
+        void onTrade(const Trade& trade) override { trades++; }
+    } listener;
+    BasicOrderBook<TypeParam> ob(std::string(dummy_instrument), listener);
+
+    auto b1 = TestOrder::create(1, 100, 10, Order::BUY);
+    auto b2 = TestOrder::create(2, 99, 10, Order::BUY);
+    auto a1 = TestOrder::create(3, 101, 10, Order::SELL);
+    ob.insertOrder(b1);
+    ob.insertOrder(b2);
+    ob.insertOrder(a1);
+
+    auto s1 = TestOrder::create(4, 99, 15, Order::SELL);
+    ob.insertOrder(s1);
+
+    EXPECT_EQ(listener.trades, 2);
+    EXPECT_TRUE(b1->isFilled());
+    EXPECT_EQ(b2->remainingQuantity(), 5);
+
+    auto book = ob.book();
+    ASSERT_EQ(book.bids.size(), 1u);
+    EXPECT_EQ(book.bids[0].price, 99);
+    EXPECT_EQ(book.bids[0].quantity, 5);
+    ASSERT_EQ(book.asks.size(), 1u);
+    EXPECT_EQ(book.asks[0].price, 101);
+
+    EXPECT_EQ(ob.cancelOrder(b2), 0);
+    EXPECT_EQ(ob.book().bids.size(), 0u);
+}
+
+TYPED_TEST(OrderBookLevelsTest, MarketableOrderRestsResidualOnly) {
+    OrderBookListener listener;
+    InstrumentConfig config;
+    config.orderEventCapacity = 64;
+    BasicOrderBook<TypeParam> ob(std::string(dummy_instrument), listener, config);
+    auto feed = ob.orderEvents();
+
+    auto a1 = TestOrder::create(1, 101, 10, Order::SELL);
+    auto a2 = TestOrder::create(2, 102, 10, Order::SELL);
+    ob.insertOrder(a1);
+    ob.insertOrder(a2);
+
+    // a market order that sweeps more than the book is cancelled without ever creating a level at DBL_MAX
+    auto m1 = TestOrder::create(3, DBL_MAX, 5, Order::BUY);
+    ob.insertOrder(m1);
+    EXPECT_TRUE(m1->isFilled());
+    auto m2 = TestOrder::create(4, DBL_MAX, 20, Order::BUY);
+    ob.insertOrder(m2);
+    EXPECT_EQ(m2->filledQuantity(), 15);
+    EXPECT_FALSE(m2->isOnList());
+    EXPECT_TRUE(ob.book().bids.empty());
+    EXPECT_TRUE(ob.book().asks.empty());
+
+    // a limit order rests only what is left after matching
+    auto a3 = TestOrder::create(5, 100, 4, Order::SELL);
+    ob.insertOrder(a3);
+    auto b1 = TestOrder::create(6, 100, 10, Order::BUY);
+    ob.insertOrder(b1);
+    auto book = ob.book();
+    ASSERT_EQ(book.bids.size(), 1u);
+    EXPECT_EQ(book.bids[0].quantity, 6);
+    EXPECT_EQ(book.bidOrderIds, std::vector<long>{6});
+
+    std::map<long, int> added;
+    feed->drain([&](const OrderEvent& e) {
+        if (e.type == OrderEvent::ADD) added[e.exchangeId] = e.quantity;
+        EXPECT_NE(e.type, OrderEvent::REMOVE);
+    });
+    EXPECT_EQ(added.count(3), 0u);
+    EXPECT_EQ(added.count(4), 0u);
+    EXPECT_EQ(added[6], 6);
+}
+
+TYPED_TEST(OrderBookLevelsTest, DepthIntoBuffers) {
+    OrderBookListener listener;
+    BasicOrderBook<TypeParam> ob(std::string(dummy_instrument), listener);
+
+    std::vector<std::shared_ptr<TestOrder>> orders;
+    for (int i = 0; i < 20; i++) {
+        orders.push_back(TestOrder::create(i * 2 + 1, 100 - i, 10, Order::BUY));
+        orders.push_back(TestOrder::create(i * 2 + 2, 100 - i, 5, Order::BUY));
+        ob.insertOrder(orders[orders.size() - 2]);
+        ob.insertOrder(orders.back());
+    }
+    orders.push_back(TestOrder::create(100, 105, 7, Order::SELL));
+    ob.insertOrder(orders.back());
+
+    std::array<BookLevel, 10> bids;
+    std::array<BookLevel, 10> asks;
+    auto size = ob.depth(bids, asks);
+    ASSERT_EQ(size.bids, 10);
+    ASSERT_EQ(size.asks, 1);
+    for (int i = 0; i < size.bids; i++) {
+        EXPECT_EQ(bids[i].price, 100 - i);
+        EXPECT_EQ(bids[i].quantity, 15);
+    }
+    EXPECT_EQ(asks[0].price, 105);
+    EXPECT_EQ(asks[0].quantity, 7);
+
+    size = ob.depth(std::span<BookLevel>(bids).first(3), {});
+    EXPECT_EQ(size.bids, 3);
+    EXPECT_EQ(size.asks, 0);
+
+    std::array<BookOrder, 5> byOrder;
+    ASSERT_EQ(ob.depthByOrder(Order::BUY, byOrder), 5);
+    EXPECT_EQ(byOrder[0].exchangeId, 1);
+    EXPECT_EQ(byOrder[0].quantity, 10);
+    EXPECT_EQ(byOrder[1].exchangeId, 2);
+    EXPECT_EQ(byOrder[1].quantity, 5);
+    EXPECT_EQ(byOrder[2].exchangeId, 3);
+    EXPECT_EQ(byOrder[2].price, 99);
+    ASSERT_EQ(ob.depthByOrder(Order::SELL, byOrder), 1);
+    EXPECT_EQ(byOrder[0].exchangeId, 100);
+}
+
+TYPED_TEST(OrderBookLevelsTest, BulkLoad) {
+    struct TradeListener : OrderBookListener {
+        int trades = 0;
+        void onTrade(const Trade& trade) override { trades++; }
+    } listener;
+    BasicOrderBook<TypeParam> ob(std::string(dummy_instrument), listener);
+
+    std::vector<std::shared_ptr<Order>> bids = {
+        TestOrder::create(1, 100, 10, Order::BUY), TestOrder::create(2, 100, 5, Order::BUY),
+        TestOrder::create(3, 99, 7, Order::BUY), TestOrder::create(4, 97, 1, Order::BUY), TestOrder::create(5, 97, 2, Order::BUY),
+    };
+    std::vector<std::shared_ptr<Order>> asks = {
+        TestOrder::create(6, 101, 4, Order::SELL), TestOrder::create(7, 102, 8, Order::SELL),
+    };
+    ob.load(bids, asks);
+    EXPECT_EQ(listener.trades, 0);
+
+    auto book = ob.book();
+    ASSERT_EQ(book.bids.size(), 3u);
+    EXPECT_EQ(book.bids[0].quantity, 15);
+    EXPECT_EQ(book.bids[2].price, 97);
+    EXPECT_EQ(book.bids[2].quantity, 3);
+    EXPECT_EQ(book.bidOrderIds, (std::vector<long>{1, 2, 3, 4, 5}));
+    ASSERT_EQ(book.asks.size(), 2u);
+    EXPECT_EQ(book.askOrderIds, (std::vector<long>{6, 7}));
+    EXPECT_EQ(ob.topOfBook(), (TopOfBook{100, 15, 101, 4}));
+
+    // the loaded levels trade in priority order and can be cancelled from
+    auto sell = TestOrder::create(8, 99, 12, Order::SELL);
+    ob.insertOrder(sell);
+    EXPECT_EQ(listener.trades, 2);
+    EXPECT_TRUE(bids[0]->isFilled());
+    EXPECT_EQ(bids[1]->remainingQuantity(), 3);
+    EXPECT_EQ(ob.cancelOrder(bids[3]), 0);
+    book = ob.book();
+    EXPECT_EQ(book.bidOrderIds, (std::vector<long>{2, 3, 5}));
+}
+
+TYPED_TEST(OrderBookLevelsTest, Modify) {
+    struct TradeListener : OrderBookListener {
+        int trades = 0;
+        void onTrade(const Trade& trade) override { trades++; }
+    } listener;
+    InstrumentConfig config;
+    config.orderEventCapacity = 64;
+    BasicOrderBook<TypeParam> ob(std::string(dummy_instrument), listener, config);
+
+    auto b1 = TestOrder::create(1, 100, 10, Order::BUY);
+    auto b2 = TestOrder::create(2, 100, 5, Order::BUY);
+    auto b3 = TestOrder::create(3, 99, 7, Order::BUY);
+    auto a1 = TestOrder::create(4, 102, 6, Order::SELL);
+    for (auto& order : {b1, b2, b3, a1}) ob.insertOrder(order);
+    ob.orderEvents()->drain([](const OrderEvent&) {});
+
+    // a size-down at the same price keeps priority
+    EXPECT_EQ(ob.modifyOrder(b1, 100, 4), 0);
+    auto book = ob.book();
+    EXPECT_EQ(book.bidOrderIds, (std::vector<long>{1, 2, 3}));
+    EXPECT_EQ(book.bids[0].quantity, 9);
+    EXPECT_EQ(b1->quantity(), 4);
+    EXPECT_EQ(b1->remainingQuantity(), 4);
+    std::vector<OrderEvent> events;
+    ob.orderEvents()->drain([&](const OrderEvent& e) { events.push_back(e); });
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].type, OrderEvent::REDUCE);
+    EXPECT_EQ(events[0].quantity, 6);
+    EXPECT_EQ(events[0].remaining, 4);
+
+    // a size-up loses priority
+    EXPECT_EQ(ob.modifyOrder(b1, 100, 8), 0);
+    EXPECT_EQ(ob.book().bidOrderIds, (std::vector<long>{2, 1, 3}));
+    EXPECT_EQ(ob.book().bids[0].quantity, 13);
+
+    // a new price moves the same order to the back of the new level
+    const Order* before = b2.get();
+    EXPECT_EQ(ob.modifyOrder(b2, 99, 5), 0);
+    book = ob.book();
+    EXPECT_EQ(book.bidOrderIds, (std::vector<long>{1, 3, 2}));
+    ASSERT_EQ(book.bids.size(), 2u);
+    EXPECT_EQ(book.bids[1].quantity, 12);
+    EXPECT_EQ(b2.get(), before);
+    EXPECT_EQ(b2->price(), 99);
+
+    // repricing through the offer trades
+    EXPECT_EQ(ob.modifyOrder(b3, 102, 7), 0);
+    EXPECT_EQ(listener.trades, 1);
+    EXPECT_EQ(a1->remainingQuantity(), 0);
+    EXPECT_EQ(b3->remainingQuantity(), 1);
+    EXPECT_EQ(ob.topOfBook(), (TopOfBook{102, 1, 0, 0}));
+
+    // reducing to the filled quantity is a cancel
+    EXPECT_EQ(ob.modifyOrder(b3, 102, 6), 0);
+    EXPECT_TRUE(b3->isCancelled());
+    EXPECT_EQ(ob.book().bidOrderIds, (std::vector<long>{1, 2}));
+
+    EXPECT_EQ(ob.modifyOrder(b3, 100, 10), -1);
+    EXPECT_EQ(ob.modifyOrder(b1, 100, 0), -1);
+}
+
+TYPED_TEST(OrderBookLevelsTest, QuoteRefresh) {
+    struct TradeListener : OrderBookListener {
+        int trades = 0;
+        void onTrade(const Trade& trade) override { trades++; }
+    } listener;
+    InstrumentConfig config;
+    config.orderEventCapacity = 64;
+    BasicOrderBook<TypeParam> ob(std::string(dummy_instrument), listener, config);
+    std::vector<OrderEvent> events;
+    auto drain = [&]() {
+        events.clear();
+        ob.orderEvents()->drain([&](const OrderEvent& e) { events.push_back(e); });
+    };
+
+    auto quotes = QuoteOrders{TestOrder::create(1, 100, 10, Order::BUY), TestOrder::create(2, 105, 10, Order::SELL)};
+    ob.quote(quotes, 100, 10, 105, 10);
+    auto b1 = TestOrder::create(3, 100, 5, Order::BUY);
+    auto b2 = TestOrder::create(4, 98, 5, Order::BUY);
+    ob.insertOrder(b1);
+    ob.insertOrder(b2);
+    drain();
+
+    // unchanged, and size down at the same price: in place, the quote keeps its priority
+    ob.quote(quotes, 100, 10, 105, 10);
+    drain();
+    EXPECT_TRUE(events.empty());
+    ob.quote(quotes, 100, 6, 105, 10);
+    drain();
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].type, OrderEvent::REDUCE);
+    EXPECT_EQ(events[0].quantity, 4);
+    auto book = ob.book();
+    EXPECT_EQ(book.bidOrderIds, (std::vector<long>{1, 3, 4}));
+    EXPECT_EQ(book.bids[0].quantity, 11);
+
+    // size up loses priority
+    ob.quote(quotes, 100, 8, 105, 10);
+    EXPECT_EQ(ob.book().bidOrderIds, (std::vector<long>{3, 1, 4}));
+
+    // the ask alone on its level moves between its neighbours, and to an existing level
+    ob.quote(quotes, 100, 8, 104, 7);
+    book = ob.book();
+    ASSERT_EQ(book.asks.size(), 1u);
+    EXPECT_EQ(book.asks[0].price, 104);
+    EXPECT_EQ(book.asks[0].quantity, 7);
+    ob.quote(quotes, 98, 8, 104, 7);
+    book = ob.book();
+    ASSERT_EQ(book.bids.size(), 2u);
+    EXPECT_EQ(book.bids[1].price, 98);
+    EXPECT_EQ(book.bids[1].quantity, 13);
+    EXPECT_EQ(book.bidOrderIds, (std::vector<long>{3, 4, 1}));
+
+    // crossing matches once, against the resting bids in priority order
+    ob.quote(quotes, 0, 0, 98, 12);
+    EXPECT_EQ(listener.trades, 2);
+    EXPECT_TRUE(b1->isFilled());
+    EXPECT_EQ(b2->remainingQuantity(), 0);
+    EXPECT_EQ(quotes.ask->remainingQuantity(), 2);
+    EXPECT_FALSE(quotes.bid->isOnList());
+    EXPECT_EQ(ob.topOfBook(), (TopOfBook{0, 0, 98, 2}));
+}
+
+TEST(OrderBookTest, BulkLoadValidation) {
+    OrderBookListener listener;
+    BasicOrderBook<> ob(std::string(dummy_instrument), listener);
+    std::vector<std::shared_ptr<Order>> outOfOrder = {TestOrder::create(1, 99, 10, Order::BUY), TestOrder::create(2, 100, 10, Order::BUY)};
+    EXPECT_THROW(ob.load(outOfOrder, {}), std::invalid_argument);
+    std::vector<std::shared_ptr<Order>> wrongSide = {TestOrder::create(3, 100, 10, Order::SELL)};
+    EXPECT_THROW(ob.load(wrongSide, {}), std::invalid_argument);
+    std::vector<std::shared_ptr<Order>> bids = {TestOrder::create(4, 100, 10, Order::BUY)};
+    std::vector<std::shared_ptr<Order>> crossing = {TestOrder::create(5, 100, 10, Order::SELL)};
+    EXPECT_THROW(ob.load(bids, crossing), std::invalid_argument);
+    EXPECT_TRUE(ob.book().bids.empty());
+    EXPECT_TRUE(ob.book().asks.empty());
+
+    ob.load(bids, {});
+    EXPECT_THROW(ob.load({}, std::vector<std::shared_ptr<Order>>{TestOrder::create(6, 101, 10, Order::SELL)}), std::invalid_argument);
+    EXPECT_EQ(ob.book().bids.size(), 1u);
+}
+
+TEST(OrderBookTest, CreateFromInstrumentConfig) {
+    OrderBookListener listener;
+    for (auto type : {PriceLevelsType::DEQUE_PTR, PriceLevelsType::VECTOR_PTR, PriceLevelsType::VECTOR, PriceLevelsType::STD_MAP, PriceLevelsType::STD_MAP_PTR}) {
+        auto ob = OrderBook::create("SYM1", listener, InstrumentConfig{.levels = type});
+        ASSERT_NE(ob, nullptr);
+        EXPECT_EQ(ob->instrument, "SYM1");
+
+        auto order = TestOrder::create(1, 100, 10, Order::BUY);
+        ob->insertOrder(order);
+        auto book = ob->book();
+        ASSERT_EQ(book.bids.size(), 1u);
+        EXPECT_EQ(book.bids[0].quantity, 10);
+    }
+    EXPECT_NE(dynamic_cast<BasicOrderBook<StdMapPriceLevels>*>(OrderBook::create("SYM1", listener, {.levels = PriceLevelsType::STD_MAP}).get()), nullptr);
+}
+
+TEST(OrderBookTest, TopOfBook) {
+    OrderBookListener listener;
+    BasicOrderBook<> ob(std::string(dummy_instrument), listener);
+
+    auto top = ob.topOfBook();
+    EXPECT_EQ(top.bidQuantity, 0);
+    EXPECT_EQ(top.askQuantity, 0);
+
+    auto b1 = TestOrder::create(1, 100, 10, Order::BUY);
+    auto b2 = TestOrder::create(2, 100, 5, Order::BUY);
+    auto b3 = TestOrder::create(3, 99, 7, Order::BUY);
+    auto a1 = TestOrder::create(4, 101, 20, Order::SELL);
+    ob.insertOrder(b1);
+    ob.insertOrder(b2);
+    ob.insertOrder(b3);
+    ob.insertOrder(a1);
+
+    top = ob.topOfBook();
+    EXPECT_EQ(top.bidPrice, 100);
+    EXPECT_EQ(top.bidQuantity, 15);
+    EXPECT_EQ(top.askPrice, 101);
+    EXPECT_EQ(top.askQuantity, 20);
+
+    // partial fill of the best bid level
+    auto s1 = TestOrder::create(5, 100, 12, Order::SELL);
+    ob.insertOrder(s1);
+    top = ob.topOfBook();
+    EXPECT_EQ(top.bidPrice, 100);
+    EXPECT_EQ(top.bidQuantity, 3);
+
+    ob.cancelOrder(b2);
+    top = ob.topOfBook();
+    EXPECT_EQ(top.bidPrice, 99);
+    EXPECT_EQ(top.bidQuantity, 7);
+
+    auto quotes = QuoteOrders{TestOrder::create(6, 99, 1, Order::BUY), TestOrder::create(7, 100, 2, Order::SELL)};
+    ob.quote(quotes, 99, 1, 100, 2);
+    top = ob.topOfBook();
+    EXPECT_EQ(top.bidQuantity, 8);
+    EXPECT_EQ(top.askPrice, 100);
+    EXPECT_EQ(top.askQuantity, 2);
+
+    EXPECT_EQ(top.bidQuantity, ob.book().bids[0].quantity);
+}
+
+TYPED_TEST(OrderBookLevelsTest, LevelDeltas) {
+    OrderBookListener listener;
+    InstrumentConfig config;
+    config.levelDeltaCapacity = 16;
+    BasicOrderBook<TypeParam> ob(std::string(dummy_instrument), listener, config);
+    auto feed = ob.levelDeltas();
+    ASSERT_NE(feed, nullptr);
+
+    std::vector<LevelDelta> deltas;
+    auto drain = [&]() {
+        deltas.clear();
+        feed->drain([&](const LevelDelta& delta) { deltas.push_back(delta); });
+    };
+
+    auto b1 = TestOrder::create(1, 100, 10, Order::BUY);
+    auto b2 = TestOrder::create(2, 100, 5, Order::BUY);
+    auto b3 = TestOrder::create(3, 99, 7, Order::BUY);
+    ob.insertOrder(b1);
+    ob.insertOrder(b2);
+    ob.insertOrder(b3);
+    drain();
+    ASSERT_EQ(deltas.size(), 3u);
+    EXPECT_EQ(deltas[0].sequence, 1u);
+    EXPECT_EQ(deltas[1].price, 100);
+    EXPECT_EQ(deltas[1].quantity, 15);
+    EXPECT_EQ(deltas[2].sequence, 3u);
+    EXPECT_EQ(deltas[2].side, Order::BUY);
+
+    // sweeps level 100 and part of 99, the fills of b1 and b2 are coalesced into a single delta
+    auto s1 = TestOrder::create(4, 99, 17, Order::SELL);
+    ob.insertOrder(s1);
+    drain();
+    ASSERT_EQ(deltas.size(), 2u);
+    EXPECT_EQ(deltas[0].price, 100);
+    EXPECT_EQ(deltas[0].quantity, 0);
+    EXPECT_EQ(deltas[1].price, 99);
+    EXPECT_EQ(deltas[1].quantity, 5);
+    EXPECT_EQ(deltas[1].sequence, 5u);
+
+    ob.cancelOrder(b3);
+    drain();
+    ASSERT_EQ(deltas.size(), 1u);
+    EXPECT_EQ(deltas[0].quantity, 0);
+
+    auto quotes = QuoteOrders{TestOrder::create(5, 98, 1, Order::BUY), TestOrder::create(6, 102, 2, Order::SELL)};
+    ob.quote(quotes, 98, 1, 102, 2);
+    ob.quote(quotes, 98, 3, 102, 2);
+    drain();
+    // the unchanged ask is not touched by the second quote
+    ASSERT_EQ(deltas.size(), 3u);
+    EXPECT_EQ(deltas[1].side, Order::SELL);
+    EXPECT_EQ(deltas[2].price, 98);
+    EXPECT_EQ(deltas[2].quantity, 3);
+    EXPECT_EQ(ob.levelDeltasDropped(), 0u);
+
+    // overflow is counted and visible to the consumer as a sequence gap
+    std::vector<std::shared_ptr<TestOrder>> orders;
+    for (int i = 0; i < 20; i++) {
+        orders.push_back(TestOrder::create(10 + i, 50 - i, 1, Order::BUY));
+        ob.insertOrder(orders.back());
+    }
+    EXPECT_EQ(ob.levelDeltasDropped(), 4u);
+    drain();
+    ob.insertOrder(orders.emplace_back(TestOrder::create(30, 10, 1, Order::BUY)));
+    drain();
+    ASSERT_EQ(deltas.size(), 1u);
+    EXPECT_EQ(deltas[0].sequence, 30u);
+
+    BasicOrderBook<TypeParam> disabled(std::string(dummy_instrument), listener);
+    EXPECT_EQ(disabled.levelDeltas(), nullptr);
+}
+
+TYPED_TEST(OrderBookLevelsTest, OrderEvents) {
+    OrderBookListener listener;
+    InstrumentConfig config;
+    config.orderEventCapacity = 64;
+    BasicOrderBook<TypeParam> ob(std::string(dummy_instrument), listener, config);
+    auto feed = ob.orderEvents();
+    ASSERT_NE(feed, nullptr);
+
+    std::vector<std::shared_ptr<TestOrder>> orders;
+    auto insert = [&](long id, double price, int quantity, Order::Side side) {
+        orders.push_back(TestOrder::create(id, price, quantity, side));
+        ob.insertOrder(orders.back());
+    };
+    insert(1, 100, 10, Order::BUY);
+    insert(2, 100, 5, Order::BUY);
+    insert(3, 99, 7, Order::BUY);
+    insert(4, 100, 12, Order::SELL);
+    ob.cancelOrder(orders[2]);
+    auto quotes = QuoteOrders{TestOrder::create(5, 98, 1, Order::BUY), TestOrder::create(6, 102, 2, Order::SELL)};
+    ob.quote(quotes, 98, 1, 102, 2);
+    ob.quote(quotes, 97, 4, 102, 2);
+
+    std::vector<OrderEvent> events;
+    feed->drain([&](const OrderEvent& e) { events.push_back(e); });
+    // the second quote moves the bid and leaves the ask alone
+    ASSERT_EQ(events.size(), 12u);
+    for (size_t i = 0; i < events.size(); i++) EXPECT_EQ(events[i].sequence, i + 1);
+
+    // the sell of 12 fills order 1 and 2 of order 2 without being added, the resting order executes first
+    EXPECT_EQ(events[3].type, OrderEvent::EXECUTE);
+    EXPECT_EQ(events[3].exchangeId, 1);
+    EXPECT_EQ(events[3].quantity, 10);
+    EXPECT_EQ(events[3].remaining, 0);
+    EXPECT_EQ(events[4].exchangeId, 4);
+    EXPECT_EQ(events[4].remaining, 2);
+    EXPECT_EQ(events[5].exchangeId, 2);
+    EXPECT_EQ(events[5].remaining, 3);
+    EXPECT_EQ(events[6].exchangeId, 4);
+    EXPECT_EQ(events[6].remaining, 0);
+    EXPECT_EQ(events[7].type, OrderEvent::REMOVE);
+    EXPECT_EQ(events[7].exchangeId, 3);
+    EXPECT_EQ(events[7].quantity, 7);
+
+    // replaying the stream reproduces the resting orders
+    std::map<long, OrderEvent> resting;
+    for (auto& e : events) {
+        switch (e.type) {
+            case OrderEvent::ADD: resting[e.exchangeId] = e; break;
+            case OrderEvent::REMOVE: resting.erase(e.exchangeId); break;
+            default:
+                if (e.remaining == 0) resting.erase(e.exchangeId);
+                else resting[e.exchangeId].quantity = e.remaining;
+        }
+    }
+    std::array<BookOrder, 8> bids;
+    ASSERT_EQ(ob.depthByOrder(Order::BUY, bids), 2);
+    ASSERT_EQ(resting.count(bids[0].exchangeId), 1u);
+    EXPECT_EQ(resting[bids[0].exchangeId].quantity, bids[0].quantity);
+    EXPECT_EQ(resting[5].price, 97);
+    EXPECT_EQ(resting.size(), 3u);
+    EXPECT_EQ(ob.orderEventsDropped(), 0u);
+}
@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "core/exchange.h"
+#include "core/protection.h"
+#include "core/replay.h"
+#include "core/test.h"
+
+using namespace std::chrono_literals;
+
+TEST(ProtectionTest, Window) {
+    SessionProtection protection("mm");
+    // disabled until configured
+    EXPECT_FALSE(protection.onFill(0, 1000));
+
+    protection.configure({100ns, 10, 0});
+    EXPECT_FALSE(protection.onFill(0, 6));
+    // the first fill left the window
+    EXPECT_FALSE(protection.onFill(100, 6));
+    EXPECT_TRUE(protection.onFill(150, 4));
+    EXPECT_TRUE(protection.isTripped());
+    EXPECT_FALSE(protection.onFill(160, 100));
+    EXPECT_EQ(protection.tripCount(), 1u);
+
+    // re-armed with an empty window, the ring grows past its initial size
+    protection.configure({1000ns, 0, 40});
+    EXPECT_FALSE(protection.isTripped());
+    for (int i = 0; i < 39; i++) EXPECT_FALSE(protection.onFill(200 + i, 1));
+    EXPECT_TRUE(protection.onFill(300, 1));
+    EXPECT_EQ(protection.tripCount(), 2u);
+}
+
+namespace {
+struct TripListener : ExchangeListener {
+    std::vector<std::string> trips;
+    void onProtectionTrip(std::string_view sessionId) override {
+        trips.emplace_back(sessionId);
+    }
+};
+}
+
+TEST(ProtectionTest, PullsEveryQuoteOfTheSession) {
+    TripListener listener;
+    auto exchange = std::make_unique<Exchange>(listener);
+    exchange->setProtection("mm", {1s, 10, 0});
+    for (auto instrument : {"SYM1", "SYM2", "SYM3"}) {
+        exchange->quote("mm", instrument, 99, 10, 101, 10, "q");
+        exchange->quote("other", instrument, 98, 10, 102, 10, "q");
+    }
+
+    exchange->sell("s1", "SYM1", 99, 6);
+    EXPECT_FALSE(exchange->isProtectionTripped("mm"));
+    exchange->buy("s1", "SYM2", 101, 5);
+    EXPECT_TRUE(exchange->isProtectionTripped("mm"));
+    EXPECT_EQ(listener.trips, std::vector<std::string>{"mm"});
+    // only the other session's quotes remain
+    for (auto instrument : {"SYM1", "SYM2", "SYM3"}) {
+        auto top = *exchange->topOfBook(instrument);
+        EXPECT_EQ(top.bidPrice, F(98)) << instrument;
+        EXPECT_EQ(top.askPrice, F(102)) << instrument;
+    }
+
+    // rejected until re-armed, a new quote takes no ids
+    const auto orders = std::ranges::distance(exchange->getAllOrders());
+    exchange->quote("mm", "SYM1", 99, 10, 101, 10, "q");
+    exchange->quote("mm", "SYM1", 99, 10, 101, 10, "new");
+    EXPECT_EQ(exchange->topOfBook("SYM1")->bidPrice, F(98));
+    const QuoteEntry entries[] = {{"SYM2", "q", 99, 10, 101, 10}, {"SYM3", "new", 99, 10, 101, 10}};
+    QuoteStatus status[2];
+    EXPECT_EQ(exchange->massQuote("mm", entries, status), 0u);
+    EXPECT_EQ(status[0], QuoteStatus::PROTECTED);
+    EXPECT_EQ(status[1], QuoteStatus::PROTECTED);
+    EXPECT_EQ(std::ranges::distance(exchange->getAllOrders()), orders);
+    EXPECT_EQ(*exchange->buy("s1", "SYM1", 90, 1), orders + 1);
+
+    exchange->setProtection("mm", {1s, 10, 0});
+    exchange->quote("mm", "SYM1", 99, 10, 101, 10, "q");
+    EXPECT_EQ(exchange->topOfBook("SYM1")->bidPrice, F(99));
+}
+
+TEST(ProtectionTest, TrippedQuotesAreNotTraded) {
+    auto exchange = std::make_unique<Exchange>();
+    exchange->setProtection("mm", {1s, 0, 1});
+    exchange->quote("mm", "SYM1", 99, 10, 101, 5, "q1");
+    exchange->quote("mm", "SYM1", 98, 10, 102, 5, "q2");
+
+    // the first fill tripped, the sweep stopped at the session's next quote
+    auto buy = exchange->buy("s1", "SYM1", 102, 8);
+    ASSERT_TRUE(buy);
+    EXPECT_EQ(exchange->getOrder(*buy)->filledQuantity(), 5);
+    auto book = *exchange->book("SYM1");
+    ASSERT_EQ(book.bids.size(), 1u);
+    EXPECT_EQ(book.bids[0].price, F(102));
+    EXPECT_EQ(book.bids[0].quantity, 3);
+    EXPECT_TRUE(book.asks.empty());
+}
+
+TEST(ProtectionTest, TracksOnlyRestingQuotes) {
+    OrderBookListener listener;
+    auto book = OrderBook::create("SYM1", listener);
+    SessionProtection protection("mm");
+    auto resting = [&]() {
+        std::vector<std::shared_ptr<Order>> quotes;
+        protection.restingQuotes(quotes);
+        return quotes.size();
+    };
+    const QuoteOrders q1{TestOrder::create(1, 99, 10, Order::BUY), TestOrder::create(2, 101, 10, Order::SELL)};
+    const QuoteOrders q2{TestOrder::create(3, 98, 10, Order::BUY), TestOrder::create(4, 102, 10, Order::SELL)};
+    for (const auto& order : {q1.bid, q1.ask, q2.bid, q2.ask}) {
+        order->_isQuote = true;
+        protection.add(*order);
+    }
+    EXPECT_EQ(resting(), 0u);
+    book->quote(q1, 99, 10, 101, 10);
+    book->quote(q2, 98, 10, 102, 10);
+    EXPECT_EQ(resting(), 4u);
+
+    // filled
+    auto sell = TestOrder::create(5, 99, 10, Order::SELL);
+    book->insertOrder(sell);
+    EXPECT_EQ(resting(), 3u);
+    // replaced by an empty side
+    book->quote(q2, 0, 0, 102, 10);
+    EXPECT_EQ(resting(), 2u);
+    // cancelled
+    book->cancelOrder(q1.ask);
+    EXPECT_EQ(resting(), 1u);
+    // moved to a new level
+    book->quote(q2, 0, 0, 103, 10);
+    EXPECT_EQ(resting(), 1u);
+    book->quote(q1, 97, 10, 0, 0);
+    EXPECT_EQ(resting(), 2u);
+}
+
+#ifndef _WIN32
+
+TEST(ProtectionTest, Journaled) {
+    const auto dir = (std::filesystem::temp_directory_path() / ("orderbook_protection_test." + std::to_string(getpid()))).string();
+    std::filesystem::remove_all(dir);
+    JournalConfig config;
+    config.directory = dir;
+    Book before;
+    {
+        auto exchange = std::make_unique<Exchange>();
+        exchange->setJournal(std::make_shared<Journal>(config));
+        exchange->setProtection("mm", {1s, 5, 0});
+        exchange->quote("mm", "SYM1", 99, 10, 101, 10, "q");
+        exchange->quote("mm", "SYM2", 99, 10, 101, 10, "q");
+        exchange->sell("s1", "SYM1", 99, 5);
+        exchange->quote("mm", "SYM2", 99, 20, 101, 20, "q");
+        exchange->buy("s1", "SYM2", 101, 1);
+        before = *exchange->book("SYM2");
+        EXPECT_TRUE(before.asks.empty());
+        ASSERT_EQ(before.bids.size(), 1u);
+    }
+
+    // both quotes were pulled after the trip, the bid on SYM1 with the rest the sell left
+    size_t pulls = 0;
+    Journal::replay(dir, [&](const JournalEntry& entry) {
+        if (entry.record.type == JournalRecord::PULL) pulls++;
+    });
+    EXPECT_EQ(pulls, 4u);
+
+    auto exchange = std::make_unique<Exchange>();
+    // the rejected quote was not journaled
+    EXPECT_EQ(exchange->recover(dir), 9u);
+    EXPECT_TRUE(exchange->isProtectionTripped("mm"));
+    auto after = *exchange->book("SYM2");
+    EXPECT_EQ(after.bidOrderIds, before.bidOrderIds);
+    EXPECT_EQ(after.askOrderIds, before.askOrderIds);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ProtectionTest, ReplaysJournaledPulls) {
+    const auto dir = (std::filesystem::temp_directory_path() / ("orderbook_protection_pulls_test." + std::to_string(getpid()))).string();
+    std::filesystem::remove_all(dir);
+    JournalConfig config;
+    config.directory = dir;
+    {
+        // as journaled by a trip on SYM1 racing a buy on SYM2: the buy traded the quote on SYM2 before the trip's
+        // pulls reached that book
+        Journal journal(config);
+        int64_t time = 1000;
+        auto append = [&](JournalRecord::Type type, const char* sessionId, const char* instrument, long id, int quantity, F price, long askId = 0, int askQuantity = 0, F askPrice = 0) {
+            JournalRecord record;
+            record.type = type;
+            record.exchangeId = id;
+            record.quantity = quantity;
+            record.price = price;
+            record.askExchangeId = askId;
+            record.askQuantity = askQuantity;
+            record.askPrice = askPrice;
+            record.timestamp = time++;
+            journal.append(record, sessionId, instrument, type == JournalRecord::QUOTE ? "q" : "");
+        };
+        append(JournalRecord::PROTECT, "mm", "", 0, 5, 0, 1000000000);
+        append(JournalRecord::QUOTE, "mm", "SYM1", 1, 10, 99, 2, 10, 101);
+        append(JournalRecord::QUOTE, "mm", "SYM2", 3, 10, 99, 4, 10, 101);
+        append(JournalRecord::SELL, "s1", "SYM1", 5, 5, 99);
+        append(JournalRecord::BUY, "s1", "SYM2", 6, 3, 101);
+        append(JournalRecord::PULL, "mm", "SYM1", 1, 0, 0);
+        append(JournalRecord::PULL, "mm", "SYM1", 2, 0, 0);
+        append(JournalRecord::PULL, "mm", "SYM2", 3, 0, 0);
+        append(JournalRecord::PULL, "mm", "SYM2", 4, 0, 0);
+    }
+
+    auto check = [](Exchange& exchange) {
+        EXPECT_TRUE(exchange.isProtectionTripped("mm"));
+        for (const char* instrument : {"SYM1", "SYM2"}) {
+            auto book = *exchange.book(instrument);
+            EXPECT_TRUE(book.bids.empty()) << instrument;
+            EXPECT_TRUE(book.asks.empty()) << instrument;
+        }
+        // the buy traded the ask instead of resting behind a pulled quote
+        EXPECT_EQ(exchange.getOrder(6)->filledQuantity(), 3);
+    };
+    auto exchange = std::make_unique<Exchange>();
+    EXPECT_EQ(exchange->recover(dir), 9u);
+    check(*exchange);
+
+    JournalReplay replay;
+    auto report = replay.run(dir);
+    EXPECT_EQ(report.trades, 2u);
+    EXPECT_EQ(report.latency[ReplayReport::PULL].count(), 4u);
+    check(replay.exchange());
+    std::filesystem::remove_all(dir);
+}
+
+#endif
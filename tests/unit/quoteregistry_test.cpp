@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "core/quoteregistry.h"
+
+TEST(QuoteRegistryTest, StringInterner) {
+    StringInterner interner;
+    EXPECT_EQ(interner.find("a"), StringInterner::NONE);
+    EXPECT_EQ(interner.intern("a"), 0u);
+    EXPECT_EQ(interner.intern("b"), 1u);
+    EXPECT_EQ(interner.intern(std::string("a")), 0u);
+    EXPECT_EQ(interner.find("b"), 1u);
+    EXPECT_EQ(interner[1], "b");
+
+    // ids stay the same as the table grows
+    for (int i = 0; i < 1000; i++) EXPECT_EQ(interner.intern("s" + std::to_string(i)), uint32_t(i + 2));
+    for (int i = 0; i < 1000; i++) EXPECT_EQ(interner.find("s" + std::to_string(i)), uint32_t(i + 2));
+    EXPECT_EQ(interner.find("a"), 0u);
+    EXPECT_EQ(interner.size(), 1002u);
+}
+
+TEST(QuoteRegistryTest, GetOrCreate) {
+    QuoteRegistry quotes;
+    int created = 0;
+    auto create = [&]() {
+        created++;
+        return QuoteOrders{Order::create("s", "q", "SYM", 100, 1, Order::BUY, created), nullptr};
+    };
+    EXPECT_EQ(quotes.find("s1", "q1"), nullptr);
+    const auto bid = quotes.getOrCreate("s1", "q1", create).bid;
+    EXPECT_EQ(quotes.getOrCreate("s1", "q1", create).bid, bid);
+    EXPECT_EQ(created, 1);
+    // the same ids in other combinations are other quotes
+    quotes.getOrCreate("s1", "q2", create);
+    quotes.getOrCreate("s2", "q1", create);
+    EXPECT_EQ(created, 3);
+    ASSERT_NE(quotes.find("s2", "q1"), nullptr);
+    EXPECT_EQ(quotes.find("s2", "q1")->bid->exchangeId, 3);
+    EXPECT_EQ(quotes.find("s2", "q2"), nullptr);
+
+    for (int i = 0; i < 1000; i++) quotes.getOrCreate("s" + std::to_string(i % 7), "q" + std::to_string(i), create);
+    EXPECT_EQ(quotes.find("s1", "q1")->bid, bid);
+    EXPECT_EQ(quotes.size(), size_t(created));
+
+    // creation order
+    std::vector<std::string> keys;
+    quotes.forEach([&](std::string_view session, std::string_view quoteId, const QuoteOrders&) {
+        if (keys.size() < 3) keys.push_back(std::string(session) + ":" + std::string(quoteId));
+    });
+    EXPECT_EQ(keys, (std::vector<std::string>{"s1:q1", "s1:q2", "s2:q1"}));
+}
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "core/exchange.h"
+#include "core/replay.h"
+
+TEST(ReplayTest, InjectedClockAndIds) {
+    struct Trades : ExchangeListener {
+        std::vector<long> execIds;
+        void onTrade(const Trade& trade) override { execIds.push_back(trade.execId); }
+    } listener;
+    auto exchange = std::make_unique<Exchange>(listener);
+    long time = 1000;
+    long nextId = 500;
+    exchange->setClock([&]() { return std::chrono::nanoseconds(time); });
+    exchange->setIdGenerator([&]() { return nextId += 10; });
+
+    EXPECT_EQ(exchange->buy("s1", "SYM1", 100, 10), 510);
+    time = 2000;
+    EXPECT_EQ(exchange->sell("s2", "SYM1", 100, 4), 520);
+    ASSERT_EQ(listener.execIds.size(), 1u);
+    EXPECT_EQ(listener.execIds[0], 2000);
+}
+
+#ifndef _WIN32
+
+#include <filesystem>
+#include <map>
+#include <random>
+#include <unistd.h>
+
+TEST(ReplayTest, ReplayReproducesTradesAndIds) {
+    const auto dir = (std::filesystem::temp_directory_path() / ("orderbook_replay_test." + std::to_string(getpid()))).string();
+    std::filesystem::remove_all(dir);
+    TradeDigest recorded;
+    Book before;
+    {
+        auto exchange = std::make_unique<Exchange>(recorded);
+        JournalConfig config;
+        config.directory = dir;
+        exchange->setJournal(std::make_shared<Journal>(config));
+        auto o1 = exchange->buy("s1", "SYM1", 100, 10, "o1");
+        exchange->buy("s1", "SYM1", 101, 5, "o2");
+        exchange->quote("mm", "SYM1", 99, 20, 103, 20, "q1");
+        exchange->sell("s2", "SYM1", 100, 12, "o3");
+        exchange->cancel(*o1, "s1");
+        exchange->quote("mm", "SYM1", 98, 25, 102, 15, "q1");
+        exchange->buy("s3", "SYM2", 50, 5, "o4");
+        exchange->buy("s3", "SYM1", 103, 30, "o5");
+        before = *exchange->book("SYM1");
+    }
+    ASSERT_GT(recorded.count(), 0u);
+
+    JournalReplay replay;
+    auto report = replay.run(dir);
+    EXPECT_EQ(report.commands, 8u);
+    EXPECT_EQ(report.trades, recorded.count());
+    EXPECT_EQ(report.digest, recorded.value());
+    EXPECT_EQ(report.latency[ReplayReport::ORDER].count(), 5u);
+    EXPECT_EQ(report.latency[ReplayReport::QUOTE].count(), 2u);
+    EXPECT_EQ(report.latency[ReplayReport::CANCEL].count(), 1u);
+
+    auto after = *replay.exchange().book("SYM1");
+    EXPECT_EQ(after.bidOrderIds, before.bidOrderIds);
+    EXPECT_EQ(after.askOrderIds, before.askOrderIds);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ReplayTest, ParallelReplayIsDeterministic) {
+    const auto dir = (std::filesystem::temp_directory_path() / ("orderbook_parallel_replay_test." + std::to_string(getpid()))).string();
+    std::filesystem::remove_all(dir);
+    struct PerInstrument : ExchangeListener {
+        std::map<std::string, TradeDigest> digests;
+        void onTrade(const Trade& trade) override { digests[trade.aggressor.instrument].onTrade(trade); }
+    } recorded;
+    std::map<std::string, Book> before;
+    {
+        auto exchange = std::make_unique<Exchange>(recorded);
+        JournalConfig config;
+        config.directory = dir;
+        exchange->setJournal(std::make_shared<Journal>(config));
+        std::mt19937 rng(11);
+        std::vector<std::pair<long, std::string>> live;
+        for (int i = 0; i < 20000; i++) {
+            const auto instrument = "SYM" + std::to_string(rng() % 40);
+            const auto session = "s" + std::to_string(rng() % 4);
+            const auto r = rng() % 10;
+            if (r < 3 && !live.empty()) {
+                auto index = rng() % live.size();
+                exchange->cancel(live[index].first, live[index].second);
+                live[index] = live.back();
+                live.pop_back();
+            } else if (r < 4) {
+                const double mid = 100 + double(rng() % 10);
+                exchange->quote("mm", instrument, mid - 1, 1 + int(rng() % 20), mid + 1, 1 + int(rng() % 20), "q");
+            } else {
+                const double price = 95 + double(rng() % 20);
+                auto id = rng() % 2 ? exchange->buy(session, instrument, price, 1 + int(rng() % 30)) : exchange->sell(session, instrument, price, 1 + int(rng() % 30));
+                if (id) live.emplace_back(*id, session);
+            }
+        }
+        for (const auto& [instrument, digest] : recorded.digests) before[instrument] = *exchange->book(instrument);
+    }
+    ASSERT_GT(recorded.digests.size(), 30u);
+
+    std::vector<ReplayReport> reports;
+    for (unsigned threads : {1u, 4u}) {
+        ParallelReplay replay(threads);
+        reports.push_back(replay.run(dir));
+        for (const auto& [instrument, book] : before) {
+            auto after = *replay.exchange().book(instrument);
+            EXPECT_EQ(after.bidOrderIds, book.bidOrderIds) << instrument;
+            EXPECT_EQ(after.askOrderIds, book.askOrderIds) << instrument;
+        }
+    }
+    EXPECT_EQ(reports[0].commands, reports[1].commands);
+    EXPECT_EQ(reports[0].digest, reports[1].digest);
+    EXPECT_EQ(reports[0].trades, reports[1].trades);
+    ASSERT_EQ(reports[0].instruments.size(), 40u);
+    for (size_t i = 0; i < reports[0].instruments.size(); i++) {
+        const auto& result = reports[1].instruments[i];
+        EXPECT_EQ(result.instrument, reports[0].instruments[i].instrument);
+        EXPECT_EQ(result.digest, reports[0].instruments[i].digest);
+        // each instrument trades exactly as in the recording
+        const auto it = recorded.digests.find(result.instrument);
+        if (it == recorded.digests.end()) {
+            EXPECT_EQ(result.trades, 0u);
+        } else {
+            EXPECT_EQ(result.digest, it->second.value()) << result.instrument;
+            EXPECT_EQ(result.trades, it->second.count()) << result.instrument;
+        }
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ReplayTest, ParallelReplayWithBarriers) {
+    const auto dir = (std::filesystem::temp_directory_path() / ("orderbook_barrier_replay_test." + std::to_string(getpid()))).string();
+    std::filesystem::remove_all(dir);
+    struct PerInstrument : ExchangeListener {
+        std::map<std::string, TradeDigest> digests;
+        void onTrade(const Trade& trade) override { digests[trade.aggressor.instrument].onTrade(trade); }
+    } recorded;
+    long lastId = 0;
+    int trips = 0;
+    {
+        auto exchange = std::make_unique<Exchange>(recorded);
+        JournalConfig config;
+        config.directory = dir;
+        exchange->setJournal(std::make_shared<Journal>(config));
+        // mm1 quotes SYM0 alone and trips after a few fills, it is re-armed between the flow of the other books
+        const ProtectionConfig tight{std::chrono::hours(1), 1000, 3};
+        exchange->setProtection("mm1", tight);
+        exchange->setProtection("mm2", {std::chrono::hours(1), 1000000, 1000000});
+        std::mt19937 rng(5);
+        for (int i = 0; i < 6000; i++) {
+            if (i % 1000 == 999) {
+                trips += exchange->isProtectionTripped("mm1");
+                exchange->setProtection("mm1", tight);
+            }
+            if (i == 3000) exchange->closeInstrument("SYM3");
+            const auto instrument = "SYM" + std::to_string(rng() % 8);
+            const double mid = 100 + double(rng() % 5);
+            if (rng() % 3 == 0) {
+                exchange->quote(instrument == "SYM0" ? "mm1" : "mm2", instrument, mid - 1, 1 + int(rng() % 10), mid + 1, 1 + int(rng() % 10), "q");
+            } else {
+                auto id = rng() % 2 ? exchange->buy("s", instrument, mid + 1, 1 + int(rng() % 5)) : exchange->sell("s", instrument, mid - 1, 1 + int(rng() % 5));
+                if (id) lastId = std::max(lastId, *id);
+            }
+        }
+    }
+    ASSERT_GT(trips, 0);
+
+    std::vector<ReplayReport> reports;
+    for (unsigned threads : {1u, 4u}) {
+        ParallelReplay replay(threads);
+        reports.push_back(replay.run(dir));
+        // commands after the replay continue after the replayed ids
+        EXPECT_GT(*replay.exchange().buy("s", "SYM1", 1, 1), lastId);
+    }
+    EXPECT_EQ(reports[0].digest, reports[1].digest);
+    EXPECT_EQ(reports[0].commands, reports[1].commands);
+    for (const auto& result : reports[1].instruments) {
+        const auto it = recorded.digests.find(result.instrument);
+        if (it != recorded.digests.end()) EXPECT_EQ(result.digest, it->second.value()) << result.instrument;
+    }
+    std::filesystem::remove_all(dir);
+}
+
+#endif
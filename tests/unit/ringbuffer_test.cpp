@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "core/ringbuffer.h"
+
+TEST(RingBufferTest, RingBufferBasic) {
+    RingBuffer<int> buffer(3);
+    EXPECT_EQ(buffer.capacity(), 4u);
+    EXPECT_TRUE(buffer.empty());
+
+    for (int i = 0; i < 4; i++) EXPECT_TRUE(buffer.push(i));
+    EXPECT_FALSE(buffer.push(4));
+    EXPECT_EQ(buffer.size(), 4u);
+
+    int value;
+    EXPECT_TRUE(buffer.pop(value));
+    EXPECT_EQ(value, 0);
+    EXPECT_TRUE(buffer.push(4));
+
+    std::vector<int> drained;
+    EXPECT_EQ(buffer.drain([&](int v) { drained.push_back(v); }, 2), 2u);
+    EXPECT_EQ(drained, (std::vector<int>{1, 2}));
+    EXPECT_EQ(buffer.drain([&](int v) { drained.push_back(v); }), 2u);
+    EXPECT_EQ(drained, (std::vector<int>{1, 2, 3, 4}));
+    EXPECT_FALSE(buffer.pop(value));
+}
+
+TEST(RingBufferTest, RingBufferProducerConsumer) {
+    RingBuffer<long> buffer(64);
+    const long n = 100000;
+
+    std::thread producer([&]() {
+        for (long i = 0; i < n; i++) {
+            while (!buffer.push(i)) std::this_thread::yield();
+        }
+    });
+    long expected = 0;
+    bool ordered = true;
+    while (expected < n) {
+        if (buffer.drain([&](long v) { ordered &= v == expected++; }) == 0) std::this_thread::yield();
+    }
+    producer.join();
+    EXPECT_TRUE(ordered);
+    EXPECT_TRUE(buffer.empty());
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "core/seqlock.h"
+
+struct Pair {
+    long a = 0;
+    long b = 0;
+};
+
+TEST(SeqLockTest, SeqLockBasic) {
+    SeqLock<Pair> lock;
+    EXPECT_EQ(lock.load().a, 0);
+    auto version = lock.version();
+
+    lock.store({1, 2});
+    auto value = lock.load();
+    EXPECT_EQ(value.a, 1);
+    EXPECT_EQ(value.b, 2);
+    EXPECT_EQ(lock.version(), version + 2);
+}
+
+TEST(SeqLockTest, SeqLockNoTornReads) {
+    SeqLock<Pair> lock;
+    std::atomic<bool> done = false;
+
+    std::vector<std::thread> readers;
+    std::atomic<long> torn = 0;
+    for (int i = 0; i < 2; i++) {
+        readers.push_back(std::thread([&]() {
+            while (!done) {
+                auto value = lock.load();
+                if (value.b != value.a * 2) torn++;
+            }
+        }));
+    }
+
+    for (long i = 0; i < 1000000; i++) {
+        lock.store({i, i * 2});
+    }
+    done = true;
+    for (auto& reader : readers) reader.join();
+
+    EXPECT_EQ(torn, 0);
+    EXPECT_EQ(lock.load().a, 999999);
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#ifndef _WIN32
+
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "core/mdpublisher.h"
+#include "core/shmring.h"
+#include "core/test.h"
+
+static std::string shmName(const char* test) {
+    return "/orderbook_test." + std::string(test) + "." + std::to_string(getpid());
+}
+
+TEST(ShmRingTest, WriteRead) {
+    const auto name = shmName("WriteRead");
+    ShmRingWriter writer(name, 8);
+    ShmRingReader reader(name);
+    EXPECT_EQ(reader.capacity(), 8u);
+
+    MarketDataRecord record;
+    EXPECT_EQ(reader.read(record), ShmRingReader::EMPTY);
+    for (int i = 0; i < 5; i++) {
+        MarketDataRecord r;
+        r.quantity = i;
+        r.price = 100 + i;
+        writer.write(r);
+    }
+    EXPECT_EQ(reader.lag(), 5u);
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(reader.read(record), ShmRingReader::OK);
+        EXPECT_EQ(record.quantity, i);
+        EXPECT_EQ(record.price, 100 + i);
+    }
+    EXPECT_EQ(reader.read(record), ShmRingReader::EMPTY);
+
+    // a second reader joining late starts at the head, or at the oldest record still in the ring
+    ShmRingReader late(name);
+    EXPECT_EQ(late.read(record), ShmRingReader::EMPTY);
+    ShmRingReader oldest(name, true);
+    ASSERT_EQ(oldest.read(record), ShmRingReader::OK);
+    EXPECT_EQ(record.quantity, 0);
+}
+
+TEST(ShmRingTest, SlowReaderIsLapped) {
+    const auto name = shmName("Lapped");
+    ShmRingWriter writer(name, 4);
+    ShmRingReader reader(name);
+
+    MarketDataRecord r;
+    for (int i = 0; i < 10; i++) {
+        r.quantity = i;
+        writer.write(r);
+    }
+    MarketDataRecord record;
+    EXPECT_EQ(reader.read(record), ShmRingReader::LAPPED);
+    EXPECT_EQ(reader.lost(), 10u);
+    EXPECT_EQ(reader.lag(), 0u);
+
+    r.quantity = 10;
+    writer.write(r);
+    ASSERT_EQ(reader.read(record), ShmRingReader::OK);
+    EXPECT_EQ(record.quantity, 10);
+}
+
+TEST(ShmRingTest, RejectsInvalidCapacity) {
+    const auto name = shmName("Capacity");
+    ShmRingWriter writer(name, 8);
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    ASSERT_GE(fd, 0);
+    auto header = static_cast<ShmRingHeader*>(mmap(nullptr, sizeof(ShmRingHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    ASSERT_NE(header, MAP_FAILED);
+    for (uint64_t capacity : {0, 6, 16}) {
+        header->capacity = capacity;
+        EXPECT_THROW(ShmRingReader reader(name), std::runtime_error) << capacity;
+    }
+    header->capacity = 8;
+    EXPECT_NO_THROW(ShmRingReader reader(name));
+    munmap(header, sizeof(ShmRingHeader));
+}
+
+TEST(ShmRingTest, PublishBookFeeds) {
+    const auto name = shmName("Publish");
+    OrderBookListener listener;
+    InstrumentConfig config;
+    config.levelDeltaCapacity = 64;
+    config.orderEventCapacity = 64;
+    auto book = OrderBook::create("SYM1", listener, config);
+
+    MarketDataPublisher publisher(name, 64);
+    publisher.add(book);
+    ShmRingReader reader(name);
+
+    auto b1 = TestOrder::create(1, 100, 10, Order::BUY);
+    auto s1 = TestOrder::create(2, 100, 4, Order::SELL);
+    book->insertOrder(b1);
+    book->insertOrder(s1);
+    // LEVEL 100/10 and 100/6, ORDER add b1, execute b1, execute s1, TRADE: s1 fills in full and is never added
+    EXPECT_EQ(publisher.poll(), 6u);
+
+    std::vector<MarketDataRecord> records;
+    MarketDataRecord record;
+    while (reader.read(record) == ShmRingReader::OK) records.push_back(record);
+    ASSERT_EQ(records.size(), 6u);
+    EXPECT_EQ(records[0].type, MarketDataRecord::LEVEL);
+    EXPECT_EQ(records[0].instrumentName(), "SYM1");
+    EXPECT_EQ(records[1].quantity, 6);
+    EXPECT_EQ(records[2].type, MarketDataRecord::ORDER);
+    EXPECT_EQ(records[2].event, OrderEvent::ADD);
+
+    auto& trade = records.back();
+    EXPECT_EQ(trade.type, MarketDataRecord::TRADE);
+    EXPECT_EQ(trade.exchangeId, 1);
+    EXPECT_EQ(trade.aggressorId, 2);
+    EXPECT_EQ(trade.side, Order::SELL);
+    EXPECT_EQ(trade.price, 100);
+    EXPECT_EQ(trade.quantity, 4);
+
+    publisher.start();
+    auto s2 = TestOrder::create(3, 100, 6, Order::SELL);
+    book->insertOrder(s2);
+    publisher.stop();
+    while (reader.read(record) == ShmRingReader::OK) records.push_back(record);
+    EXPECT_EQ(records.back().type, MarketDataRecord::TRADE);
+    EXPECT_EQ(records.back().aggressorId, 3);
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "core/exchange.h"
+
+static std::string snapshotPath(const char* test) {
+    auto path = std::filesystem::temp_directory_path() / ("orderbook_snapshot_test." + std::string(test));
+    std::filesystem::remove(path);
+    return path.string();
+}
+
+static void expectSameBook(Exchange& a, Exchange& b, const std::string& instrument) {
+    auto before = *a.book(instrument);
+    auto after = *b.book(instrument);
+    EXPECT_EQ(after.bidOrderIds, before.bidOrderIds);
+    EXPECT_EQ(after.askOrderIds, before.askOrderIds);
+    ASSERT_EQ(after.bids.size(), before.bids.size());
+    ASSERT_EQ(after.asks.size(), before.asks.size());
+    for (size_t i = 0; i < after.bids.size(); i++) {
+        EXPECT_EQ(after.bids[i].price, before.bids[i].price);
+        EXPECT_EQ(after.bids[i].quantity, before.bids[i].quantity);
+    }
+    for (size_t i = 0; i < after.asks.size(); i++) {
+        EXPECT_EQ(after.asks[i].price, before.asks[i].price);
+        EXPECT_EQ(after.asks[i].quantity, before.asks[i].quantity);
+    }
+    EXPECT_EQ(b.topOfBook(instrument), a.topOfBook(instrument));
+}
+
+TEST(SnapshotTest, SaveLoadRoundTrip) {
+    const auto path = snapshotPath("RoundTrip");
+    auto exchange = std::make_unique<Exchange>();
+    exchange->buy("s1", "SYM1", 100, 10, "o1");
+    auto o2 = exchange->buy("s1", "SYM1", 101, 5, "o2");
+    exchange->buy("s2", "SYM1", 100, 4, "o3");
+    auto partial = exchange->sell("s2", "SYM1", 102, 7, "o4");
+    exchange->buy("s3", "SYM1", 102, 3, "o5");
+    exchange->sell("s1", "SYM2", 50, 9, "o6");
+    exchange->quote("mm", "SYM1", 99, 20, 103, 20, "q1");
+    exchange->cancel(*o2, "s1");
+    exchange->saveSnapshot(path);
+
+    auto restored = std::make_unique<Exchange>();
+    EXPECT_EQ(restored->loadSnapshot(path), 8u);
+    expectSameBook(*exchange, *restored, "SYM1");
+    expectSameBook(*exchange, *restored, "SYM2");
+
+    for (long id = 1; id <= 8; id++) {
+        auto before = exchange->getOrder(id);
+        auto after = restored->getOrder(id);
+        ASSERT_TRUE(before && after) << id;
+        EXPECT_EQ(after->sessionId(), before->sessionId());
+        EXPECT_EQ(after->orderId(), before->orderId());
+        EXPECT_EQ(after->instrument, before->instrument);
+        EXPECT_EQ(after->price(), before->price());
+        EXPECT_EQ(after->remainingQuantity(), before->remainingQuantity());
+        EXPECT_EQ(after->filledQuantity(), before->filledQuantity());
+        EXPECT_EQ(after->averagePrice(), before->averagePrice());
+        EXPECT_EQ(after->isCancelled(), before->isCancelled());
+        EXPECT_EQ(after->isQuote(), before->isQuote());
+    }
+    EXPECT_EQ(restored->getOrder(*partial)->remainingQuantity(), 4);
+
+    // the restored book trades, quotes are updated in place and new ids continue after the snapshot
+    restored->quote("mm", "SYM1", 98, 10, 104, 10, "q1");
+    auto book = *restored->book("SYM1");
+    EXPECT_EQ(book.bidOrderIds.back(), 7);
+    EXPECT_EQ(book.askOrderIds.back(), 8);
+    auto id = restored->sell("s4", "SYM1", 100, 12);
+    ASSERT_TRUE(id);
+    EXPECT_EQ(*id, 9);
+    EXPECT_EQ(restored->getOrder(*id)->filledQuantity(), 12);
+    EXPECT_EQ(restored->book("SYM1")->bids.front().quantity, 2);
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTest, RejectsInvalidFiles) {
+    const auto path = snapshotPath("Invalid");
+    auto exchange = std::make_unique<Exchange>();
+    exchange->buy("s1", "SYM1", 100, 10, "o1");
+    exchange->saveSnapshot(path);
+    const auto size = std::filesystem::file_size(path);
+
+    std::filesystem::resize_file(path, size - 8);
+    EXPECT_THROW(std::make_unique<Exchange>()->loadSnapshot(path), std::runtime_error);
+
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a snapshot, but long enough to hold a header";
+    EXPECT_THROW(std::make_unique<Exchange>()->loadSnapshot(path), std::runtime_error);
+
+    std::filesystem::remove(path);
+    EXPECT_THROW(std::make_unique<Exchange>()->loadSnapshot(path), std::runtime_error);
+}
+
+#ifndef _WIN32
+
+TEST(SnapshotTest, RecoverAfterSnapshot) {
+    const auto path = snapshotPath("Journal");
+    const auto dir = std::filesystem::temp_directory_path() / "orderbook_snapshot_test.journal";
+    std::filesystem::remove_all(dir);
+    JournalConfig config;
+    config.directory = dir.string();
+    config.segmentSize = 4096;
+
+    auto exchange = std::make_unique<Exchange>();
+    exchange->setJournal(std::make_shared<Journal>(config));
+    // spans several segments, the snapshot covers a position inside a later one
+    for (int i = 0; i < 100; i++) exchange->buy("s1", "SYM1", 90 + i % 10, 1, "o" + std::to_string(i));
+    exchange->saveSnapshot(path);
+    exchange->sell("s2", "SYM1", 95, 30, "o100");
+    exchange->quote("mm", "SYM1", 80, 5, 120, 5, "q1");
+
+    auto restored = std::make_unique<Exchange>();
+    restored->loadSnapshot(path);
+    EXPECT_EQ(restored->recover(dir.string()), 2u);
+    expectSameBook(*exchange, *restored, "SYM1");
+    EXPECT_EQ(restored->buy("s1", "SYM1", 50, 1), exchange->buy("s1", "SYM1", 50, 1));
+
+    std::filesystem::remove(path);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(SnapshotTest, RecoverProtectionAfterSnapshot) {
+    const auto path = snapshotPath("Protection");
+    const auto dir = std::filesystem::temp_directory_path() / "orderbook_snapshot_test.protection";
+    std::filesystem::remove_all(dir);
+    JournalConfig config;
+    config.directory = dir.string();
+
+    auto exchange = std::make_unique<Exchange>();
+    exchange->setJournal(std::make_shared<Journal>(config));
+    exchange->setProtection("mm", {std::chrono::hours(1), 5, 0});
+    exchange->setProtection("mm2", {std::chrono::hours(1), 1, 0});
+    exchange->quote("mm", "SYM1", 99, 10, 101, 10, "q");
+    exchange->quote("mm2", "SYM2", 99, 10, 101, 10, "q");
+    // mm is 2 short of its limit, mm2 tripped
+    exchange->sell("s1", "SYM1", 99, 3);
+    exchange->sell("s1", "SYM2", 99, 1);
+    exchange->saveSnapshot(path);
+    // trips mm in the journal after the snapshot, mm2 is still rejected
+    exchange->buy("s1", "SYM1", 101, 2);
+    exchange->quote("mm2", "SYM2", 98, 10, 102, 10, "q2");
+    ASSERT_TRUE(exchange->isProtectionTripped("mm"));
+
+    auto restored = std::make_unique<Exchange>();
+    restored->loadSnapshot(path);
+    EXPECT_FALSE(restored->isProtectionTripped("mm"));
+    EXPECT_TRUE(restored->isProtectionTripped("mm2"));
+    // the buy, and the pulls of mm's bid and ask
+    EXPECT_EQ(restored->recover(dir.string()), 3u);
+    EXPECT_TRUE(restored->isProtectionTripped("mm"));
+    EXPECT_TRUE(restored->isProtectionTripped("mm2"));
+    expectSameBook(*exchange, *restored, "SYM1");
+    expectSameBook(*exchange, *restored, "SYM2");
+
+    std::filesystem::remove(path);
+    std::filesystem::remove_all(dir);
+}
+
+#endif